@@ -0,0 +1,441 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * DirtyTileCache - Model output kept tile by tile between frames
+ *
+ * For models with a bounded receptive field, the output of a tile depends
+ * only on the inputs within a halo around it. The cache splits the packed
+ * input into tiles, hashes each tile's halo region in every image input,
+ * and keeps the output of the last run. On the next frame only the tiles
+ * whose halo region changed are inferred again, on the region cropped from
+ * the inputs, and their centres are written over the cached output; on a
+ * locked-off shot or a paint fix most of the frame is skipped. Tiles can
+ * also be left out altogether, e.g. those away from a mask, so the cost
+ * follows the area that is needed.
+ */
+class DirtyTileCache {
+public:
+  // Tile regions are grown to multiples of this many pixels where the image
+  // allows, for models that downsample several times
+  static const int kRegionAlignment = 32;
+
+  /**
+   * One tile, in packed input pixels
+   */
+  struct Tile {
+    int x, y, r, t;     // The tile itself, written to the output
+    int rx, ry, rr, rt; // The tile and its halo, inferred
+
+    int regionWidth() const { return rr - rx; }
+    int regionHeight() const { return rt - ry; }
+  };
+
+  DirtyTileCache()
+      : _width(0), _height(0), _tileSize(0), _halo(0), _tiles(), _hashes(),
+        _pending(), _valid(), _active(), _output(), _outputChannels(0),
+        _scale(0), _inferred(0) {}
+
+  /**
+   * Lay out the tiles for an input size. A layout that differs from the
+   * last one drops the cached output.
+   * @param width Packed input width
+   * @param height Packed input height
+   * @param tileSize Tile width and height
+   * @param halo Pixels of context inferred around each tile
+   */
+  void configure(int width, int height, int tileSize, int halo) {
+    tileSize = std::max(16, tileSize);
+    halo = std::max(0, halo);
+    if (width == _width && height == _height && tileSize == _tileSize &&
+        halo == _halo) {
+      return;
+    }
+    clear();
+    _width = width;
+    _height = height;
+    _tileSize = tileSize;
+    _halo = halo;
+    for (int y = 0; y < height; y += tileSize) {
+      for (int x = 0; x < width; x += tileSize) {
+        Tile tile;
+        tile.x = x;
+        tile.y = y;
+        tile.r = std::min(x + tileSize, width);
+        tile.t = std::min(y + tileSize, height);
+        alignRegion(tile.x - halo, tile.r + halo, width, tile.rx, tile.rr);
+        alignRegion(tile.y - halo, tile.t + halo, height, tile.ry, tile.rt);
+        _tiles.push_back(tile);
+      }
+    }
+    _hashes.assign(_tiles.size(), 0);
+    _pending.assign(_tiles.size(), 0);
+    _valid.assign(_tiles.size(), false);
+    _active.assign(_tiles.size(), true);
+  }
+
+  const std::vector<Tile> &tiles() const { return _tiles; }
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  /**
+   * Tiles within the halo of a mask's non-zero area
+   * @param mask Mask plane at the configured size
+   * @return One flag per tile
+   */
+  std::vector<bool> tilesNearMask(const float *mask) const {
+    // Summed-area table of the non-zero pixels, so each dilated tile is
+    // checked with four lookups
+    size_t stride = static_cast<size_t>(_width) + 1;
+    std::vector<uint32_t> table(stride * (_height + 1), 0);
+    for (int y = 0; y < _height; y++) {
+      uint32_t rowCount = 0;
+      for (int x = 0; x < _width; x++) {
+        rowCount += mask[static_cast<size_t>(y) * _width + x] > 0.0f;
+        table[(y + 1) * stride + x + 1] = table[y * stride + x + 1] + rowCount;
+      }
+    }
+
+    std::vector<bool> near(_tiles.size(), false);
+    for (size_t i = 0; i < _tiles.size(); i++) {
+      const Tile &tile = _tiles[i];
+      size_t x0 = std::max(0, tile.x - _halo);
+      size_t y0 = std::max(0, tile.y - _halo);
+      size_t x1 = std::min(_width, tile.r + _halo);
+      size_t y1 = std::min(_height, tile.t + _halo);
+      near[i] = table[y1 * stride + x1] + table[y0 * stride + x0] >
+                table[y0 * stride + x1] + table[y1 * stride + x0];
+    }
+    return near;
+  }
+
+  /**
+   * Find the tiles to infer again: those whose halo region changed in any
+   * input, and every tile when nothing is cached
+   * @param inputs Image input tensors, NCHW with batch 1 at the configured
+   *               size
+   * @param settingsHash Hash of everything else the output depends on, such
+   *                     as parameter inputs
+   * @param active Tiles wanted in the output; null wants every tile. The
+   *               others are neither hashed nor inferred.
+   * @return Indices of the tiles to infer
+   * @throws std::invalid_argument if an input has the wrong size
+   */
+  std::vector<size_t>
+  dirtyTiles(const std::vector<const std::vector<float> *> &inputs,
+             uint64_t settingsHash, const std::vector<bool> *active = nullptr) {
+    size_t planeSize = static_cast<size_t>(_width) * _height;
+    for (const std::vector<float> *input : inputs) {
+      if (!input || planeSize == 0 || input->size() % planeSize != 0) {
+        throw std::invalid_argument("Tiled input does not match the " +
+                                    std::to_string(_width) + "x" +
+                                    std::to_string(_height) + " tile layout");
+      }
+    }
+
+    if (active && active->size() == _tiles.size()) {
+      _active = *active;
+    } else {
+      _active.assign(_tiles.size(), true);
+    }
+
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < _tiles.size(); i++) {
+      if (!_active[i]) {
+        continue;
+      }
+      uint64_t hash = (kHashOffset ^ settingsHash) * kHashPrime;
+      for (const std::vector<float> *input : inputs) {
+        hash = hashRegion(*input, _tiles[i], hash);
+      }
+      _pending[i] = hash;
+      if (!_valid[i] || _hashes[i] != hash) {
+        dirty.push_back(i);
+      }
+    }
+    _inferred = dirty.size();
+    return dirty;
+  }
+
+  /**
+   * Crop a tile's region from an NCHW tensor (batch 1) at the configured
+   * size
+   */
+  std::vector<float> crop(const std::vector<float> &tensor,
+                          const Tile &tile) const {
+    size_t planeSize = static_cast<size_t>(_width) * _height;
+    size_t channels = tensor.size() / planeSize;
+    int w = tile.regionWidth(), h = tile.regionHeight();
+    std::vector<float> region(channels * w * h);
+    for (size_t c = 0; c < channels; c++) {
+      for (int y = 0; y < h; y++) {
+        const float *src = tensor.data() + c * planeSize +
+                           static_cast<size_t>(tile.ry + y) * _width +
+                           tile.rx;
+        std::copy(src, src + w,
+                  region.data() + (c * h + y) * static_cast<size_t>(w));
+      }
+    }
+    return region;
+  }
+
+  /**
+   * Write the centre of a tile's output over the cached output and mark
+   * the tile clean. The first tile sets the output channels and scale.
+   * @param index The tile
+   * @param data Output of the tile's region, NCHW with batch 1
+   * @param channels Output channels
+   * @param width Output width of the region
+   * @param height Output height of the region
+   * @throws std::invalid_argument if the output is not a whole multiple of
+   *         the region size, or differs from the other tiles
+   */
+  void paste(size_t index, const float *data, int channels, int width,
+             int height) {
+    const Tile &tile = _tiles[index];
+    int scale = width / tile.regionWidth();
+    if (scale < 1 || width != scale * tile.regionWidth() ||
+        height != scale * tile.regionHeight()) {
+      throw std::invalid_argument(
+          "Tiled output must be a whole multiple of the tile size; got " +
+          std::to_string(width) + "x" + std::to_string(height) + " for " +
+          std::to_string(tile.regionWidth()) + "x" +
+          std::to_string(tile.regionHeight()));
+    }
+    if (_output.empty()) {
+      _outputChannels = channels;
+      _scale = scale;
+      _output.assign(static_cast<size_t>(channels) * outputWidth() *
+                         outputHeight(),
+                     0.0f);
+    } else if (channels != _outputChannels || scale != _scale) {
+      throw std::invalid_argument("Tile output changed shape between tiles");
+    }
+
+    size_t outPlane = static_cast<size_t>(outputWidth()) * outputHeight();
+    size_t tilePlane = static_cast<size_t>(width) * height;
+    int rowLength = (tile.r - tile.x) * scale;
+    for (int c = 0; c < channels; c++) {
+      for (int y = tile.y * scale; y < tile.t * scale; y++) {
+        const float *src = data + c * tilePlane +
+                           static_cast<size_t>(y - tile.ry * scale) * width +
+                           (tile.x - tile.rx) * scale;
+        std::copy(src, src + rowLength,
+                  _output.data() + c * outPlane +
+                      static_cast<size_t>(y) * outputWidth() +
+                      tile.x * scale);
+      }
+    }
+    _hashes[index] = _pending[index];
+    _valid[index] = true;
+  }
+
+  /**
+   * Copy one tile of the assembled output into a copy of the same layout,
+   * writing NaN and Inf as 0
+   * @param index Tile index
+   * @param dst outputChannels() planes of outputWidth() by outputHeight()
+   */
+  void copyTile(size_t index, float *dst) const {
+    const Tile &tile = _tiles[index];
+    size_t outPlane = static_cast<size_t>(outputWidth()) * outputHeight();
+    for (int c = 0; c < _outputChannels; c++) {
+      for (int y = tile.y * _scale; y < tile.t * _scale; y++) {
+        size_t offset = c * outPlane + static_cast<size_t>(y) * outputWidth();
+        for (int x = tile.x * _scale; x < tile.r * _scale; x++) {
+          float value = _output[offset + x];
+          dst[offset + x] = std::isfinite(value) ? value : 0.0f;
+        }
+      }
+    }
+  }
+
+  /**
+   * Start an output of the configured size filled with zeros, for when no
+   * tile has been inferred yet
+   */
+  void ensureOutput(int channels) {
+    if (_output.empty()) {
+      _outputChannels = std::max(1, channels);
+      _scale = 1;
+      _output.assign(static_cast<size_t>(_outputChannels) * _width * _height,
+                     0.0f);
+    }
+  }
+
+  /**
+   * Infer every wanted tile on the next dirtyTiles call
+   */
+  void invalidate() { _valid.assign(_tiles.size(), false); }
+
+  /**
+   * Order tiles so those in a region of interest come first, each group
+   * spiralling out from the region's centre: by square ring of tiles
+   * around it, then by angle
+   * @param tiles Tile indices, reordered in place
+   * @param x,y,r,t Region of interest in packed input pixels
+   */
+  void orderFromCentre(std::vector<size_t> &tiles, int x, int y, int r,
+                       int t) const {
+    const double pi = 3.14159265358979323846;
+    double cx = 0.5 * (x + r), cy = 0.5 * (y + t);
+    std::vector<std::tuple<bool, long, double, size_t>> ranked;
+    for (size_t index : tiles) {
+      const Tile &tile = _tiles[index];
+      double dx = (0.5 * (tile.x + tile.r) - cx) / _tileSize;
+      double dy = (0.5 * (tile.y + tile.t) - cy) / _tileSize;
+      bool outside = tile.r <= x || tile.x >= r || tile.t <= y || tile.y >= t;
+      long ring = std::lround(std::max(std::fabs(dx), std::fabs(dy)));
+      double angle = std::atan2(dy, dx);
+      ranked.emplace_back(outside, ring, angle < 0.0 ? angle + 2 * pi : angle,
+                          index);
+    }
+    std::sort(ranked.begin(), ranked.end());
+    for (size_t i = 0; i < ranked.size(); i++) {
+      tiles[i] = std::get<3>(ranked[i]);
+    }
+  }
+
+  /**
+   * Tiles wanted in the last dirtyTiles call whose output is current
+   * @return One flag per tile
+   */
+  std::vector<bool> readyTiles() const {
+    std::vector<bool> ready(_tiles.size());
+    for (size_t i = 0; i < _tiles.size(); i++) {
+      ready[i] = _active[i] && _valid[i] && _hashes[i] == _pending[i];
+    }
+    return ready;
+  }
+
+  /**
+   * Spans [start, end) of an output row covered by some of the tiles, in
+   * output pixels
+   * @param y Output row
+   * @param tiles One flag per tile, e.g. from readyTiles()
+   */
+  std::vector<std::pair<int, int>>
+  tileSpans(int y, const std::vector<bool> &tiles) const {
+    std::vector<std::pair<int, int>> spans;
+    if (_scale <= 0 || y < 0 || y >= outputHeight() ||
+        tiles.size() != _tiles.size()) {
+      return spans;
+    }
+    for (size_t i = 0; i < _tiles.size(); i++) {
+      const Tile &tile = _tiles[i];
+      if (!tiles[i] || y < tile.y * _scale || y >= tile.t * _scale) {
+        continue;
+      }
+      if (!spans.empty() && spans.back().second == tile.x * _scale) {
+        spans.back().second = tile.r * _scale;
+      } else {
+        spans.emplace_back(tile.x * _scale, tile.r * _scale);
+      }
+    }
+    return spans;
+  }
+
+  /**
+   * The assembled output, NCHW with batch 1
+   */
+  const std::vector<float> &output() const { return _output; }
+  int outputChannels() const { return _outputChannels; }
+  int outputWidth() const { return _width * _scale; }
+  int outputHeight() const { return _height * _scale; }
+
+  /**
+   * Tiles inferred by the last dirtyTiles call, tiles it wanted, and the
+   * total
+   */
+  size_t inferredCount() const { return _inferred; }
+  size_t activeCount() const {
+    return static_cast<size_t>(
+        std::count(_active.begin(), _active.end(), true));
+  }
+  size_t tileCount() const { return _tiles.size(); }
+
+  /**
+   * Drop the layout and the cached output
+   */
+  void clear() {
+    _width = _height = _tileSize = _halo = 0;
+    _tiles.clear();
+    _hashes.clear();
+    _pending.clear();
+    _valid.clear();
+    _active.clear();
+    std::vector<float>().swap(_output);
+    _outputChannels = 0;
+    _scale = 0;
+    _inferred = 0;
+  }
+
+  /**
+   * FNV-1a style hash of float values, a 32-bit word at a time
+   * @param hash Hash to continue from; 0 starts a new one
+   */
+  static uint64_t hashValues(const float *values, size_t count,
+                             uint64_t hash = 0) {
+    if (hash == 0) {
+      hash = kHashOffset;
+    }
+    for (size_t i = 0; i < count; i++) {
+      uint32_t word;
+      std::memcpy(&word, values + i, sizeof(word));
+      hash = (hash ^ word) * kHashPrime;
+    }
+    return hash;
+  }
+
+private:
+  static const uint64_t kHashOffset = 14695981039346656037ull;
+  static const uint64_t kHashPrime = 1099511628211ull;
+
+  // Clamp [start, end) to [0, size) and grow it to a multiple of
+  // kRegionAlignment, to the right first, while it fits
+  static void alignRegion(int start, int end, int size, int &outStart,
+                          int &outEnd) {
+    outStart = std::max(0, start);
+    outEnd = std::min(size, end);
+    int aligned = (outEnd - outStart + kRegionAlignment - 1) /
+                  kRegionAlignment * kRegionAlignment;
+    aligned = std::min(aligned, size);
+    outEnd = std::min(size, outStart + aligned);
+    outStart = outEnd - aligned;
+  }
+
+  // Hash of a tile's region, row by row over every channel
+  uint64_t hashRegion(const std::vector<float> &tensor, const Tile &tile,
+                      uint64_t hash) const {
+    size_t planeSize = static_cast<size_t>(_width) * _height;
+    size_t channels = tensor.size() / planeSize;
+    for (size_t c = 0; c < channels; c++) {
+      for (int y = tile.ry; y < tile.rt; y++) {
+        hash = hashValues(tensor.data() + c * planeSize +
+                              static_cast<size_t>(y) * _width + tile.rx,
+                          tile.regionWidth(), hash);
+      }
+    }
+    return hash;
+  }
+
+  int _width, _height, _tileSize, _halo;
+  std::vector<Tile> _tiles;
+  std::vector<uint64_t> _hashes;  // Hash of each tile's cached output
+  std::vector<uint64_t> _pending; // Hash of each tile's current inputs
+  std::vector<bool> _valid;       // Whether a tile's output is cached
+  std::vector<bool> _active;      // Whether a tile is wanted in the output
+  std::vector<float> _output;
+  int _outputChannels;
+  int _scale; // Output pixels per input pixel
+  size_t _inferred;
+};
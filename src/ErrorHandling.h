@@ -50,4 +50,13 @@ public:
       : ONNXPluginError("Invalid Argument: " + message) {}
   explicit InvalidArgumentException(const char *message)
       : ONNXPluginError(std::string("Invalid Argument: ") + message) {}
+};
+
+class DaemonUnavailableException : public ONNXPluginError {
+public:
+  explicit DaemonUnavailableException(const std::string &message)
+      : ONNXPluginError("Inference Daemon Unavailable: " + message) {}
+  explicit DaemonUnavailableException(const char *message)
+      : ONNXPluginError(std::string("Inference Daemon Unavailable: ") +
+                        message) {}
 };
\ No newline at end of file
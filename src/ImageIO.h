@@ -0,0 +1,384 @@
+#pragma once
+
+#include "ErrorHandling.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef ONNX_NUKE_HAVE_OPENEXR
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#endif
+
+/**
+ * ImageIO - Minimal Nuke-free image reading and writing for headless tools
+ *
+ * Images are held as interleaved float pixels with rows stored bottom to top,
+ * matching both the PFM layout and Nuke's row order, so tensors packed from
+ * these images match the ones the node packs from a Tile.
+ */
+namespace ImageIO {
+
+struct Image {
+  int width;
+  int height;
+  int channels;
+  std::vector<float> pixels; // Interleaved, rows bottom to top
+
+  Image() : width(0), height(0), channels(0), pixels() {}
+  Image(int w, int h, int c)
+      : width(w), height(h), channels(c),
+        pixels(static_cast<size_t>(w) * h * c, 0.0f) {}
+};
+
+/**
+ * Format a frame number, zero-padded to at least padding digits
+ */
+inline std::string paddedFrame(int frame, size_t padding) {
+  std::string number = std::to_string(std::abs(static_cast<long>(frame)));
+  if (number.size() < padding) {
+    number.insert(0, padding - number.size(), '0');
+  }
+  if (frame < 0) {
+    number.insert(0, "-");
+  }
+  return number;
+}
+
+/**
+ * Expand a frame pattern. Supports one printf-style "%d" or "%04d" token,
+ * or one run of "#" padding; patterns without either are returned
+ * unchanged. The pattern is never used as a format string.
+ * @param pattern The file path pattern
+ * @param frame The frame number
+ * @return The path for this frame
+ */
+inline std::string expandFramePattern(const std::string &pattern, int frame) {
+  if (pattern.find('%') != std::string::npos) {
+    std::string path;
+    bool expanded = false;
+    for (size_t i = 0; i < pattern.size(); i++) {
+      if (pattern[i] != '%') {
+        path += pattern[i];
+        continue;
+      }
+      size_t end = pattern.find_first_not_of("0123456789", i + 1);
+      if (end == std::string::npos || pattern[end] != 'd' || expanded) {
+        throw InvalidArgumentException("Invalid frame pattern: " + pattern +
+                                       " (use one %d or %0Nd)");
+      }
+      std::string width = pattern.substr(i + 1, end - i - 1);
+      path += paddedFrame(frame, width.empty() ? 0 : std::stoul(width));
+      expanded = true;
+      i = end;
+    }
+    return path;
+  }
+
+  size_t start = pattern.find('#');
+  if (start == std::string::npos) {
+    return pattern;
+  }
+  size_t end = pattern.find_first_not_of('#', start);
+  if (end == std::string::npos) {
+    end = pattern.size();
+  }
+  return pattern.substr(0, start) + paddedFrame(frame, end - start) +
+         pattern.substr(end);
+}
+
+/**
+ * Get the lower-case extension of a path, without the dot
+ */
+inline std::string extension(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) {
+    return "";
+  }
+  std::string ext = path.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return static_cast<char>(tolower(c)); });
+  return ext;
+}
+
+inline bool hostIsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+}
+
+inline void swapFloatBytes(std::vector<float> &values) {
+  for (float &value : values) {
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(&value);
+    std::swap(bytes[0], bytes[3]);
+    std::swap(bytes[1], bytes[2]);
+  }
+}
+
+/**
+ * Read a PFM image ("PF" colour or "Pf" greyscale)
+ */
+inline Image readPFM(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw PreprocessException("Cannot open PFM file: " + path);
+  }
+
+  std::string magic;
+  int width = 0;
+  int height = 0;
+  float scale = 0.0f;
+  file >> magic >> width >> height >> scale;
+  file.get(); // Single whitespace character before the raster
+
+  int channels = 0;
+  if (magic == "PF") {
+    channels = 3;
+  } else if (magic == "Pf") {
+    channels = 1;
+  } else {
+    throw PreprocessException("Not a PFM file: " + path);
+  }
+  if (!file || width <= 0 || height <= 0 || scale == 0.0f) {
+    throw PreprocessException("Invalid PFM header: " + path);
+  }
+
+  Image image(width, height, channels);
+  file.read(reinterpret_cast<char *>(image.pixels.data()),
+            image.pixels.size() * sizeof(float));
+  if (!file) {
+    throw PreprocessException("Truncated PFM file: " + path);
+  }
+
+  // Negative scale means little-endian data
+  bool fileLittleEndian = scale < 0.0f;
+  if (fileLittleEndian != hostIsLittleEndian()) {
+    swapFloatBytes(image.pixels);
+  }
+  return image;
+}
+
+/**
+ * Write a PFM image. One channel is written as greyscale; anything else is
+ * written as RGB, padding missing channels with zeros and dropping extras.
+ */
+inline void writePFM(const std::string &path, const Image &image) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    throw ONNXPluginError("Cannot open PFM file for writing: " + path);
+  }
+
+  int outChannels = image.channels == 1 ? 1 : 3;
+  file << (outChannels == 1 ? "Pf" : "PF") << "\n"
+       << image.width << " " << image.height << "\n"
+       << (hostIsLittleEndian() ? "-1.0" : "1.0") << "\n";
+
+  std::vector<float> row(static_cast<size_t>(image.width) * outChannels);
+  for (int y = 0; y < image.height; y++) {
+    for (int x = 0; x < image.width; x++) {
+      const float *src =
+          &image.pixels[(static_cast<size_t>(y) * image.width + x) *
+                        image.channels];
+      for (int c = 0; c < outChannels; c++) {
+        row[x * outChannels + c] = c < image.channels ? src[c] : 0.0f;
+      }
+    }
+    file.write(reinterpret_cast<const char *>(row.data()),
+               row.size() * sizeof(float));
+  }
+
+  if (!file) {
+    throw ONNXPluginError("Error writing PFM file: " + path);
+  }
+}
+
+/**
+ * Read headerless little-endian interleaved float32 data of a known size
+ */
+inline Image readRaw(const std::string &path, int width, int height,
+                     int channels) {
+  if (width <= 0 || height <= 0 || channels <= 0) {
+    throw InvalidArgumentException(
+        "Raw input needs a size (WxHxC), e.g. --raw-size 1920x1080x3");
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw PreprocessException("Cannot open raw file: " + path);
+  }
+
+  Image image(width, height, channels);
+  file.read(reinterpret_cast<char *>(image.pixels.data()),
+            image.pixels.size() * sizeof(float));
+  if (!file) {
+    throw PreprocessException("Raw file smaller than " + std::to_string(width) +
+                              "x" + std::to_string(height) + "x" +
+                              std::to_string(channels) + " floats: " + path);
+  }
+  if (!hostIsLittleEndian()) {
+    swapFloatBytes(image.pixels);
+  }
+  return image;
+}
+
+/**
+ * Write headerless little-endian interleaved float32 data
+ */
+inline void writeRaw(const std::string &path, const Image &image) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    throw ONNXPluginError("Cannot open raw file for writing: " + path);
+  }
+
+  if (hostIsLittleEndian()) {
+    file.write(reinterpret_cast<const char *>(image.pixels.data()),
+               image.pixels.size() * sizeof(float));
+  } else {
+    std::vector<float> swapped = image.pixels;
+    swapFloatBytes(swapped);
+    file.write(reinterpret_cast<const char *>(swapped.data()),
+               swapped.size() * sizeof(float));
+  }
+
+  if (!file) {
+    throw ONNXPluginError("Error writing raw file: " + path);
+  }
+}
+
+#ifdef ONNX_NUKE_HAVE_OPENEXR
+/**
+ * Read the R, G, B and A channels of an EXR data window as float
+ */
+inline Image readEXR(const std::string &path) {
+  try {
+    Imf::InputFile file(path.c_str());
+    const Imath::Box2i &dw = file.header().dataWindow();
+    int width = dw.max.x - dw.min.x + 1;
+    int height = dw.max.y - dw.min.y + 1;
+
+    static const char *const names[] = {"R", "G", "B", "A"};
+    int channels = 0;
+    for (const char *name : names) {
+      if (file.header().channels().findChannel(name)) {
+        channels++;
+      } else {
+        break;
+      }
+    }
+    if (channels == 0) {
+      throw PreprocessException("EXR file has no R channel: " + path);
+    }
+
+    // EXR rows run top to bottom; read them flipped into Nuke row order
+    Image image(width, height, channels);
+    ptrdiff_t xStride = static_cast<ptrdiff_t>(sizeof(float)) * channels;
+    ptrdiff_t yStride = xStride * width;
+    char *base = reinterpret_cast<char *>(image.pixels.data()) +
+                 (static_cast<ptrdiff_t>(height - 1) + dw.min.y) * yStride -
+                 static_cast<ptrdiff_t>(dw.min.x) * xStride;
+
+    Imf::FrameBuffer frameBuffer;
+    for (int c = 0; c < channels; c++) {
+      frameBuffer.insert(names[c],
+                         Imf::Slice(Imf::FLOAT, base + c * sizeof(float),
+                                    xStride, -yStride));
+    }
+    file.setFrameBuffer(frameBuffer);
+    file.readPixels(dw.min.y, dw.max.y);
+    return image;
+  } catch (const ONNXPluginError &) {
+    throw;
+  } catch (const std::exception &e) {
+    throw PreprocessException("Error reading EXR file " + path + ": " +
+                              e.what());
+  }
+}
+
+/**
+ * Write an image as a float EXR with up to four channels (R, G, B, A)
+ */
+inline void writeEXR(const std::string &path, const Image &image) {
+  static const char *const names[] = {"R", "G", "B", "A"};
+  int channels = std::min(image.channels, 4);
+
+  try {
+    Imf::Header header(image.width, image.height);
+    for (int c = 0; c < channels; c++) {
+      header.channels().insert(names[c], Imf::Channel(Imf::FLOAT));
+    }
+
+    ptrdiff_t xStride = static_cast<ptrdiff_t>(sizeof(float)) * image.channels;
+    ptrdiff_t yStride = xStride * image.width;
+    const char *base = reinterpret_cast<const char *>(image.pixels.data()) +
+                       static_cast<ptrdiff_t>(image.height - 1) * yStride;
+
+    Imf::FrameBuffer frameBuffer;
+    for (int c = 0; c < channels; c++) {
+      frameBuffer.insert(
+          names[c], Imf::Slice(Imf::FLOAT,
+                               const_cast<char *>(base) + c * sizeof(float),
+                               xStride, -yStride));
+    }
+
+    Imf::OutputFile file(path.c_str(), header);
+    file.setFrameBuffer(frameBuffer);
+    file.writePixels(image.height);
+  } catch (const std::exception &e) {
+    throw ONNXPluginError("Error writing EXR file " + path + ": " + e.what());
+  }
+}
+#endif
+
+/**
+ * Read an image, choosing the format from the file extension
+ * @param rawWidth, rawHeight, rawChannels Size used for headerless .raw files
+ */
+inline Image readImage(const std::string &path, int rawWidth = 0,
+                       int rawHeight = 0, int rawChannels = 0) {
+  std::string ext = extension(path);
+  if (ext == "pfm") {
+    return readPFM(path);
+  }
+  if (ext == "raw" || ext == "bin") {
+    return readRaw(path, rawWidth, rawHeight, rawChannels);
+  }
+#ifdef ONNX_NUKE_HAVE_OPENEXR
+  if (ext == "exr") {
+    return readEXR(path);
+  }
+#endif
+  throw InvalidArgumentException("Unsupported input image format: " + path);
+}
+
+/**
+ * Write an image, choosing the format from the file extension
+ */
+inline void writeImage(const std::string &path, const Image &image) {
+  std::string ext = extension(path);
+  if (ext == "pfm") {
+    writePFM(path, image);
+    return;
+  }
+  if (ext == "raw" || ext == "bin") {
+    writeRaw(path, image);
+    return;
+  }
+#ifdef ONNX_NUKE_HAVE_OPENEXR
+  if (ext == "exr") {
+    writeEXR(path, image);
+    return;
+  }
+#endif
+  throw InvalidArgumentException("Unsupported output image format: " + path);
+}
+
+} // namespace ImageIO
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "ErrorHandling.h"
+#include "InferenceDaemonProtocol.h"
+#include "Metrics.h"
+#include "TensorProcessor.h"
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Client side of the local inference daemon.
+ *
+ * Loads models in the daemon and runs them there, passing tensors through
+ * shared memory. Inputs are copied into reusable staging segments; outputs
+ * are left in reusable segments that callers may read in place. Any
+ * transport problem (daemon not running, connection lost) is reported as
+ * DaemonUnavailableException so callers can fall back to in-process
+ * inference.
+ */
+class InferenceDaemonClient {
+public:
+  // Model description returned by the daemon after loading
+  struct ModelInfo {
+    uint32_t modelId;
+    std::vector<std::string> inputNames;
+    std::vector<std::vector<int64_t>> inputDims;
+    std::vector<std::string> outputNames;
+    std::vector<std::vector<int64_t>> outputDims;
+
+    ModelInfo() : modelId(0) {}
+  };
+
+  // Called with the shape and element count of the output; returns where the
+  // output should be written
+  using OutputAllocator =
+      std::function<float *(const std::vector<int64_t> &, size_t)>;
+
+  // Shared memory holding a run's output
+  using OutputSegment = std::shared_ptr<InferenceDaemon::SharedMemoryBuffer>;
+
+  explicit InferenceDaemonClient(const std::string &socketPath)
+      : _socketPath(socketPath), _fd(-1) {}
+
+  ~InferenceDaemonClient() { disconnect(); }
+
+  InferenceDaemonClient(const InferenceDaemonClient &) = delete;
+  InferenceDaemonClient &operator=(const InferenceDaemonClient &) = delete;
+
+  const std::string &socketPath() const { return _socketPath; }
+
+  /**
+   * Ask the daemon to load a model (or reuse its already loaded copy)
+   * @param modelPath Path to the ONNX model file
+   * @param useGPU Whether the daemon should use GPU execution
+   * @return Model description from the daemon
+   */
+  ModelInfo loadModel(const std::string &modelPath, bool useGPU) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ensureConnected();
+
+    InferenceDaemon::MessageWriter request;
+    request.str(modelPath);
+    request.u32(useGPU ? 1 : 0);
+
+    std::vector<char> reply =
+        roundTrip(InferenceDaemon::kLoadRequest, request.data(),
+                  InferenceDaemon::kLoadReply);
+    InferenceDaemon::MessageReader reader(reply);
+    uint32_t status = reader.u32();
+    std::string message = reader.str();
+    if (status != InferenceDaemon::kOk) {
+      throw ModelLoadException("Inference daemon: " + message);
+    }
+
+    ModelInfo info;
+    info.modelId = reader.u32();
+    uint32_t inputCount = reader.u32();
+    for (uint32_t i = 0; i < inputCount; i++) {
+      info.inputNames.push_back(reader.str());
+      info.inputDims.push_back(reader.shape());
+    }
+    uint32_t outputCount = reader.u32();
+    for (uint32_t i = 0; i < outputCount; i++) {
+      info.outputNames.push_back(reader.str());
+      info.outputDims.push_back(reader.shape());
+    }
+    return info;
+  }
+
+  /**
+   * Run a model loaded with loadModel(), leaving the first output in shared
+   * memory. The output segment is not reused while the caller holds it.
+   * @param modelId Id returned by loadModel()
+   * @param inputData Pointers to the input tensors
+   * @param inputSizes Element counts of the input tensors
+   * @param inputShapes Shapes of the input tensors
+   * @param inputNames Model input names the tensors are bound to
+   * @param outputShape Receives the shape of the first output
+   * @param outputCount Receives the element count of the first output
+   * @return Segment holding the output, mapped writable
+   */
+  OutputSegment runShared(uint32_t modelId,
+                          const std::vector<const float *> &inputData,
+                          const std::vector<size_t> &inputSizes,
+                          const std::vector<std::vector<int64_t>> &inputShapes,
+                          const std::vector<std::string> &inputNames,
+                          std::vector<int64_t> &outputShape,
+                          size_t &outputCount) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ensureConnected();
+
+    // Stage inputs in shared memory; segments are reused between runs. The
+    // packed tensors live in ordinary memory, so this is one copy per input.
+    if (_inputBuffers.size() < inputData.size()) {
+      _inputBuffers.resize(inputData.size());
+    }
+
+    InferenceDaemon::MessageWriter request;
+    request.u32(modelId);
+    request.u32(static_cast<uint32_t>(inputData.size()));
+    for (size_t i = 0; i < inputData.size(); i++) {
+      size_t bytes = inputSizes[i] * sizeof(float);
+      std::unique_ptr<InferenceDaemon::SharedMemoryBuffer> &buffer =
+          _inputBuffers[i];
+      if (!buffer || buffer->size() < bytes) {
+        buffer.reset(new InferenceDaemon::SharedMemoryBuffer());
+        buffer->create(InferenceDaemon::uniqueSegmentName("onnxc"), bytes);
+        Metrics::registry().bytesAllocated.add(bytes);
+      }
+      std::memcpy(buffer->data(), inputData[i], bytes);
+
+      request.str(inputNames[i]);
+      request.shape(inputShapes[i]);
+      request.str(buffer->name());
+      request.u64(inputSizes[i]);
+    }
+
+    // The daemon writes the output into a free segment of ours when it fits
+    OutputSegment &segment = freeOutputSegment();
+    request.str(segment ? segment->name() : std::string());
+    request.u64(segment ? segment->size() / sizeof(float) : 0);
+
+    std::vector<char> reply =
+        roundTrip(InferenceDaemon::kRunRequest, request.data(),
+                  InferenceDaemon::kRunReply);
+    InferenceDaemon::MessageReader reader(reply);
+    uint32_t status = reader.u32();
+    std::string message = reader.str();
+    if (status != InferenceDaemon::kOk) {
+      throw InferenceException("Inference daemon: " + message);
+    }
+
+    outputShape = reader.shape();
+    std::string name = reader.str();
+    outputCount = static_cast<size_t>(reader.u64());
+
+    // A larger output comes back in a new segment the daemon made for us; it
+    // replaces the one that was too small
+    if (!segment || name != segment->name()) {
+      OutputSegment created(new InferenceDaemon::SharedMemoryBuffer());
+      try {
+        created->open(name, outputCount * sizeof(float), true, true);
+      } catch (const ONNXPluginError &e) {
+        shm_unlink(name.c_str());
+        throw InferenceException(e.what());
+      }
+      Metrics::registry().bytesAllocated.add(outputCount * sizeof(float));
+      segment = created;
+    }
+    return segment;
+  }
+
+  /**
+   * Run a model loaded with loadModel(), copying the first output out
+   * @param allocateOutput Provides the destination for the first output
+   * @param statistics Optional statistics gathered while copying the output
+   */
+  void run(uint32_t modelId, const std::vector<const float *> &inputData,
+           const std::vector<size_t> &inputSizes,
+           const std::vector<std::vector<int64_t>> &inputShapes,
+           const std::vector<std::string> &inputNames,
+           const OutputAllocator &allocateOutput,
+           std::vector<int64_t> &outputShape,
+           TensorProcessor::OutputStatistics *statistics = nullptr) {
+    size_t outputCount = 0;
+    OutputSegment output = runShared(modelId, inputData, inputSizes,
+                                     inputShapes, inputNames, outputShape,
+                                     outputCount);
+    float *destination = allocateOutput(outputShape, outputCount);
+    TensorProcessor::copyOutput(static_cast<const float *>(output->data()),
+                                destination, outputCount, outputShape,
+                                statistics);
+  }
+
+private:
+  void ensureConnected() {
+    if (_fd >= 0) {
+      return;
+    }
+
+    if (_socketPath.size() >= sizeof(sockaddr_un().sun_path)) {
+      throw DaemonUnavailableException("socket path too long: " + _socketPath);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      throw DaemonUnavailableException(std::string("socket() failed: ") +
+                                       std::strerror(errno));
+    }
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, _socketPath.c_str(),
+                 sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+        0) {
+      int err = errno;
+      close(fd);
+      throw DaemonUnavailableException("cannot connect to " + _socketPath +
+                                       ": " + std::strerror(err));
+    }
+
+    // Frames and model paths only go to a daemon run by this user
+    if (!InferenceDaemon::peerIsSameUser(fd)) {
+      close(fd);
+      throw DaemonUnavailableException(_socketPath +
+                                       " is served by another user");
+    }
+    _fd = fd;
+  }
+
+  void disconnect() {
+    if (_fd >= 0) {
+      close(_fd);
+      _fd = -1;
+    }
+    _inputBuffers.clear();
+    _outputSegments.clear(); // Outputs still held stay mapped
+  }
+
+  // An output segment no caller holds; empty if a new one is needed
+  OutputSegment &freeOutputSegment() {
+    for (OutputSegment &segment : _outputSegments) {
+      if (segment.use_count() == 1) {
+        return segment;
+      }
+    }
+    _outputSegments.emplace_back();
+    return _outputSegments.back();
+  }
+
+  // Send a request and wait for its reply; transport errors drop the
+  // connection so the next call reconnects
+  std::vector<char> roundTrip(InferenceDaemon::MessageType type,
+                              const std::vector<char> &payload,
+                              InferenceDaemon::MessageType expectedReply) {
+    uint32_t replyType = 0;
+    std::vector<char> reply;
+    if (!InferenceDaemon::sendMessage(_fd, type, payload) ||
+        !InferenceDaemon::receiveMessage(_fd, replyType, reply) ||
+        replyType != static_cast<uint32_t>(expectedReply)) {
+      disconnect();
+      throw DaemonUnavailableException("connection to " + _socketPath +
+                                       " lost");
+    }
+    return reply;
+  }
+
+  std::string _socketPath;
+  int _fd;            // Connected socket, or -1
+  std::mutex _mutex;  // One request in flight per connection
+  std::vector<std::unique_ptr<InferenceDaemon::SharedMemoryBuffer>>
+      _inputBuffers;  // Reusable input staging segments
+  std::vector<OutputSegment> _outputSegments; // Reusable output segments
+};
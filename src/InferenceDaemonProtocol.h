@@ -0,0 +1,410 @@
+#pragma once
+
+#include "ErrorHandling.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Wire protocol shared by the local inference daemon and its clients.
+ *
+ * Small control messages travel over a Unix stream socket. Tensor data never
+ * goes through the socket: inputs are staged in POSIX shared memory by the
+ * client and read in place by the daemon, and the output is written into a
+ * segment the client owns and reads in place. Segments are reused between
+ * runs, so a steady stream of frames creates none.
+ */
+namespace InferenceDaemon {
+
+const uint32_t kMagic = 0x4F4E5844; // "ONXD"
+const uint32_t kVersion = 2;
+
+// Environment variable overriding the default socket path
+const char *const kSocketEnvVar = "ONNX_NUKE_DAEMON_SOCKET";
+
+enum MessageType : uint32_t {
+  kLoadRequest = 1,
+  kLoadReply = 2,
+  kRunRequest = 3,
+  kRunReply = 4,
+};
+
+enum Status : uint32_t {
+  kOk = 0,
+  kModelError = 1,     // The model could not be loaded
+  kInferenceError = 2, // The model failed to run on the given inputs
+  kProtocolError = 3,  // Malformed or unexpected request
+};
+
+struct MessageHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t type;
+  uint32_t payloadSize;
+};
+
+/**
+ * Socket path used when none is configured: $ONNX_NUKE_DAEMON_SOCKET, or
+ * the user's $XDG_RUNTIME_DIR, or a private directory in /tmp that
+ * prepareSocketDirectory() creates
+ */
+inline std::string defaultSocketPath() {
+  const char *env = std::getenv(kSocketEnvVar);
+  if (env && env[0] != '\0') {
+    return env;
+  }
+  const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+  if (runtimeDir && runtimeDir[0] != '\0') {
+    return std::string(runtimeDir) + "/onnx_nuke_daemon.sock";
+  }
+  return "/tmp/onnx_nuke_daemon_" + std::to_string(getuid()) +
+         "/daemon.sock";
+}
+
+/**
+ * Create the directory of a socket path, readable by this user only, if it
+ * does not exist, and check that no other user controls it
+ * @param socketPath Path the daemon binds
+ * @throws DaemonUnavailableException if the directory cannot be made or is
+ *         not private to this user
+ */
+inline void prepareSocketDirectory(const std::string &socketPath) {
+  size_t slash = socketPath.rfind('/');
+  if (slash == std::string::npos || slash == 0) {
+    return; // Relative to the working directory, or in /
+  }
+  std::string directory = socketPath.substr(0, slash);
+  if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+    throw DaemonUnavailableException("cannot create " + directory + ": " +
+                                     std::strerror(errno));
+  }
+
+  // Anyone able to replace the socket could serve or read every frame
+  struct stat info;
+  if (lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+    throw DaemonUnavailableException(directory + " is not a directory");
+  }
+  bool shared = (info.st_mode & (S_IWGRP | S_IWOTH)) != 0;
+  if (info.st_uid != getuid() && info.st_uid != 0) {
+    throw DaemonUnavailableException(directory +
+                                     " belongs to another user");
+  }
+  if (shared && (info.st_mode & S_ISVTX) == 0) {
+    throw DaemonUnavailableException(directory +
+                                     " is writable by other users");
+  }
+}
+
+/**
+ * Check that the process at the other end of a connected socket runs as
+ * this user
+ * @param fd Connected Unix socket
+ * @return false if it belongs to another user or cannot be told
+ */
+inline bool peerIsSameUser(int fd) {
+#ifdef SO_PEERCRED
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+    return false;
+  }
+  return credentials.uid == getuid();
+#else
+  uid_t uid;
+  gid_t gid;
+  if (getpeereid(fd, &uid, &gid) != 0) {
+    return false;
+  }
+  return uid == getuid();
+#endif
+}
+
+/**
+ * Build a shared memory name that is unique within this machine
+ */
+inline std::string uniqueSegmentName(const char *prefix) {
+  static std::atomic<uint64_t> counter(0);
+  return std::string("/") + prefix + "-" + std::to_string(getpid()) + "-" +
+         std::to_string(counter++);
+}
+
+/**
+ * Serializes message payloads. Integers are written in host byte order; both
+ * ends always run on the same machine.
+ */
+class MessageWriter {
+public:
+  void u32(uint32_t value) { raw(&value, sizeof(value)); }
+  void u64(uint64_t value) { raw(&value, sizeof(value)); }
+  void str(const std::string &value) {
+    u32(static_cast<uint32_t>(value.size()));
+    raw(value.data(), value.size());
+  }
+  void shape(const std::vector<int64_t> &dims) {
+    u32(static_cast<uint32_t>(dims.size()));
+    for (int64_t d : dims) {
+      u64(static_cast<uint64_t>(d));
+    }
+  }
+  const std::vector<char> &data() const { return _data; }
+
+private:
+  void raw(const void *bytes, size_t size) {
+    const char *begin = static_cast<const char *>(bytes);
+    _data.insert(_data.end(), begin, begin + size);
+  }
+
+  std::vector<char> _data;
+};
+
+/**
+ * Reads payloads produced by MessageWriter; throws on truncated data
+ */
+class MessageReader {
+public:
+  explicit MessageReader(const std::vector<char> &data)
+      : _data(data), _offset(0) {}
+
+  uint32_t u32() {
+    uint32_t value;
+    raw(&value, sizeof(value));
+    return value;
+  }
+  uint64_t u64() {
+    uint64_t value;
+    raw(&value, sizeof(value));
+    return value;
+  }
+  std::string str() {
+    uint32_t size = u32();
+    check(size);
+    std::string value(_data.data() + _offset, size);
+    _offset += size;
+    return value;
+  }
+  std::vector<int64_t> shape() {
+    uint32_t rank = u32();
+    check(static_cast<size_t>(rank) * sizeof(uint64_t));
+    std::vector<int64_t> dims(rank);
+    for (uint32_t d = 0; d < rank; d++) {
+      dims[d] = static_cast<int64_t>(u64());
+    }
+    return dims;
+  }
+
+private:
+  void check(size_t size) const {
+    if (_offset + size > _data.size()) {
+      throw InvalidArgumentException("Truncated inference daemon message");
+    }
+  }
+  void raw(void *bytes, size_t size) {
+    check(size);
+    std::memcpy(bytes, _data.data() + _offset, size);
+    _offset += size;
+  }
+
+  const std::vector<char> &_data;
+  size_t _offset;
+};
+
+inline bool sendAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+#ifdef MSG_NOSIGNAL
+    ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+    ssize_t sent = ::send(fd, bytes, size, 0);
+#endif
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    bytes += sent;
+    size -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+inline bool recvAll(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t received = ::recv(fd, bytes, size, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    bytes += received;
+    size -= static_cast<size_t>(received);
+  }
+  return true;
+}
+
+// Upper bound on control message size; tensors never go through the socket
+const uint32_t kMaxPayloadSize = 16 * 1024 * 1024;
+
+/**
+ * Send one framed message
+ * @return False if the connection is broken
+ */
+inline bool sendMessage(int fd, MessageType type,
+                        const std::vector<char> &payload) {
+  MessageHeader header;
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.type = type;
+  header.payloadSize = static_cast<uint32_t>(payload.size());
+  return sendAll(fd, &header, sizeof(header)) &&
+         (payload.empty() || sendAll(fd, payload.data(), payload.size()));
+}
+
+/**
+ * Receive one framed message
+ * @return False if the connection is closed, broken or speaks another protocol
+ */
+inline bool receiveMessage(int fd, uint32_t &type, std::vector<char> &payload) {
+  MessageHeader header;
+  if (!recvAll(fd, &header, sizeof(header)) || header.magic != kMagic ||
+      header.version != kVersion || header.payloadSize > kMaxPayloadSize) {
+    return false;
+  }
+  type = header.type;
+  payload.resize(header.payloadSize);
+  return header.payloadSize == 0 ||
+         recvAll(fd, payload.data(), header.payloadSize);
+}
+
+/**
+ * RAII wrapper around a mapped POSIX shared memory segment
+ */
+class SharedMemoryBuffer {
+public:
+  SharedMemoryBuffer() : _data(nullptr), _size(0), _owner(false) {}
+  ~SharedMemoryBuffer() { release(); }
+
+  SharedMemoryBuffer(const SharedMemoryBuffer &) = delete;
+  SharedMemoryBuffer &operator=(const SharedMemoryBuffer &) = delete;
+
+  /**
+   * Create a new segment (readable and writable by this user only)
+   * @param name Segment name, starting with '/'
+   * @param size Size in bytes
+   * @param owner Whether to unlink the segment when this buffer is released
+   */
+  void create(const std::string &name, size_t size, bool owner = true) {
+    release();
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      throw ONNXPluginError("shm_open(" + name +
+                            ") failed: " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(std::max<size_t>(size, 1))) != 0) {
+      int err = errno;
+      close(fd);
+      shm_unlink(name.c_str());
+      throw ONNXPluginError("ftruncate(" + name +
+                            ") failed: " + std::strerror(err));
+    }
+    map(fd, name, size, PROT_READ | PROT_WRITE);
+    _owner = owner;
+  }
+
+  /**
+   * Map an existing segment
+   * @param name Segment name
+   * @param size Expected size in bytes
+   * @param writable Whether the mapping should be writable
+   * @param owner Whether to unlink the segment when this buffer is released,
+   *        e.g. for a segment another process created for this one
+   */
+  void open(const std::string &name, size_t size, bool writable,
+            bool owner = false) {
+    release();
+    int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0) {
+      throw ONNXPluginError("shm_open(" + name +
+                            ") failed: " + std::strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size) {
+      close(fd);
+      throw ONNXPluginError("Shared memory segment " + name +
+                            " is smaller than expected");
+    }
+    map(fd, name, size, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+    _owner = owner;
+  }
+
+  /**
+   * Unmap the segment, unlinking it if this buffer owns it
+   */
+  void release() {
+    if (_data) {
+      munmap(_data, std::max<size_t>(_size, 1));
+    }
+    if (_owner && !_name.empty()) {
+      shm_unlink(_name.c_str());
+    }
+    _data = nullptr;
+    _size = 0;
+    _owner = false;
+    _name.clear();
+  }
+
+  /**
+   * Remove the segment name; the mapping stays valid until release()
+   */
+  void unlink() {
+    if (!_name.empty()) {
+      shm_unlink(_name.c_str());
+    }
+    _owner = false;
+  }
+
+  /**
+   * Keep the segment when this buffer is released; another process now owns
+   * it and is responsible for unlinking it
+   */
+  void detach() { _owner = false; }
+
+  void *data() const { return _data; }
+  size_t size() const { return _size; }
+  const std::string &name() const { return _name; }
+
+private:
+  void map(int fd, const std::string &name, size_t size, int protection) {
+    void *data =
+        mmap(nullptr, std::max<size_t>(size, 1), protection, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw ONNXPluginError("mmap(" + name + ") failed: " + std::strerror(err));
+    }
+    _data = data;
+    _size = size;
+    _name = name;
+  }
+
+  void *_data;
+  size_t _size;
+  bool _owner;
+  std::string _name;
+};
+
+} // namespace InferenceDaemon
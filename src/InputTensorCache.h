@@ -0,0 +1,218 @@
+#pragma once
+
+#include "Metrics.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * InputTensorCache - Process-wide cache of packed model input tensors
+ *
+ * Several ONNX nodes hung off the same upstream image would otherwise each
+ * fetch the full frame and pack an identical NCHW tensor. Entries are keyed by
+ * the upstream operator hash plus everything that affects packing, and are
+ * handed out as shared read-only buffers. The cache is bounded in bytes and
+ * evicts least recently used entries; evicted buffers stay alive for as long
+ * as a node still references them.
+ */
+class InputTensorCache {
+public:
+  using TensorPtr = std::shared_ptr<const std::vector<float>>;
+
+  // Everything that determines the contents of a packed input tensor
+  struct Key {
+    uint64_t sourceHash;        // Hash of the upstream image operator
+    int x, y, r, t;             // Source region the tensor was packed from
+    int width, height;          // Packed tensor width and height
+    int channels;               // Packed tensor channel count
+    std::string channelMapping; // Source channels in tensor channel order
+    std::string preprocess;     // Description of the preprocessing settings
+
+    Key()
+        : sourceHash(0), x(0), y(0), r(0), t(0), width(0), height(0),
+          channels(0), channelMapping(), preprocess() {}
+
+    bool operator<(const Key &other) const {
+      return std::tie(sourceHash, x, y, r, t, width, height, channels,
+                      channelMapping, preprocess) <
+             std::tie(other.sourceHash, other.x, other.y, other.r, other.t,
+                      other.width, other.height, other.channels,
+                      other.channelMapping, other.preprocess);
+    }
+  };
+
+  /**
+   * Get the process-wide cache instance
+   */
+  static InputTensorCache &instance() {
+    static InputTensorCache cache;
+    return cache;
+  }
+
+  /**
+   * Look up a packed tensor
+   * @param key The tensor key
+   * @return The shared tensor, or nullptr if it is not cached
+   */
+  TensorPtr find(const Key &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key);
+    if (it == _entries.end()) {
+      ++_misses;
+      Metrics::registry().inputCacheMisses.add();
+      return nullptr;
+    }
+
+    // Move to the front of the LRU list
+    _lru.splice(_lru.begin(), _lru, it->second.lruPosition);
+    ++_hits;
+    Metrics::registry().inputCacheHits.add();
+    return it->second.tensor;
+  }
+
+  /**
+   * Insert a packed tensor. If another caller inserted the same key in the
+   * meantime, the existing tensor is kept and returned instead.
+   * @param key The tensor key
+   * @param tensor The packed tensor data (moved into the cache)
+   * @return The shared tensor now associated with the key
+   */
+  TensorPtr insert(const Key &key, std::vector<float> &&tensor) {
+    TensorPtr shared = std::make_shared<const std::vector<float>>(
+        std::move(tensor));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+      _lru.splice(_lru.begin(), _lru, it->second.lruPosition);
+      return it->second.tensor;
+    }
+
+    size_t bytes = shared->size() * sizeof(float);
+    if (bytes > _capacityBytes) {
+      // Too large to cache, but still usable by the caller
+      return shared;
+    }
+
+    _lru.push_front(key);
+    Entry entry;
+    entry.tensor = shared;
+    entry.bytes = bytes;
+    entry.lruPosition = _lru.begin();
+    _entries.emplace(key, entry);
+    _sizeBytes += bytes;
+
+    evictToCapacity();
+    publishSize();
+    return shared;
+  }
+
+  /**
+   * Look up a packed tensor, packing and inserting it on a miss. The packing
+   * function runs without the cache lock held.
+   * @param key The tensor key
+   * @param pack Function that fills the tensor for this key
+   * @return The shared tensor for the key
+   */
+  TensorPtr findOrPack(const Key &key,
+                       const std::function<void(std::vector<float> &)> &pack) {
+    TensorPtr cached = find(key);
+    if (cached) {
+      return cached;
+    }
+
+    std::vector<float> tensor;
+    pack(tensor);
+    Metrics::registry().bytesAllocated.add(tensor.size() * sizeof(float));
+    return insert(key, std::move(tensor));
+  }
+
+  /**
+   * Set the maximum number of bytes held by the cache
+   */
+  void setCapacityBytes(size_t capacityBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacityBytes = capacityBytes;
+    evictToCapacity();
+    publishSize();
+  }
+
+  /**
+   * Drop every cached tensor
+   */
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+    _sizeBytes = 0;
+    publishSize();
+  }
+
+  // Cache statistics
+  size_t sizeBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sizeBytes;
+  }
+  size_t capacityBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _capacityBytes;
+  }
+  uint64_t hits() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+  }
+  uint64_t misses() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+  }
+
+private:
+  struct Entry {
+    TensorPtr tensor;
+    size_t bytes;
+    std::list<Key>::iterator lruPosition;
+  };
+
+  InputTensorCache()
+      : _capacityBytes(kDefaultCapacityBytes), _sizeBytes(0), _hits(0),
+        _misses(0) {}
+  InputTensorCache(const InputTensorCache &) = delete;
+  InputTensorCache &operator=(const InputTensorCache &) = delete;
+
+  // Drop least recently used entries until the cache fits its budget.
+  // Caller must hold _mutex.
+  void evictToCapacity() {
+    while (_sizeBytes > _capacityBytes && !_lru.empty()) {
+      auto it = _entries.find(_lru.back());
+      if (it != _entries.end()) {
+        _sizeBytes -= it->second.bytes;
+        _entries.erase(it);
+      }
+      _lru.pop_back();
+    }
+  }
+
+  // Report the resident size to the metrics registry. Caller must hold
+  // _mutex.
+  void publishSize() const {
+    Metrics::registry().inputCacheBytes.set(static_cast<int64_t>(_sizeBytes));
+  }
+
+  // Enough for several 4K RGB float plates
+  static constexpr size_t kDefaultCapacityBytes = size_t(1) << 30;
+
+  mutable std::mutex _mutex;
+  std::map<Key, Entry> _entries;
+  std::list<Key> _lru; // Most recently used at the front
+  size_t _capacityBytes;
+  size_t _sizeBytes;
+  uint64_t _hits;
+  uint64_t _misses;
+};
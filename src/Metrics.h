@@ -0,0 +1,468 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * Metrics - Process-wide performance counters shared by every node
+ *
+ * Updates are single relaxed atomic operations, so nodes can record from any
+ * render thread without locking. When ONNX_NUKE_METRICS_FILE is set, a
+ * background thread periodically writes every metric to that file, as
+ * Prometheus text exposition (for the node exporter textfile collector) or as
+ * JSON when the path ends in ".json". "{pid}" in the path is replaced by the
+ * process id so several Nuke processes can write side by side.
+ */
+namespace Metrics {
+
+// Environment variables configuring the exporter
+const char *const kFileEnvVar = "ONNX_NUKE_METRICS_FILE";
+const char *const kIntervalEnvVar = "ONNX_NUKE_METRICS_INTERVAL";
+
+/**
+ * Monotonically increasing count
+ */
+class Counter {
+public:
+  Counter() : _value(0) {}
+  void add(uint64_t amount = 1) {
+    _value.fetch_add(amount, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> _value;
+};
+
+/**
+ * Value that can go up and down
+ */
+class Gauge {
+public:
+  Gauge() : _value(0) {}
+  void set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+  void add(int64_t amount) {
+    _value.fetch_add(amount, std::memory_order_relaxed);
+  }
+  int64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> _value;
+};
+
+/**
+ * Duration histogram with fixed bucket upper bounds (in seconds)
+ */
+class Histogram {
+public:
+  explicit Histogram(const std::vector<double> &bounds)
+      : _bounds(bounds),
+        _buckets(new std::atomic<uint64_t>[bounds.size() + 1]), _count(0),
+        _sumNanos(0) {
+    for (size_t i = 0; i <= _bounds.size(); i++) {
+      _buckets[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Record one observation
+   * @param seconds The observed duration
+   */
+  void observe(double seconds) {
+    size_t bucket = static_cast<size_t>(
+        std::lower_bound(_bounds.begin(), _bounds.end(), seconds) -
+        _bounds.begin());
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sumNanos.fetch_add(static_cast<uint64_t>(std::max(0.0, seconds) * 1e9),
+                        std::memory_order_relaxed);
+  }
+
+  uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+  double sum() const {
+    return _sumNanos.load(std::memory_order_relaxed) / 1e9;
+  }
+  const std::vector<double> &bounds() const { return _bounds; }
+
+  // Observations in bucket i (the last bucket is +Inf)
+  uint64_t bucketCount(size_t i) const {
+    return _buckets[i].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Estimate a quantile by linear interpolation inside its bucket, as
+   * Prometheus' histogram_quantile does
+   * @param q Quantile in [0, 1]
+   * @return Estimated duration in seconds (0 when empty)
+   */
+  double quantile(double q) const {
+    uint64_t total = 0;
+    std::vector<uint64_t> counts(_bounds.size() + 1);
+    for (size_t i = 0; i <= _bounds.size(); i++) {
+      counts[i] = bucketCount(i);
+      total += counts[i];
+    }
+    if (total == 0) {
+      return 0.0;
+    }
+
+    double rank = q * total;
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= _bounds.size(); i++) {
+      if (cumulative + counts[i] >= rank && counts[i] > 0) {
+        if (i == _bounds.size()) {
+          return _bounds.empty() ? 0.0 : _bounds.back();
+        }
+        double lower = i == 0 ? 0.0 : _bounds[i - 1];
+        double fraction = (rank - cumulative) / counts[i];
+        return lower + (_bounds[i] - lower) * fraction;
+      }
+      cumulative += counts[i];
+    }
+    return _bounds.empty() ? 0.0 : _bounds.back();
+  }
+
+  // Exponential bounds from 1 ms to about 65 s
+  static std::vector<double> latencyBounds() {
+    std::vector<double> bounds;
+    for (double bound = 0.001; bound < 70.0; bound *= 2.0) {
+      bounds.push_back(bound);
+    }
+    return bounds;
+  }
+
+private:
+  std::vector<double> _bounds;
+  std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _sumNanos;
+};
+
+/**
+ * Records the time from construction to destruction into a histogram
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &histogram)
+      : _histogram(histogram), _start(std::chrono::steady_clock::now()),
+        _active(true) {}
+  ~ScopedTimer() {
+    if (_active) {
+      _histogram.observe(std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - _start)
+                             .count());
+    }
+  }
+
+  // Do not record this measurement
+  void dismiss() { _active = false; }
+
+private:
+  Histogram &_histogram;
+  std::chrono::steady_clock::time_point _start;
+  bool _active;
+};
+
+/**
+ * The process-wide set of metrics
+ */
+class Registry {
+public:
+  // Inference
+  Counter inferences;        // Successful model runs
+  Counter inferenceFailures; // Model runs that threw
+  Histogram runLatency;      // Duration of each model run
+
+  // Models
+  Counter modelLoads;      // Models loaded (in-process or via the daemon)
+  Histogram modelLoadTime; // Duration of each model load
+  Gauge modelsLoaded;      // Models currently loaded
+
+  // Shared input tensor cache
+  Counter inputCacheHits;
+  Counter inputCacheMisses;
+  Gauge inputCacheBytes; // Bytes currently held by the cache
+
+  // Tensor memory
+  Counter bytesAllocated; // Bytes allocated for input and output tensors
+
+  // Incremental tiled inference
+  Counter tilesInferred; // Tiles whose inputs changed and were inferred
+  Counter tilesSkipped;  // Tiles served from the previous output
+
+  // Playback governor
+  Counter playbackDeadlinesMissed; // Played frames slower than the target
+
+  static Registry &instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  /**
+   * Render every metric in Prometheus text exposition format
+   * @param inferencesPerSecond Recent inference rate to report
+   */
+  std::string toPrometheus(double inferencesPerSecond) const {
+    std::ostringstream out;
+    std::string labels = "{pid=\"" + std::to_string(getpid()) + "\"}";
+
+    writeCounter(out, "onnx_nuke_inferences_total",
+                 "Successful model runs", labels, inferences.value());
+    writeCounter(out, "onnx_nuke_inference_failures_total",
+                 "Model runs that failed", labels, inferenceFailures.value());
+    out << "# HELP onnx_nuke_inferences_per_second Inference rate over the "
+           "last export interval\n"
+        << "# TYPE onnx_nuke_inferences_per_second gauge\n"
+        << "onnx_nuke_inferences_per_second" << labels << " "
+        << inferencesPerSecond << "\n";
+    writeHistogram(out, "onnx_nuke_run_latency_seconds",
+                   "Duration of model runs", runLatency);
+
+    writeCounter(out, "onnx_nuke_model_loads_total", "Models loaded", labels,
+                 modelLoads.value());
+    writeHistogram(out, "onnx_nuke_model_load_seconds",
+                   "Duration of model loads", modelLoadTime);
+    writeGauge(out, "onnx_nuke_models_loaded", "Models currently loaded",
+               labels, modelsLoaded.value());
+
+    writeCounter(out, "onnx_nuke_input_cache_hits_total",
+                 "Shared input tensor cache hits", labels,
+                 inputCacheHits.value());
+    writeCounter(out, "onnx_nuke_input_cache_misses_total",
+                 "Shared input tensor cache misses", labels,
+                 inputCacheMisses.value());
+    writeGauge(out, "onnx_nuke_input_cache_bytes",
+               "Bytes held by the shared input tensor cache", labels,
+               inputCacheBytes.value());
+
+    writeCounter(out, "onnx_nuke_tensor_bytes_allocated_total",
+                 "Bytes allocated for input and output tensors", labels,
+                 bytesAllocated.value());
+
+    writeCounter(out, "onnx_nuke_tiles_inferred_total",
+                 "Tiles inferred by incremental tiled inference", labels,
+                 tilesInferred.value());
+    writeCounter(out, "onnx_nuke_tiles_skipped_total",
+                 "Unchanged tiles served from the previous output", labels,
+                 tilesSkipped.value());
+    writeCounter(out, "onnx_nuke_playback_deadlines_missed_total",
+                 "Played back frames slower than the target frame rate",
+                 labels, playbackDeadlinesMissed.value());
+    return out.str();
+  }
+
+  /**
+   * Render every metric as a JSON object, with latency percentiles
+   * @param inferencesPerSecond Recent inference rate to report
+   */
+  std::string toJSON(double inferencesPerSecond) const {
+    std::ostringstream out;
+    uint64_t hits = inputCacheHits.value();
+    uint64_t lookups = hits + inputCacheMisses.value();
+
+    out << "{\n"
+        << "  \"pid\": " << getpid() << ",\n"
+        << "  \"inferences_total\": " << inferences.value() << ",\n"
+        << "  \"inference_failures_total\": " << inferenceFailures.value()
+        << ",\n"
+        << "  \"inferences_per_second\": " << inferencesPerSecond << ",\n"
+        << "  \"run_latency_seconds\": " << histogramJSON(runLatency) << ",\n"
+        << "  \"model_loads_total\": " << modelLoads.value() << ",\n"
+        << "  \"model_load_seconds\": " << histogramJSON(modelLoadTime)
+        << ",\n"
+        << "  \"models_loaded\": " << modelsLoaded.value() << ",\n"
+        << "  \"input_cache_hits_total\": " << hits << ",\n"
+        << "  \"input_cache_misses_total\": " << inputCacheMisses.value()
+        << ",\n"
+        << "  \"input_cache_hit_rate\": "
+        << (lookups > 0 ? static_cast<double>(hits) / lookups : 0.0) << ",\n"
+        << "  \"input_cache_bytes\": " << inputCacheBytes.value() << ",\n"
+        << "  \"tensor_bytes_allocated_total\": " << bytesAllocated.value()
+        << ",\n"
+        << "  \"tiles_inferred_total\": " << tilesInferred.value() << ",\n"
+        << "  \"tiles_skipped_total\": " << tilesSkipped.value() << ",\n"
+        << "  \"playback_deadlines_missed_total\": "
+        << playbackDeadlinesMissed.value() << "\n"
+        << "}\n";
+    return out.str();
+  }
+
+private:
+  Registry();
+  Registry(const Registry &) = delete;
+  Registry &operator=(const Registry &) = delete;
+
+  static void writeCounter(std::ostream &out, const char *name,
+                           const char *help, const std::string &labels,
+                           uint64_t value) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << labels << " " << value << "\n";
+  }
+
+  static void writeGauge(std::ostream &out, const char *name, const char *help,
+                         const std::string &labels, int64_t value) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << labels << " " << value << "\n";
+  }
+
+  static void writeHistogram(std::ostream &out, const char *name,
+                             const char *help, const Histogram &histogram) {
+    std::string pid = std::to_string(getpid());
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " histogram\n";
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= histogram.bounds().size(); i++) {
+      cumulative += histogram.bucketCount(i);
+      out << name << "_bucket{pid=\"" << pid << "\",le=\"";
+      if (i < histogram.bounds().size()) {
+        out << histogram.bounds()[i];
+      } else {
+        out << "+Inf";
+      }
+      out << "\"} " << cumulative << "\n";
+    }
+    out << name << "_sum{pid=\"" << pid << "\"} " << histogram.sum() << "\n"
+        << name << "_count{pid=\"" << pid << "\"} " << cumulative << "\n";
+  }
+
+  static std::string histogramJSON(const Histogram &histogram) {
+    std::ostringstream out;
+    uint64_t count = histogram.count();
+    out << "{\"count\": " << count << ", \"sum\": " << histogram.sum()
+        << ", \"mean\": " << (count > 0 ? histogram.sum() / count : 0.0)
+        << ", \"p50\": " << histogram.quantile(0.5)
+        << ", \"p90\": " << histogram.quantile(0.9)
+        << ", \"p99\": " << histogram.quantile(0.99) << "}";
+    return out.str();
+  }
+
+  class FileExporter;
+  std::unique_ptr<FileExporter> _exporter;
+
+public:
+  ~Registry();
+};
+
+/**
+ * Background thread writing the registry to a file at a fixed interval. The
+ * file is replaced atomically so scrapers never see a partial write.
+ */
+class Registry::FileExporter {
+public:
+  FileExporter(const Registry &registry, const std::string &path,
+               double intervalSeconds)
+      : _registry(registry), _path(path), _interval(intervalSeconds),
+        _json(path.size() > 5 && path.compare(path.size() - 5, 5, ".json") ==
+                                      0),
+        _stop(false), _thread(&FileExporter::run, this) {}
+
+  ~FileExporter() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+  }
+
+private:
+  void run() {
+    uint64_t lastInferences = _registry.inferences.value();
+    auto lastTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      bool stopping = _wake.wait_for(
+          lock, std::chrono::duration<double>(_interval),
+          [this]() { return _stop; });
+
+      auto now = std::chrono::steady_clock::now();
+      double elapsed = std::chrono::duration<double>(now - lastTime).count();
+      uint64_t inferences = _registry.inferences.value();
+      double rate = elapsed > 0.0 ? (inferences - lastInferences) / elapsed
+                                  : 0.0;
+      lastInferences = inferences;
+      lastTime = now;
+
+      write(_json ? _registry.toJSON(rate) : _registry.toPrometheus(rate));
+      if (stopping) {
+        return;
+      }
+    }
+  }
+
+  void write(const std::string &contents) const {
+    std::string temporary = _path + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::trunc);
+      if (!file) {
+        std::cerr << "Metrics: cannot write " << temporary << std::endl;
+        return;
+      }
+      file << contents;
+    }
+    if (std::rename(temporary.c_str(), _path.c_str()) != 0) {
+      std::cerr << "Metrics: cannot replace " << _path << std::endl;
+    }
+  }
+
+  const Registry &_registry;
+  std::string _path;
+  double _interval;
+  bool _json;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  bool _stop;
+  std::thread _thread; // Declared last: starts once the rest is initialized
+};
+
+inline Registry::Registry()
+    : runLatency(Histogram::latencyBounds()),
+      modelLoadTime(Histogram::latencyBounds()) {
+  const char *path = std::getenv(kFileEnvVar);
+  if (!path || path[0] == '\0') {
+    return;
+  }
+
+  std::string resolved = path;
+  size_t token = resolved.find("{pid}");
+  if (token != std::string::npos) {
+    resolved.replace(token, 5, std::to_string(getpid()));
+  }
+
+  double interval = 15.0;
+  if (const char *value = std::getenv(kIntervalEnvVar)) {
+    interval = std::max(0.1, std::atof(value));
+  }
+  _exporter.reset(new FileExporter(*this, resolved, interval));
+}
+
+inline Registry::~Registry() {
+  // Stop the exporter (writing one last snapshot) before members go away
+  _exporter.reset();
+}
+
+/**
+ * Shorthand for the process-wide registry
+ */
+inline Registry &registry() { return Registry::instance(); }
+
+} // namespace Metrics
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "ErrorHandling.h"
+#include "TensorProcessor.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * NormalizationIndex - Output statistics of every frame a node has inferred
+ *
+ * Normalizing each frame by its own range makes sequences flicker. The index
+ * keeps a small summary of each inferred frame (finite range, mean, channel
+ * ranges and a percentile table), so the range of a whole sequence or of a
+ * sliding window of frames can be computed without inferring those frames
+ * again. The index can be saved to and loaded from a text file, e.g. one
+ * written by onnx_batch --stats-file.
+ */
+class NormalizationIndex {
+public:
+  // How the normalization range of a frame is chosen
+  enum RangeMode {
+    kRangeFrame = 0,    // The frame's own statistics
+    kRangeSequence = 1, // Every indexed frame
+    kRangeWindow = 2,   // Indexed frames within a window around the frame
+  };
+
+  // Percentile table resolution: one entry every 1 / kPercentileSteps
+  static const int kPercentileSteps = 200;
+
+  /**
+   * Summary of one frame's output
+   */
+  struct FrameStatistics {
+    float min;   // Finite minimum
+    float max;   // Finite maximum
+    double mean; // Mean of the finite values
+    std::vector<TensorProcessor::MinMax> channels; // Finite range per channel
+    std::vector<float> percentiles; // kPercentileSteps + 1 values, ascending
+
+    FrameStatistics()
+        : min(std::numeric_limits<float>::max()),
+          max(std::numeric_limits<float>::lowest()), mean(0.0), channels(),
+          percentiles() {}
+
+    /**
+     * Summarize the statistics collected while copying an output
+     * @param stats Statistics from TensorProcessor::copyOutput
+     * @param channelCount Output channels (planes) to keep ranges for
+     */
+    static FrameStatistics
+    fromOutput(const TensorProcessor::OutputStatistics &stats,
+               int channelCount) {
+      FrameStatistics frame;
+      size_t count = std::min(stats.channels.size(),
+                              static_cast<size_t>(std::max(0, channelCount)));
+      frame.channels.assign(stats.channels.begin(),
+                            stats.channels.begin() + count);
+      TensorProcessor::MinMax range = stats.range(0, count);
+      frame.min = range.min;
+      frame.max = range.max;
+      frame.mean = stats.mean;
+
+      std::vector<double> fractions(kPercentileSteps + 1);
+      for (int i = 0; i <= kPercentileSteps; i++) {
+        fractions[i] = static_cast<double>(i) / kPercentileSteps;
+      }
+      frame.percentiles = stats.percentiles(fractions);
+      if (frame.hasValues()) {
+        // The table ends are the exact extremes
+        frame.percentiles.front() = frame.min;
+        frame.percentiles.back() = frame.max;
+      }
+      return frame;
+    }
+
+    bool hasValues() const { return min <= max; }
+
+    /**
+     * Fraction of the frame's values at or below a value, from the table
+     */
+    double cumulative(float value) const {
+      if (percentiles.size() < 2 || value < percentiles.front()) {
+        return 0.0;
+      }
+      if (value >= percentiles.back()) {
+        return 1.0;
+      }
+      size_t upper = static_cast<size_t>(
+          std::upper_bound(percentiles.begin(), percentiles.end(), value) -
+          percentiles.begin());
+      float lo = percentiles[upper - 1];
+      float hi = percentiles[upper];
+      double t = hi > lo ? (value - lo) / (static_cast<double>(hi) - lo) : 1.0;
+      return (upper - 1 + t) / (percentiles.size() - 1);
+    }
+  };
+
+  /**
+   * Add or replace the statistics of a frame
+   */
+  void store(int frame, const FrameStatistics &statistics) {
+    _frames[frame] = statistics;
+  }
+
+  bool contains(int frame) const { return _frames.count(frame) != 0; }
+  size_t size() const { return _frames.size(); }
+  void clear() { _frames.clear(); }
+
+  /**
+   * Normalization range for a frame pooled over the frames selected by
+   * mode. Percentiles are those of all pooled values, each frame weighted
+   * equally; 0 and 1 give the exact minimum and maximum.
+   * @param frame The frame being normalized
+   * @param mode The RangeMode
+   * @param window Frames either side of frame for kRangeWindow
+   * @param low Lower percentile as a fraction, e.g. 0.01
+   * @param high Upper percentile as a fraction, e.g. 0.99
+   * @param minValue Output range minimum
+   * @param maxValue Output range maximum
+   * @return False if no pooled frame has finite values
+   */
+  bool range(int frame, RangeMode mode, int window, double low, double high,
+             float &minValue, float &maxValue) const {
+    std::vector<const FrameStatistics *> frames = select(frame, mode, window);
+    if (frames.empty()) {
+      return false;
+    }
+
+    minValue = std::numeric_limits<float>::max();
+    maxValue = std::numeric_limits<float>::lowest();
+    for (const FrameStatistics *stats : frames) {
+      minValue = std::min(minValue, stats->min);
+      maxValue = std::max(maxValue, stats->max);
+    }
+    if (low > 0.0) {
+      minValue = pooledPercentile(frames, low, minValue, maxValue);
+    }
+    if (high < 1.0) {
+      maxValue = pooledPercentile(frames, high, minValue, maxValue);
+    }
+    return true;
+  }
+
+  /**
+   * Finite range of each channel pooled over the frames selected by mode
+   * @return One range per channel; empty if no pooled frame has values
+   */
+  std::vector<TensorProcessor::MinMax> channelRanges(int frame, RangeMode mode,
+                                                     int window) const {
+    std::vector<TensorProcessor::MinMax> pooled;
+    for (const FrameStatistics *stats : select(frame, mode, window)) {
+      if (pooled.size() < stats->channels.size()) {
+        pooled.resize(stats->channels.size(),
+                      TensorProcessor::MinMax{
+                          std::numeric_limits<float>::max(),
+                          std::numeric_limits<float>::lowest()});
+      }
+      for (size_t c = 0; c < stats->channels.size(); c++) {
+        pooled[c].min = std::min(pooled[c].min, stats->channels[c].min);
+        pooled[c].max = std::max(pooled[c].max, stats->channels[c].max);
+      }
+    }
+    return pooled;
+  }
+
+  /**
+   * Write the index as text, one frame per line
+   * @throws ConfigurationException if the file cannot be written
+   */
+  void save(const std::string &path) const {
+    std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream file(tmpPath, std::ios::trunc);
+      file.precision(std::numeric_limits<float>::max_digits10);
+      file << fileHeader() << " " << kFileVersion << "\n";
+      for (const auto &entry : _frames) {
+        const FrameStatistics &stats = entry.second;
+        file << entry.first << " " << stats.min << " " << stats.max << " "
+             << stats.mean << " " << stats.channels.size();
+        for (const TensorProcessor::MinMax &channel : stats.channels) {
+          file << " " << channel.min << " " << channel.max;
+        }
+        file << " " << stats.percentiles.size();
+        for (float value : stats.percentiles) {
+          file << " " << value;
+        }
+        file << "\n";
+      }
+      if (!file) {
+        throw ConfigurationException("Cannot write normalization stats to " +
+                                     tmpPath);
+      }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+      throw ConfigurationException("Cannot write normalization stats to " +
+                                   path);
+    }
+  }
+
+  /**
+   * Merge frames from a file written by save(); frames in the file replace
+   * frames already indexed
+   * @throws ConfigurationException if the file is missing or malformed
+   */
+  void load(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+      throw ConfigurationException("Cannot read normalization stats from " +
+                                   path);
+    }
+
+    std::string header;
+    int version = 0;
+    if (!(file >> header >> version) || header != fileHeader() ||
+        version != kFileVersion) {
+      throw ConfigurationException(path +
+                                   " is not a normalization stats file");
+    }
+
+    std::map<int, FrameStatistics> frames;
+    std::string line;
+    std::getline(file, line); // Rest of the header line
+    while (std::getline(file, line)) {
+      if (line.empty()) {
+        continue;
+      }
+      std::istringstream fields(line);
+      int frame = 0;
+      size_t channelCount = 0, percentileCount = 0;
+      FrameStatistics stats;
+      bool ok = static_cast<bool>(fields >> frame >> stats.min >> stats.max >>
+                                  stats.mean >> channelCount);
+      for (size_t c = 0; ok && c < channelCount; c++) {
+        TensorProcessor::MinMax channel{0.0f, 0.0f};
+        ok = static_cast<bool>(fields >> channel.min >> channel.max);
+        stats.channels.push_back(channel);
+      }
+      ok = ok && static_cast<bool>(fields >> percentileCount);
+      for (size_t i = 0; ok && i < percentileCount; i++) {
+        float value = 0.0f;
+        ok = static_cast<bool>(fields >> value);
+        stats.percentiles.push_back(value);
+      }
+      if (!ok) {
+        throw ConfigurationException("Malformed line in " + path + ": " +
+                                     line);
+      }
+      frames[frame] = stats;
+    }
+
+    for (const auto &entry : frames) {
+      _frames[entry.first] = entry.second;
+    }
+  }
+
+private:
+  // Indexed frames with finite values that the mode pools for frame
+  std::vector<const FrameStatistics *> select(int frame, RangeMode mode,
+                                              int window) const {
+    std::vector<const FrameStatistics *> frames;
+    auto begin = _frames.begin();
+    auto end = _frames.end();
+    if (mode == kRangeFrame) {
+      begin = _frames.find(frame);
+      end = begin == _frames.end() ? begin : std::next(begin);
+    } else if (mode == kRangeWindow) {
+      begin = _frames.lower_bound(frame - std::max(0, window));
+      end = _frames.upper_bound(frame + std::max(0, window));
+    }
+    for (auto it = begin; it != end; ++it) {
+      if (it->second.hasValues()) {
+        frames.push_back(&it->second);
+      }
+    }
+    return frames;
+  }
+
+  // Value below which a fraction of the pooled values lie, found by
+  // bisection on the mean of the frames' cumulative distributions
+  static float
+  pooledPercentile(const std::vector<const FrameStatistics *> &frames,
+                   double fraction, float lo, float hi) {
+    for (int i = 0; i < 40 && lo < hi; i++) {
+      float mid = lo + (hi - lo) * 0.5f;
+      if (mid <= lo || mid >= hi) {
+        break;
+      }
+      double below = 0.0;
+      for (const FrameStatistics *stats : frames) {
+        below += stats->cumulative(mid);
+      }
+      if (below / frames.size() < fraction) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return hi;
+  }
+
+  // First line of a stats file: "<kFileHeader> <kFileVersion>"
+  static const char *fileHeader() { return "onnx_nuke_normalization_stats"; }
+  static const int kFileVersion = 1;
+
+  std::map<int, FrameStatistics> _frames;
+};
@@ -0,0 +1,510 @@
+/**
+ * onnx_batch - Headless batch runner for ONNX models on image sequences
+ *
+ * Runs the same preprocessing, inference and normalization as the
+ * ONNXRuntimeOp node using the Nuke-free core, so sequences can be
+ * pre-computed without a Nuke license.
+ */
+
+#include "ErrorHandling.h"
+#include "ImageIO.h"
+#include "NormalizationIndex.h"
+#include "ONNXInferenceProcessor.h"
+#include "ONNXModelManager.h"
+#include "TensorProcessor.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Number of channels the node packs from each input (RGB)
+const int kPackedChannels = 3;
+
+struct BatchOptions {
+  std::string modelPath;
+  std::vector<std::string> inputPatterns; // One per image input, in order
+  std::vector<std::vector<float>> parameters; // One per non-image input
+  std::string outputPattern;
+  int firstFrame;
+  int lastFrame;
+  int frameStep;
+  int threads;        // Concurrent batches in flight
+  int batchSize;      // Frames stacked along the batch axis per Run
+  int intraOpThreads; // ONNX Runtime threads per Run (0 = default)
+  bool useGPU;
+  bool normalize;
+  TensorProcessor::NormalizeMode normalizeMode;
+  std::string normalizeLayers; // Channels per layer for per-layer mode
+  std::string statsFile;       // Per-frame output statistics to update
+  int rawWidth, rawHeight, rawChannels; // Size of headerless .raw inputs
+
+  BatchOptions()
+      : modelPath(), inputPatterns(), parameters(), outputPattern(),
+        firstFrame(1),
+        lastFrame(1), frameStep(1), threads(1), batchSize(1),
+        intraOpThreads(0), useGPU(false), normalize(false),
+        normalizeMode(TensorProcessor::kNormalizeGlobal), normalizeLayers(),
+        statsFile(), rawWidth(0), rawHeight(0), rawChannels(0) {}
+};
+
+// Accumulated timings across all worker threads
+struct BatchStats {
+  std::atomic<int> framesWritten;
+  std::atomic<int> framesFailed;
+  std::atomic<long long> pixelsProcessed;
+  std::atomic<long long> readMicros;
+  std::atomic<long long> inferenceMicros;
+  std::atomic<long long> writeMicros;
+  NormalizationIndex frameStatistics; // Output statistics per frame
+  std::mutex frameStatisticsMutex;
+
+  BatchStats()
+      : framesWritten(0), framesFailed(0), pixelsProcessed(0), readMicros(0),
+        inferenceMicros(0), writeMicros(0), frameStatistics(),
+        frameStatisticsMutex() {}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+long long microsSince(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               start)
+      .count();
+}
+
+void printUsage(const char *program) {
+  std::cerr
+      << "Usage: " << program
+      << " --model model.onnx --input in.%04d.pfm [--input aux.####.pfm ...]\n"
+      << "       --output out.%04d.pfm [options]\n\n"
+      << "Options:\n"
+      << "  --frames A-B[xS]     Frame range and step (default 1)\n"
+      << "  --threads N          Batches processed concurrently (default 1)\n"
+      << "  --batch N            Frames per inference call; needs a model\n"
+      << "                       with a dynamic batch axis (default 1)\n"
+      << "  --intra-threads N    ONNX Runtime threads per inference call\n"
+      << "  --param V            Values of the next non-image model input,\n"
+      << "                       e.g. 0.5 or 1,0,0 (default 0)\n"
+      << "  --normalize          Normalize output to 0-1 per frame\n"
+      << "  --normalize-mode M   global, channel or layer (default global)\n"
+      << "  --normalize-layers L Channels per layer for layer mode, e.g. 3,1\n"
+      << "  --stats-file FILE    Add per-frame output statistics to FILE for\n"
+      << "                       the node's sequence normalization\n"
+      << "  --gpu                Use the CUDA execution provider\n"
+      << "  --raw-size WxHxC     Size of headerless float32 .raw inputs\n\n"
+      << "Formats: .pfm, .raw"
+#ifdef ONNX_NUKE_HAVE_OPENEXR
+      << ", .exr"
+#endif
+      << "\n";
+}
+
+int parsePositive(const std::string &flag, const char *value) {
+  char *end = nullptr;
+  long parsed = std::strtol(value, &end, 10);
+  if (end == value || *end != '\0' || parsed <= 0) {
+    throw InvalidArgumentException(flag + " expects a positive integer, got '" +
+                                   value + "'");
+  }
+  return static_cast<int>(parsed);
+}
+
+void parseFrameRange(const std::string &range, BatchOptions &options) {
+  int first = 0, last = 0, step = 1;
+  char dash = 0, x = 0;
+  int matched = std::sscanf(range.c_str(), "%d%c%d%c%d", &first, &dash, &last,
+                            &x, &step);
+  if (matched == 1) {
+    last = first;
+  } else if (!((matched == 3 && dash == '-') ||
+               (matched == 5 && dash == '-' && x == 'x'))) {
+    throw InvalidArgumentException("Invalid frame range: " + range);
+  }
+  if (last < first || step <= 0) {
+    throw InvalidArgumentException("Invalid frame range: " + range);
+  }
+  options.firstFrame = first;
+  options.lastFrame = last;
+  options.frameStep = step;
+}
+
+BatchOptions parseArguments(int argc, char **argv) {
+  BatchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        throw InvalidArgumentException(arg + " expects a value");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--model") {
+      options.modelPath = value();
+    } else if (arg == "--input") {
+      options.inputPatterns.push_back(value());
+    } else if (arg == "--param") {
+      try {
+        options.parameters.push_back(
+            TensorProcessor::parseParameterValues(value()));
+      } catch (const std::invalid_argument &e) {
+        throw InvalidArgumentException(std::string("--param: ") + e.what());
+      }
+    } else if (arg == "--output") {
+      options.outputPattern = value();
+    } else if (arg == "--frames") {
+      parseFrameRange(value(), options);
+    } else if (arg == "--threads") {
+      options.threads = parsePositive(arg, value());
+    } else if (arg == "--batch") {
+      options.batchSize = parsePositive(arg, value());
+    } else if (arg == "--intra-threads") {
+      options.intraOpThreads = parsePositive(arg, value());
+    } else if (arg == "--normalize") {
+      options.normalize = true;
+    } else if (arg == "--normalize-mode") {
+      std::string mode = value();
+      if (mode == "global") {
+        options.normalizeMode = TensorProcessor::kNormalizeGlobal;
+      } else if (mode == "channel") {
+        options.normalizeMode = TensorProcessor::kNormalizePerChannel;
+      } else if (mode == "layer") {
+        options.normalizeMode = TensorProcessor::kNormalizePerLayer;
+      } else {
+        throw InvalidArgumentException("Invalid normalize mode: " + mode);
+      }
+    } else if (arg == "--normalize-layers") {
+      options.normalizeLayers = value();
+    } else if (arg == "--stats-file") {
+      options.statsFile = value();
+    } else if (arg == "--gpu") {
+      options.useGPU = true;
+    } else if (arg == "--raw-size") {
+      std::string size = value();
+      if (std::sscanf(size.c_str(), "%dx%dx%d", &options.rawWidth,
+                      &options.rawHeight, &options.rawChannels) != 3) {
+        throw InvalidArgumentException("Invalid raw size: " + size);
+      }
+    } else {
+      throw InvalidArgumentException("Unknown argument: " + arg);
+    }
+  }
+
+  if (options.modelPath.empty() || options.inputPatterns.empty() ||
+      options.outputPattern.empty()) {
+    throw InvalidArgumentException(
+        "--model, --input and --output are required");
+  }
+
+  if (options.lastFrame > options.firstFrame &&
+      ImageIO::expandFramePattern(options.outputPattern, options.firstFrame) ==
+          ImageIO::expandFramePattern(options.outputPattern,
+                                      options.lastFrame)) {
+    throw InvalidArgumentException(
+        "Output pattern needs a frame number (%04d or ####) for a range");
+  }
+
+  return options;
+}
+
+/**
+ * Read, infer and write one batch of frames
+ */
+void processBatch(const BatchOptions &options, ONNXModelManager &modelManager,
+                  const std::vector<int> &frames, BatchStats &stats) {
+  const int batch = static_cast<int>(frames.size());
+  const int inputCount = static_cast<int>(options.inputPatterns.size());
+
+  // Read and pack every input of every frame in the batch
+  Clock::time_point readStart = Clock::now();
+  Trace::Span readSpan(Trace::kCategoryPipeline, "read and pack");
+  readSpan.arg("first_frame", frames.front());
+  std::vector<int> imageInputs = modelManager.getImageInputs();
+  std::vector<std::shared_ptr<std::vector<float>>> inputTensors(inputCount);
+  std::vector<int> widths(inputCount, 0), heights(inputCount, 0);
+
+  for (int i = 0; i < inputCount; i++) {
+    int imageWidth = 0, imageHeight = 0;
+    for (int b = 0; b < batch; b++) {
+      std::string path =
+          ImageIO::expandFramePattern(options.inputPatterns[i], frames[b]);
+      ImageIO::Image image =
+          ImageIO::readImage(path, options.rawWidth, options.rawHeight,
+                             options.rawChannels);
+
+      // Like the node, each input is packed at its own size, or resampled
+      // to the size the model declares for it; frames of one input stack
+      // along the batch axis, so they must match
+      if (b == 0) {
+        imageWidth = image.width;
+        imageHeight = image.height;
+        TensorProcessor::packedImageSize(
+            modelManager.getInputDims()[imageInputs[i]], imageWidth,
+            imageHeight, widths[i], heights[i]);
+        inputTensors[i] = std::make_shared<std::vector<float>>(
+            static_cast<size_t>(batch) * kPackedChannels * widths[i] *
+            heights[i]);
+      } else if (image.width != imageWidth || image.height != imageHeight) {
+        throw PreprocessException(
+            path + " is " + std::to_string(image.width) + "x" +
+            std::to_string(image.height) + ", expected " +
+            std::to_string(imageWidth) + "x" + std::to_string(imageHeight));
+      }
+
+      TensorProcessor::interleavedToNCHW(
+          image.pixels.data(), image.width, image.height, image.channels,
+          *inputTensors[i], kPackedChannels, b, widths[i], heights[i]);
+    }
+  }
+  readSpan.end();
+  stats.readMicros += microsSince(readStart);
+
+  // Run the model on the whole batch
+  Clock::time_point inferenceStart = Clock::now();
+  Trace::Span inferenceSpan(Trace::kCategoryPipeline, "inference");
+  ONNXInferenceProcessor processor;
+  processor.setModelManager(&modelManager);
+  processor.setInputDimensions(widths[0], heights[0], kPackedChannels);
+  processor.setBatchSize(batch);
+  processor.prepareInputs(modelManager.getInputCount());
+  for (int i = 0; i < inputCount; i++) {
+    processor.setInputImageSize(imageInputs[i], widths[i], heights[i]);
+    processor.setInputTensorData(imageInputs[i], std::move(inputTensors[i]));
+  }
+  std::vector<int> parameterInputs = modelManager.getParameterInputs();
+  for (size_t p = 0; p < parameterInputs.size(); p++) {
+    processor.setParameterInput(parameterInputs[p],
+                                p < options.parameters.size()
+                                    ? options.parameters[p]
+                                    : std::vector<float>());
+  }
+
+  // The output is read where ONNX Runtime produced it. Its statistics are
+  // collected in the same pass, so normalizing needs no second one; batched
+  // outputs are summarized frame by frame below instead.
+  ONNXModelManager::InferenceOutput output;
+  TensorProcessor::OutputStatistics outputStats;
+  bool collectStats = options.normalize || !options.statsFile.empty();
+  processor.runInference(output, collectStats && batch == 1 ? &outputStats
+                                                             : nullptr);
+  inferenceSpan.end();
+  stats.inferenceMicros += microsSince(inferenceStart);
+
+  int outWidth = 0, outHeight = 0, outChannels = 0;
+  if (!processor.getOutputDimensions(outWidth, outHeight, outChannels)) {
+    throw InferenceException("Model output has no usable image dimensions");
+  }
+  if (processor.getOutputBatchSize() != batch) {
+    throw InferenceException(
+        "Model returned " + std::to_string(processor.getOutputBatchSize()) +
+        " images for a batch of " + std::to_string(batch) +
+        "; use --batch 1 for models with a fixed batch axis");
+  }
+
+  size_t frameSize = static_cast<size_t>(outChannels) * outWidth * outHeight;
+  if (output.size() < frameSize * batch) {
+    throw InferenceException("Model output is smaller than its shape");
+  }
+
+  // Normalize and write each frame
+  Clock::time_point writeStart = Clock::now();
+  Trace::Span writeSpan(Trace::kCategoryPipeline, "normalize and write");
+  for (int b = 0; b < batch; b++) {
+    TensorProcessor::OutputStatistics frameStats;
+    if (collectStats && batch == 1) {
+      frameStats = std::move(outputStats);
+    } else if (collectStats) {
+      // Summarize this frame's slice in place (also replacing NaN and Inf)
+      float *slice = output.data() + b * frameSize;
+      TensorProcessor::copyOutput(slice, slice, frameSize,
+                                  {outChannels, outHeight, outWidth},
+                                  &frameStats);
+    }
+    if (!options.statsFile.empty()) {
+      NormalizationIndex::FrameStatistics summary =
+          NormalizationIndex::FrameStatistics::fromOutput(frameStats,
+                                                          outChannels);
+      std::lock_guard<std::mutex> lock(stats.frameStatisticsMutex);
+      stats.frameStatistics.store(frames[b], summary);
+    }
+
+    float minValue = 0.0f;
+    float maxValue = 1.0f;
+    std::vector<TensorProcessor::NormalizationRange> channelRanges;
+    if (options.normalize) {
+      if (frameStats.planeSize != static_cast<size_t>(outWidth) * outHeight) {
+        throw InferenceException("Model output planes do not match its shape");
+      }
+      if (options.normalizeMode == TensorProcessor::kNormalizeGlobal) {
+        TensorProcessor::findMinMax(frameStats, 0, outChannels,
+                                    processor.isSingleChannelOutput(),
+                                    minValue, maxValue);
+      } else {
+        channelRanges = TensorProcessor::normalizationRanges(
+            frameStats.channels, outChannels, options.normalizeMode,
+            options.normalizeLayers);
+      }
+    }
+
+    ImageIO::Image image;
+    image.width = outWidth;
+    image.height = outHeight;
+    image.channels = outChannels;
+    if (!channelRanges.empty()) {
+      TensorProcessor::NCHWToInterleaved(output.data(), outWidth, outHeight,
+                                         outChannels, b, channelRanges,
+                                         image.pixels);
+    } else {
+      TensorProcessor::NCHWToInterleaved(output.data(), outWidth, outHeight,
+                                         outChannels, b, options.normalize,
+                                         minValue, maxValue, image.pixels);
+    }
+
+    ImageIO::writeImage(
+        ImageIO::expandFramePattern(options.outputPattern, frames[b]), image);
+    stats.framesWritten++;
+    stats.pixelsProcessed += static_cast<long long>(widths[0]) * heights[0];
+  }
+  stats.writeMicros += microsSince(writeStart);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BatchOptions options;
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--help") == 0 ||
+          std::strcmp(argv[i], "-h") == 0) {
+        printUsage(argv[0]);
+        return 0;
+      }
+    }
+    options = parseArguments(argc, argv);
+  } catch (const ONNXPluginError &e) {
+    std::cerr << e.what() << "\n\n";
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  ONNXModelManager modelManager;
+  try {
+    modelManager.setIntraOpThreads(options.intraOpThreads);
+    Clock::time_point loadStart = Clock::now();
+    modelManager.load(options.modelPath.c_str(), options.useGPU);
+    std::cerr << "Loaded " << options.modelPath << " in "
+              << microsSince(loadStart) / 1000.0 << " ms\n";
+
+    // --input patterns feed the image inputs and --param values the others
+    size_t imageInputCount = modelManager.getImageInputs().size();
+    size_t parameterInputCount = modelManager.getParameterInputs().size();
+    if (options.inputPatterns.size() > imageInputCount) {
+      throw ConfigurationException(
+          "Model has " + std::to_string(imageInputCount) +
+          " image inputs but " + std::to_string(options.inputPatterns.size()) +
+          " --input patterns were given");
+    }
+    if (options.parameters.size() > parameterInputCount) {
+      throw ConfigurationException(
+          "Model has " + std::to_string(parameterInputCount) +
+          " non-image inputs but " + std::to_string(options.parameters.size()) +
+          " --param values were given");
+    }
+  } catch (const ONNXPluginError &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  // Split the frame range into batches
+  std::vector<std::vector<int>> batches;
+  for (int frame = options.firstFrame; frame <= options.lastFrame;
+       frame += options.frameStep) {
+    if (batches.empty() ||
+        static_cast<int>(batches.back().size()) >= options.batchSize) {
+      batches.emplace_back();
+    }
+    batches.back().push_back(frame);
+  }
+
+  // Workers pull batches until none are left; the session is shared
+  BatchStats stats;
+  if (!options.statsFile.empty() && std::ifstream(options.statsFile)) {
+    try {
+      stats.frameStatistics.load(options.statsFile);
+    } catch (const ONNXPluginError &e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+  std::atomic<size_t> nextBatch(0);
+  std::mutex logMutex;
+  auto worker = [&]() {
+    for (size_t index = nextBatch++; index < batches.size();
+         index = nextBatch++) {
+      try {
+        processBatch(options, modelManager, batches[index], stats);
+      } catch (const std::exception &e) {
+        stats.framesFailed += static_cast<int>(batches[index].size());
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "Frames " << batches[index].front() << "-"
+                  << batches[index].back() << " failed: " << e.what() << "\n";
+      }
+    }
+  };
+
+  Clock::time_point start = Clock::now();
+  int threadCount =
+      std::max(1, std::min(options.threads, static_cast<int>(batches.size())));
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threadCount; t++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+  double seconds = microsSince(start) / 1e6;
+
+  // Throughput statistics
+  int frames = stats.framesWritten.load();
+  double perFrame = frames > 0 ? 1.0 / (1000.0 * frames) : 0.0;
+  std::cerr << "\nFrames written: " << frames
+            << "  failed: " << stats.framesFailed.load() << "\n"
+            << "Wall time: " << seconds << " s  (" << threadCount
+            << " threads, batch " << options.batchSize << ")\n";
+  if (frames > 0 && seconds > 0.0) {
+    std::cerr << "Throughput: " << frames / seconds << " frames/s, "
+              << stats.pixelsProcessed.load() / seconds / 1e6 << " MPix/s\n"
+              << "Per frame (summed over threads): read+pack "
+              << stats.readMicros.load() * perFrame << " ms, inference "
+              << stats.inferenceMicros.load() * perFrame << " ms, write "
+              << stats.writeMicros.load() * perFrame << " ms\n";
+  }
+
+  if (!options.statsFile.empty()) {
+    try {
+      stats.frameStatistics.save(options.statsFile);
+      std::cerr << "Statistics of " << stats.frameStatistics.size()
+                << " frames written to " << options.statsFile << "\n";
+    } catch (const ONNXPluginError &e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  return stats.framesFailed.load() > 0 ? 1 : 0;
+}
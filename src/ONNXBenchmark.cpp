@@ -0,0 +1,655 @@
+/**
+ * onnx_benchmark - Performance regression harness for the core pipeline
+ *
+ * Runs a fixed set of synthetic models (generated in SyntheticModels.h) at
+ * fixed resolutions through the same packing, inference and unpacking code
+ * the node uses. Median stage timings are written to JSON and compared with a
+ * stored baseline; the exit code is non-zero when a stage got slower than the
+ * tolerance allows.
+ */
+
+#include "ErrorHandling.h"
+#include "ONNXInferenceProcessor.h"
+#include "ONNXModelManager.h"
+#include "SyntheticModels.h"
+#include "TensorProcessor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+// Exit codes
+const int kExitOk = 0;
+const int kExitRegression = 1;
+const int kExitError = 2;
+
+// Stages timed for every case, in pipeline order
+const char *const kStages[] = {"pack_ms", "inference_ms", "unpack_ms",
+                               "total_ms"};
+const int kStageCount = 4;
+
+// Used when neither the command line nor the baseline sets a tolerance
+const double kDefaultTolerance = 0.15;
+const double kDefaultMinDeltaMs = 0.5;
+
+struct BenchmarkOptions {
+  std::string baselinePath;
+  std::string outputPath;
+  std::string modelDirectory; // Where the synthetic models are written
+  std::string filter;         // Only run cases whose name contains this
+  int iterations;
+  int warmup;
+  int intraOpThreads;
+  double tolerance;  // Relative slowdown allowed; < 0 uses the baseline's
+  double minDeltaMs; // Absolute slowdown ignored; < 0 uses the baseline's
+  bool updateBaseline;
+  bool useGPU;
+
+  BenchmarkOptions()
+      : baselinePath("benchmarks/baseline.json"),
+        outputPath("benchmark_results.json"), modelDirectory("/tmp"),
+        filter(), iterations(10), warmup(2), intraOpThreads(0),
+        tolerance(-1.0), minDeltaMs(-1.0), updateBaseline(false),
+        useGPU(false) {}
+};
+
+struct BenchmarkCase {
+  std::string model; // Synthetic model name
+  int width;
+  int height;
+
+  std::string name() const {
+    return model + "@" + std::to_string(width) + "x" + std::to_string(height);
+  }
+};
+
+// Median and 90th percentile of one stage, in milliseconds
+struct StageTiming {
+  double median;
+  double p90;
+};
+
+struct CaseResult {
+  std::string name;
+  double loadMs;
+  StageTiming stages[kStageCount];
+};
+
+/**
+ * The fixed workload. Changing it invalidates the stored baseline.
+ */
+std::vector<BenchmarkCase> benchmarkCases() {
+  const char *models[] = {"identity", "pointwise", "conv16", "depth8"};
+  const int sizes[][2] = {{960, 540}, {1920, 1080}};
+
+  std::vector<BenchmarkCase> cases;
+  for (const char *model : models) {
+    for (const auto &size : sizes) {
+      cases.push_back(BenchmarkCase{model, size[0], size[1]});
+    }
+  }
+  return cases;
+}
+
+std::string syntheticModel(const std::string &name) {
+  if (name == "identity") {
+    return SyntheticModels::identity();
+  } else if (name == "pointwise") {
+    return SyntheticModels::pointwise();
+  } else if (name == "conv16") {
+    return SyntheticModels::convolution(16);
+  } else if (name == "depth8") {
+    return SyntheticModels::depth(8);
+  }
+  throw InvalidArgumentException("Unknown synthetic model: " + name);
+}
+
+/**
+ * Minimal JSON reader, enough for baseline files
+ */
+struct JsonValue {
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+  Type type = kNull;
+  double number = 0.0;
+  std::string text;
+  std::vector<JsonValue> items;
+  std::map<std::string, JsonValue> members;
+
+  const JsonValue *member(const std::string &key) const {
+    auto it = members.find(key);
+    return it == members.end() ? nullptr : &it->second;
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(const std::string &text) : _text(text), _pos(0) {}
+
+  JsonValue parse() {
+    JsonValue value = parseValue();
+    skipSpace();
+    if (_pos != _text.size()) {
+      fail("trailing characters");
+    }
+    return value;
+  }
+
+private:
+  JsonValue parseValue() {
+    skipSpace();
+    if (_pos >= _text.size()) {
+      fail("unexpected end");
+    }
+
+    JsonValue value;
+    char c = _text[_pos];
+    if (c == '{') {
+      value.type = JsonValue::kObject;
+      _pos++;
+      if (!consume('}')) {
+        do {
+          skipSpace();
+          std::string key = parseString();
+          expect(':');
+          value.members[key] = parseValue();
+        } while (consume(','));
+        expect('}');
+      }
+    } else if (c == '[') {
+      value.type = JsonValue::kArray;
+      _pos++;
+      if (!consume(']')) {
+        do {
+          value.items.push_back(parseValue());
+        } while (consume(','));
+        expect(']');
+      }
+    } else if (c == '"') {
+      value.type = JsonValue::kString;
+      value.text = parseString();
+    } else if (_text.compare(_pos, 4, "true") == 0 ||
+               _text.compare(_pos, 5, "false") == 0) {
+      value.type = JsonValue::kBool;
+      value.number = c == 't' ? 1.0 : 0.0;
+      _pos += c == 't' ? 4 : 5;
+    } else if (_text.compare(_pos, 4, "null") == 0) {
+      _pos += 4;
+    } else {
+      const char *begin = _text.c_str() + _pos;
+      char *end = nullptr;
+      value.type = JsonValue::kNumber;
+      value.number = std::strtod(begin, &end);
+      if (end == begin) {
+        fail("unexpected character");
+      }
+      _pos += static_cast<size_t>(end - begin);
+    }
+    return value;
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string result;
+    while (_pos < _text.size() && _text[_pos] != '"') {
+      char c = _text[_pos++];
+      if (c == '\\' && _pos < _text.size()) {
+        char escaped = _text[_pos++];
+        result += escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped;
+      } else {
+        result += c;
+      }
+    }
+    expect('"');
+    return result;
+  }
+
+  void skipSpace() {
+    while (_pos < _text.size() &&
+           std::isspace(static_cast<unsigned char>(_text[_pos]))) {
+      _pos++;
+    }
+  }
+  bool consume(char c) {
+    skipSpace();
+    if (_pos < _text.size() && _text[_pos] == c) {
+      _pos++;
+      return true;
+    }
+    return false;
+  }
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(std::string("expected '") + c + "'");
+    }
+  }
+  void fail(const std::string &message) const {
+    throw InvalidArgumentException("Invalid JSON at offset " +
+                                   std::to_string(_pos) + ": " + message);
+  }
+
+  const std::string &_text;
+  size_t _pos;
+};
+
+StageTiming summarize(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  StageTiming timing;
+  timing.median = samples[samples.size() / 2];
+  timing.p90 = samples[std::min(samples.size() - 1,
+                                static_cast<size_t>(samples.size() * 0.9))];
+  return timing;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+/**
+ * Run one case through pack, inference and unpack
+ */
+CaseResult runCase(const BenchmarkCase &benchmarkCase,
+                   const BenchmarkOptions &options) {
+  const int channels = 3;
+  CaseResult result;
+  result.name = benchmarkCase.name();
+
+  std::string modelPath = options.modelDirectory + "/onnx_benchmark_" +
+                          std::to_string(getpid()) + "_" +
+                          benchmarkCase.model + ".onnx";
+  if (!SyntheticModels::writeModel(modelPath,
+                                   syntheticModel(benchmarkCase.model))) {
+    throw ConfigurationException("Cannot write " + modelPath);
+  }
+
+  ONNXModelManager modelManager;
+  modelManager.setIntraOpThreads(options.intraOpThreads);
+  Clock::time_point loadStart = Clock::now();
+  try {
+    modelManager.load(modelPath.c_str(), options.useGPU);
+  } catch (...) {
+    std::remove(modelPath.c_str());
+    throw;
+  }
+  result.loadMs = millisSince(loadStart);
+  std::remove(modelPath.c_str());
+
+  // Deterministic interleaved RGB plate with some high-frequency detail
+  const int width = benchmarkCase.width;
+  const int height = benchmarkCase.height;
+  std::vector<float> pixels(static_cast<size_t>(width) * height * channels);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float *pixel = &pixels[(static_cast<size_t>(y) * width + x) * channels];
+      pixel[0] = static_cast<float>(x) / width;
+      pixel[1] = static_cast<float>(y) / height;
+      pixel[2] = static_cast<float>((x * 7 + y * 13) % 64) / 64.0f;
+    }
+  }
+
+  std::vector<double> samples[kStageCount];
+  for (int iteration = 0; iteration < options.warmup + options.iterations;
+       iteration++) {
+    // Pack
+    Clock::time_point packStart = Clock::now();
+    std::shared_ptr<std::vector<float>> tensor =
+        std::make_shared<std::vector<float>>(static_cast<size_t>(channels) *
+                                             width * height);
+    TensorProcessor::interleavedToNCHW(pixels.data(), width, height, channels,
+                                       *tensor, channels);
+    double packMs = millisSince(packStart);
+
+    // Inference
+    Clock::time_point inferenceStart = Clock::now();
+    ONNXInferenceProcessor processor;
+    processor.setModelManager(&modelManager);
+    processor.setInputDimensions(width, height, channels);
+    processor.prepareInputs(1);
+    processor.setInputTensorData(0, std::move(tensor));
+    // The output is kept where ONNX Runtime produced it, and its statistics
+    // are gathered in the same pass that scrubs it, as in the node
+    ONNXModelManager::InferenceOutput output;
+    TensorProcessor::OutputStatistics statistics;
+    processor.runInference(output, &statistics);
+    double inferenceMs = millisSince(inferenceStart);
+
+    // Unpack with normalization, as the node does for depth-like outputs
+    Clock::time_point unpackStart = Clock::now();
+    int outWidth = 0, outHeight = 0, outChannels = 0;
+    if (!processor.getOutputDimensions(outWidth, outHeight, outChannels)) {
+      throw InferenceException("Model output has no usable image dimensions");
+    }
+    float minValue = 0.0f;
+    float maxValue = 1.0f;
+    TensorProcessor::findMinMax(statistics, 0, outChannels,
+                                processor.isSingleChannelOutput(), minValue,
+                                maxValue);
+    std::vector<float> outputPixels;
+    TensorProcessor::NCHWToInterleaved(output.data(), outWidth, outHeight,
+                                       outChannels, 0, true, minValue,
+                                       maxValue, outputPixels);
+    double unpackMs = millisSince(unpackStart);
+
+    if (iteration >= options.warmup) {
+      samples[0].push_back(packMs);
+      samples[1].push_back(inferenceMs);
+      samples[2].push_back(unpackMs);
+      samples[3].push_back(packMs + inferenceMs + unpackMs);
+    }
+  }
+
+  for (int s = 0; s < kStageCount; s++) {
+    result.stages[s] = summarize(samples[s]);
+  }
+  return result;
+}
+
+/**
+ * Write results in the baseline format, so a results file can be committed
+ * as the next baseline
+ */
+bool writeResults(const std::string &path,
+                  const std::vector<CaseResult> &results,
+                  const BenchmarkOptions &options, double tolerance,
+                  double minDeltaMs) {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+
+  char host[256] = {0};
+  gethostname(host, sizeof(host) - 1);
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\n"
+       << "  \"host\": \"" << host << "\",\n"
+       << "  \"iterations\": " << options.iterations << ",\n"
+       << "  \"intra_op_threads\": " << options.intraOpThreads << ",\n"
+       << "  \"gpu\": " << (options.useGPU ? "true" : "false") << ",\n"
+       << "  \"tolerance\": " << tolerance << ",\n"
+       << "  \"min_delta_ms\": " << minDeltaMs << ",\n"
+       << "  \"cases\": {";
+  for (size_t i = 0; i < results.size(); i++) {
+    const CaseResult &result = results[i];
+    file << (i == 0 ? "\n" : ",\n") << "    \"" << result.name
+         << "\": {\"load_ms\": " << result.loadMs;
+    for (int s = 0; s < kStageCount; s++) {
+      std::string p90 = std::string(kStages[s]);
+      p90.insert(p90.size() - 3, "_p90");
+      file << ", \"" << kStages[s] << "\": " << result.stages[s].median
+           << ", \"" << p90 << "\": " << result.stages[s].p90;
+    }
+    file << "}";
+  }
+  file << "\n  }\n}\n";
+  return static_cast<bool>(file);
+}
+
+JsonValue readBaseline(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw ConfigurationException("Cannot read baseline " + path);
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string text = contents.str();
+  return JsonParser(text).parse();
+}
+
+/**
+ * Compare results against the baseline and print a report
+ * @param missing Receives the number of stages the baseline has no timing
+ *        for; they cannot be checked, so they fail the comparison too
+ * @return Number of regressed stages
+ */
+int compareWithBaseline(const std::vector<CaseResult> &results,
+                        const JsonValue &baseline, double tolerance,
+                        double minDeltaMs, int &missing) {
+  const JsonValue *cases = baseline.member("cases");
+  int regressions = 0;
+  missing = 0;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "\nComparison with baseline (tolerance " << tolerance * 100.0
+            << "%, min delta " << minDeltaMs << " ms):\n";
+  for (const CaseResult &result : results) {
+    const JsonValue *reference = cases ? cases->member(result.name) : nullptr;
+    if (!reference) {
+      std::cout << "  " << result.name << ": MISSING from the baseline\n";
+      missing += kStageCount;
+      continue;
+    }
+
+    for (int s = 0; s < kStageCount; s++) {
+      const JsonValue *expected = reference->member(kStages[s]);
+      if (!expected || expected->type != JsonValue::kNumber) {
+        std::cout << "  " << result.name << " " << kStages[s]
+                  << ": MISSING from the baseline\n";
+        missing++;
+        continue;
+      }
+      double current = result.stages[s].median;
+      double previous = expected->number;
+      double change = previous > 0.0 ? current / previous - 1.0 : 0.0;
+
+      const char *verdict = "ok";
+      if (change > tolerance && current - previous > minDeltaMs) {
+        verdict = "REGRESSION";
+        regressions++;
+      } else if (change < -tolerance && previous - current > minDeltaMs) {
+        verdict = "faster";
+      }
+      std::cout << "  " << std::left << std::setw(24) << result.name
+                << std::setw(14) << kStages[s] << std::right << std::setw(10)
+                << previous << " -> " << std::setw(10) << current << " ms ("
+                << std::showpos << change * 100.0 << std::noshowpos << "%) "
+                << verdict << "\n";
+    }
+  }
+  return regressions;
+}
+
+void printUsage(const char *program) {
+  std::cerr
+      << "Usage: " << program << " [options]\n\n"
+      << "Options:\n"
+      << "  --baseline PATH      Baseline to compare against\n"
+      << "                       (default benchmarks/baseline.json)\n"
+      << "  --output PATH        Results file\n"
+      << "                       (default benchmark_results.json)\n"
+      << "  --update-baseline    Write the results to the baseline instead of\n"
+      << "                       comparing\n"
+      << "  --tolerance F        Allowed relative slowdown, e.g. 0.1 for 10%\n"
+      << "                       (default: the baseline's, else 0.15)\n"
+      << "  --min-delta-ms F     Ignore slowdowns smaller than this\n"
+      << "                       (default: the baseline's, else 0.5)\n"
+      << "  --iterations N       Timed iterations per case (default 10)\n"
+      << "  --warmup N           Untimed iterations per case (default 2)\n"
+      << "  --filter TEXT        Only run cases whose name contains TEXT\n"
+      << "  --intra-threads N    ONNX Runtime threads per inference call\n"
+      << "  --model-dir PATH     Where synthetic models are written\n"
+      << "  --gpu                Use the CUDA execution provider\n\n"
+      << "Exit status: 0 no regression, 1 regression, 2 error (including\n"
+      << "cases missing from the baseline)\n";
+}
+
+double parseNonNegative(const std::string &flag, const char *value) {
+  char *end = nullptr;
+  double parsed = std::strtod(value, &end);
+  if (end == value || *end != '\0' || parsed < 0.0) {
+    throw InvalidArgumentException(flag + " expects a non-negative number, "
+                                          "got '" +
+                                   value + "'");
+  }
+  return parsed;
+}
+
+int parseCount(const std::string &flag, const char *value, int minimum) {
+  char *end = nullptr;
+  long parsed = std::strtol(value, &end, 10);
+  if (end == value || *end != '\0' || parsed < minimum) {
+    throw InvalidArgumentException(flag + " expects an integer >= " +
+                                   std::to_string(minimum) + ", got '" +
+                                   value + "'");
+  }
+  return static_cast<int>(parsed);
+}
+
+BenchmarkOptions parseArguments(int argc, char **argv) {
+  BenchmarkOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        throw InvalidArgumentException(arg + " expects a value");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--baseline") {
+      options.baselinePath = value();
+    } else if (arg == "--output") {
+      options.outputPath = value();
+    } else if (arg == "--update-baseline") {
+      options.updateBaseline = true;
+    } else if (arg == "--tolerance") {
+      options.tolerance = parseNonNegative(arg, value());
+    } else if (arg == "--min-delta-ms") {
+      options.minDeltaMs = parseNonNegative(arg, value());
+    } else if (arg == "--iterations") {
+      options.iterations = parseCount(arg, value(), 1);
+    } else if (arg == "--warmup") {
+      options.warmup = parseCount(arg, value(), 0);
+    } else if (arg == "--filter") {
+      options.filter = value();
+    } else if (arg == "--intra-threads") {
+      options.intraOpThreads = parseCount(arg, value(), 1);
+    } else if (arg == "--model-dir") {
+      options.modelDirectory = value();
+    } else if (arg == "--gpu") {
+      options.useGPU = true;
+    } else {
+      throw InvalidArgumentException("Unknown argument: " + arg);
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options;
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--help") == 0 ||
+          std::strcmp(argv[i], "-h") == 0) {
+        printUsage(argv[0]);
+        return kExitOk;
+      }
+    }
+    options = parseArguments(argc, argv);
+  } catch (const ONNXPluginError &e) {
+    std::cerr << e.what() << "\n\n";
+    printUsage(argv[0]);
+    return kExitError;
+  }
+
+  // Tolerances come from the command line, then the baseline, then defaults
+  JsonValue baseline;
+  bool haveBaseline = false;
+  if (!options.updateBaseline) {
+    try {
+      baseline = readBaseline(options.baselinePath);
+      haveBaseline = true;
+    } catch (const ONNXPluginError &e) {
+      std::cerr << e.what() << "\n";
+      return kExitError;
+    }
+  }
+  double tolerance = options.tolerance;
+  double minDeltaMs = options.minDeltaMs;
+  const JsonValue *stored = nullptr;
+  if (tolerance < 0.0) {
+    stored = haveBaseline ? baseline.member("tolerance") : nullptr;
+    tolerance = stored ? stored->number : kDefaultTolerance;
+  }
+  if (minDeltaMs < 0.0) {
+    stored = haveBaseline ? baseline.member("min_delta_ms") : nullptr;
+    minDeltaMs = stored ? stored->number : kDefaultMinDeltaMs;
+  }
+
+  // Run the workload
+  std::vector<CaseResult> results;
+  int failures = 0;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const BenchmarkCase &benchmarkCase : benchmarkCases()) {
+    std::string name = benchmarkCase.name();
+    if (!options.filter.empty() &&
+        name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+
+    try {
+      CaseResult result = runCase(benchmarkCase, options);
+      std::cout << std::left << std::setw(24) << name << std::right
+                << " pack " << std::setw(8) << result.stages[0].median
+                << "  inference " << std::setw(8) << result.stages[1].median
+                << "  unpack " << std::setw(8) << result.stages[2].median
+                << "  total " << std::setw(8) << result.stages[3].median
+                << " ms (load " << result.loadMs << " ms)" << std::endl;
+      results.push_back(result);
+    } catch (const std::exception &e) {
+      std::cerr << name << " failed: " << e.what() << "\n";
+      failures++;
+    }
+  }
+
+  std::string outputPath =
+      options.updateBaseline ? options.baselinePath : options.outputPath;
+  if (!writeResults(outputPath, results, options, tolerance, minDeltaMs)) {
+    std::cerr << "Cannot write " << outputPath << "\n";
+    return kExitError;
+  }
+  std::cout << "Results written to " << outputPath << "\n";
+
+  if (failures > 0) {
+    return kExitError;
+  }
+  if (options.updateBaseline) {
+    return kExitOk;
+  }
+
+  int missing = 0;
+  int regressions =
+      compareWithBaseline(results, baseline, tolerance, minDeltaMs, missing);
+  if (regressions > 0) {
+    std::cout << regressions << " stage(s) regressed\n";
+    return kExitRegression;
+  }
+  if (missing > 0) {
+    std::cerr << missing << " stage(s) have no baseline timing in "
+              << options.baselinePath
+              << "; record one with --update-baseline\n";
+    return kExitError;
+  }
+  std::cout << "No regressions\n";
+  return kExitOk;
+}
@@ -0,0 +1,338 @@
+/**
+ * onnx_inference_daemon - Local inference server shared by Nuke sessions
+ *
+ * Loads each model once per machine and runs it for any number of
+ * ONNXRuntimeOp nodes in any number of Nuke processes. Requests arrive over a
+ * Unix socket; tensors are exchanged through POSIX shared memory.
+ */
+
+#include "ErrorHandling.h"
+#include "InferenceDaemonProtocol.h"
+#include "ONNXModelManager.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Socket path, kept for removal on shutdown
+std::string g_socketPath;
+
+void handleShutdownSignal(int) {
+  if (!g_socketPath.empty()) {
+    unlink(g_socketPath.c_str());
+  }
+  _exit(0);
+}
+
+/**
+ * Models loaded by the daemon, shared by every connection
+ */
+class ModelRegistry {
+public:
+  explicit ModelRegistry(int intraOpThreads)
+      : _intraOpThreads(intraOpThreads) {}
+
+  /**
+   * Load a model, or return the id of the already loaded copy
+   */
+  uint32_t load(const std::string &modelPath, bool useGPU) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string key = modelPath + (useGPU ? "|gpu" : "|cpu");
+    auto it = _ids.find(key);
+    if (it != _ids.end()) {
+      return it->second;
+    }
+
+    std::unique_ptr<ONNXModelManager> manager(new ONNXModelManager());
+    manager->setIntraOpThreads(_intraOpThreads);
+    manager->load(modelPath.c_str(), useGPU); // Throws ModelLoadException
+    std::cerr << "Loaded " << modelPath << (useGPU ? " (GPU)" : " (CPU)")
+              << std::endl;
+
+    uint32_t id = static_cast<uint32_t>(_models.size());
+    _models.push_back(std::move(manager));
+    _ids[key] = id;
+    return id;
+  }
+
+  /**
+   * Get a loaded model; models stay loaded for the life of the daemon
+   */
+  ONNXModelManager &get(uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (id >= _models.size()) {
+      throw InvalidArgumentException("Unknown model id " + std::to_string(id));
+    }
+    return *_models[id];
+  }
+
+private:
+  int _intraOpThreads;
+  std::mutex _mutex;
+  std::map<std::string, uint32_t> _ids;
+  std::vector<std::unique_ptr<ONNXModelManager>> _models;
+};
+
+std::vector<char> handleLoad(ModelRegistry &registry,
+                             const std::vector<char> &payload) {
+  InferenceDaemon::MessageWriter reply;
+  try {
+    InferenceDaemon::MessageReader reader(payload);
+    std::string modelPath = reader.str();
+    bool useGPU = reader.u32() != 0;
+
+    uint32_t id = registry.load(modelPath, useGPU);
+    ONNXModelManager &manager = registry.get(id);
+
+    reply.u32(InferenceDaemon::kOk);
+    reply.str("");
+    reply.u32(id);
+    reply.u32(static_cast<uint32_t>(manager.getInputCount()));
+    for (int i = 0; i < manager.getInputCount(); i++) {
+      reply.str(manager.getInputNames()[i]);
+      reply.shape(manager.getInputDims()[i]);
+    }
+    reply.u32(static_cast<uint32_t>(manager.getOutputCount()));
+    for (int i = 0; i < manager.getOutputCount(); i++) {
+      reply.str(manager.getOutputNames()[i]);
+      reply.shape(manager.getOutputDims()[i]);
+    }
+  } catch (const std::exception &e) {
+    reply = InferenceDaemon::MessageWriter();
+    reply.u32(InferenceDaemon::kModelError);
+    reply.str(e.what());
+  }
+  return reply.data();
+}
+
+/**
+ * Client segments mapped by one connection. Clients reuse their segments,
+ * so each is opened and mapped once rather than on every run.
+ */
+class SegmentMappings {
+public:
+  /**
+   * Map a segment, or return its existing mapping if it is large enough
+   */
+  void *map(const std::string &name, size_t bytes, bool writable) {
+    std::unique_ptr<InferenceDaemon::SharedMemoryBuffer> &buffer =
+        _buffers[name];
+    if (!buffer || buffer->size() < bytes) {
+      // Segments a client replaced are gone for good; start afresh
+      if (_buffers.size() > kMaxMappings) {
+        _buffers.clear();
+        return map(name, bytes, writable);
+      }
+      buffer.reset(new InferenceDaemon::SharedMemoryBuffer());
+      buffer->open(name, bytes, writable);
+    }
+    return buffer->data();
+  }
+
+private:
+  static const size_t kMaxMappings = 32;
+
+  std::map<std::string, std::unique_ptr<InferenceDaemon::SharedMemoryBuffer>>
+      _buffers;
+};
+
+std::vector<char> handleRun(ModelRegistry &registry,
+                            SegmentMappings &mappings,
+                            const std::vector<char> &payload) {
+  InferenceDaemon::MessageWriter reply;
+  InferenceDaemon::SharedMemoryBuffer created;
+  try {
+    InferenceDaemon::MessageReader reader(payload);
+    ONNXModelManager &manager = registry.get(reader.u32());
+
+    // Map the client's input segments in place
+    uint32_t inputCount = reader.u32();
+    std::vector<const float *> inputData;
+    std::vector<size_t> inputSizes;
+    std::vector<std::vector<int64_t>> inputShapes;
+    std::vector<std::string> inputNames;
+    for (uint32_t i = 0; i < inputCount; i++) {
+      inputNames.push_back(reader.str());
+      inputShapes.push_back(reader.shape());
+      std::string segment = reader.str();
+      size_t count = static_cast<size_t>(reader.u64());
+
+      inputData.push_back(static_cast<const float *>(
+          mappings.map(segment, count * sizeof(float), false)));
+      inputSizes.push_back(count);
+    }
+
+    // The client's free output segment and its capacity in elements
+    std::string outputSegment = reader.str();
+    size_t outputCapacity = static_cast<size_t>(reader.u64());
+
+    // ONNX Runtime writes straight into the client's segment when the
+    // output shape is known before the run; a larger output goes to a new
+    // segment handed over to the client
+    std::vector<int64_t> outputShape;
+    size_t outputCount = 0;
+    std::string outputName;
+    manager.runInferenceRaw(
+        inputData, inputSizes, inputShapes, inputNames,
+        [&](const std::vector<int64_t> &, size_t count) {
+          outputCount = count;
+          if (!outputSegment.empty() && count <= outputCapacity) {
+            outputName = outputSegment;
+            return static_cast<float *>(mappings.map(
+                outputSegment, outputCapacity * sizeof(float), true));
+          }
+          created.create(InferenceDaemon::uniqueSegmentName("onnxd"),
+                         count * sizeof(float), true);
+          outputName = created.name();
+          return static_cast<float *>(created.data());
+        },
+        &outputShape, nullptr, true);
+
+    reply.u32(InferenceDaemon::kOk);
+    reply.str("");
+    reply.shape(outputShape);
+    reply.str(outputName);
+    reply.u64(outputCount);
+  } catch (const std::exception &e) {
+    created.release(); // Unlinks the segment if one was created
+    reply = InferenceDaemon::MessageWriter();
+    reply.u32(InferenceDaemon::kInferenceError);
+    reply.str(e.what());
+    return reply.data();
+  }
+
+  // From here the client owns a created segment and unlinks it
+  created.detach();
+  return reply.data();
+}
+
+void serveConnection(int fd, ModelRegistry &registry) {
+  SegmentMappings mappings;
+  uint32_t type = 0;
+  std::vector<char> payload;
+  while (InferenceDaemon::receiveMessage(fd, type, payload)) {
+    bool sent = false;
+    if (type == InferenceDaemon::kLoadRequest) {
+      sent = InferenceDaemon::sendMessage(fd, InferenceDaemon::kLoadReply,
+                                          handleLoad(registry, payload));
+    } else if (type == InferenceDaemon::kRunRequest) {
+      sent = InferenceDaemon::sendMessage(
+          fd, InferenceDaemon::kRunReply,
+          handleRun(registry, mappings, payload));
+    }
+    if (!sent) {
+      break; // Unknown request or client gone
+    }
+  }
+  close(fd);
+}
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program << " [--socket PATH] [--intra-threads N]\n"
+            << "Default socket: " << InferenceDaemon::defaultSocketPath()
+            << " (set " << InferenceDaemon::kSocketEnvVar
+            << " to change it for the daemon and Nuke)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string socketPath = InferenceDaemon::defaultSocketPath();
+  int intraOpThreads = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--socket" && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else if (arg == "--intra-threads" && i + 1 < argc) {
+      intraOpThreads = std::atoi(argv[++i]);
+    } else {
+      printUsage(argv[0]);
+      return arg == "--help" || arg == "-h" ? 0 : 2;
+    }
+  }
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path too long: " << socketPath << std::endl;
+    return 1;
+  }
+  std::strncpy(address.sun_path, socketPath.c_str(),
+               sizeof(address.sun_path) - 1);
+
+  try {
+    InferenceDaemon::prepareSocketDirectory(socketPath);
+  } catch (const ONNXPluginError &e) {
+    std::cerr << "Cannot use " << socketPath << ": " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    std::cerr << "socket() failed: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  // Refuse to start twice; remove a stale socket left by a crashed daemon
+  if (connect(listenFd, reinterpret_cast<sockaddr *>(&address),
+              sizeof(address)) == 0) {
+    std::cerr << "A daemon is already listening on " << socketPath
+              << std::endl;
+    return 1;
+  }
+  close(listenFd);
+  unlink(socketPath.c_str());
+
+  // The socket is created private, not made private after bind()
+  umask(0077);
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0 ||
+      bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      chmod(socketPath.c_str(), 0600) != 0 || listen(listenFd, 16) != 0) {
+    std::cerr << "Cannot listen on " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  g_socketPath = socketPath;
+  std::signal(SIGINT, handleShutdownSignal);
+  std::signal(SIGTERM, handleShutdownSignal);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::cerr << "ONNX inference daemon listening on " << socketPath
+            << std::endl;
+
+  ModelRegistry registry(intraOpThreads);
+  while (true) {
+    int clientFd = accept(listenFd, nullptr, nullptr);
+    if (clientFd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "accept() failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    if (!InferenceDaemon::peerIsSameUser(clientFd)) {
+      std::cerr << "Refused a connection from another user" << std::endl;
+      close(clientFd);
+      continue;
+    }
+    std::thread(serveConnection, clientFd, std::ref(registry)).detach();
+  }
+
+  close(listenFd);
+  unlink(socketPath.c_str());
+  return 1;
+}
@@ -3,6 +3,7 @@
 #include "ErrorHandling.h"
 #include "ONNXModelManager.h"
 #include "TensorProcessor.h"
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -18,8 +19,8 @@ class ONNXInferenceProcessor {
 public:
   ONNXInferenceProcessor()
       : _modelManager(nullptr), _inputTensors(), _width(0), _height(0),
-        _channels(0), _outputWidth(0), _outputHeight(0), _outputChannels(0),
-        _isSingleChannel(true) {}
+        _channels(0), _batchSize(1), _outputWidth(0), _outputHeight(0),
+        _outputChannels(0), _outputBatch(1), _isSingleChannel(true) {}
 
   /**
    * Set the model manager to use for inference
@@ -48,6 +49,24 @@ public:
     _channels = channels;
   }
 
+  /**
+   * Set the number of images stacked along the batch axis of each input
+   * @param batchSize Batch size (1 for the node's single-frame processing)
+   */
+  void setBatchSize(int batchSize) {
+    if (batchSize <= 0) {
+      throw ConfigurationException("Invalid batch size: " +
+                                   std::to_string(batchSize));
+    }
+    _batchSize = batchSize;
+  }
+
+  /**
+   * Get the batch size reported by the last inference
+   * @return Number of images along the output batch axis
+   */
+  int getOutputBatchSize() const { return _outputBatch; }
+
   /**
    * Get the output dimensions
    * @param width Output parameter for width
@@ -105,15 +124,19 @@ public:
           // Use model's expected shape as a template
           _inputTensors[i].shape = modelInputDims[i];
 
-          // Override height/width with actual dimensions
-          if (_inputTensors[i].shape.size() >= 4) {
-            // NCHW format: adjust height and width
-            _inputTensors[i].shape[2] = static_cast<int64_t>(_height);
-            _inputTensors[i].shape[3] = static_cast<int64_t>(_width);
+          // Override batch, height and width of image inputs with actual
+          // dimensions; parameter inputs are shaped by setParameterInput
+          std::vector<int64_t> &shape = _inputTensors[i].shape;
+          if (TensorProcessor::isImageShape(shape)) {
+            // NCHW (or NCTHW) format: adjust batch, height and width
+            shape[0] = static_cast<int64_t>(_batchSize);
+            shape[shape.size() - 2] = static_cast<int64_t>(_height);
+            shape[shape.size() - 1] = static_cast<int64_t>(_width);
           }
         } else {
           // Use default NCHW format if no specific shape info
-          _inputTensors[i].shape = {1, _channels, static_cast<int64_t>(_height),
+          _inputTensors[i].shape = {static_cast<int64_t>(_batchSize), _channels,
+                                    static_cast<int64_t>(_height),
                                     static_cast<int64_t>(_width)};
         }
 
@@ -145,15 +168,217 @@ public:
                                      std::to_string(inputIndex) + " is empty");
     }
 
-    _inputTensors[inputIndex].data = data;
+    setInputTensorData(inputIndex,
+                       std::make_shared<const std::vector<float>>(data));
+  }
+
+  /**
+   * Set shared, read-only data for a specific input tensor without copying it
+   * @param inputIndex The index of the input tensor
+   * @param data The shared tensor data
+   */
+  void setInputTensorData(int inputIndex,
+                          std::shared_ptr<const std::vector<float>> data) {
+    if (inputIndex < 0 ||
+        inputIndex >= static_cast<int>(_inputTensors.size())) {
+      std::string msg =
+          "Input index " + std::to_string(inputIndex) +
+          " out of range (size: " + std::to_string(_inputTensors.size()) + ")";
+      throw InvalidArgumentException(msg);
+    }
+
+    if (!data || data->empty()) {
+      throw InvalidArgumentException("Input tensor data for index " +
+                                     std::to_string(inputIndex) + " is empty");
+    }
+
+    _inputTensors[inputIndex].data = std::move(data);
     _inputTensors[inputIndex].valid = true;
   }
 
+  /**
+   * Set shared data for an input whose shape is given with it rather than
+   * taken from the model, e.g. recurrent state fed back from an output
+   * @param inputIndex The index of the input tensor
+   * @param shape Shape of the data
+   * @param data The shared tensor data
+   */
+  void setInputTensorData(int inputIndex, const std::vector<int64_t> &shape,
+                          std::shared_ptr<const std::vector<float>> data) {
+    setInputTensorData(inputIndex, std::move(data));
+    _inputTensors[inputIndex].shape = shape;
+  }
+
+  /**
+   * Set the size an image input is packed at, when it differs from the
+   * dimensions given to setInputDimensions (e.g. a low resolution guide)
+   * @param inputIndex The index of the input tensor
+   * @param width Packed width
+   * @param height Packed height
+   */
+  void setInputImageSize(int inputIndex, int width, int height) {
+    if (inputIndex < 0 ||
+        inputIndex >= static_cast<int>(_inputTensors.size())) {
+      std::string msg =
+          "Input index " + std::to_string(inputIndex) +
+          " out of range (size: " + std::to_string(_inputTensors.size()) + ")";
+      throw InvalidArgumentException(msg);
+    }
+    if (width <= 0 || height <= 0) {
+      throw ConfigurationException(
+          "Invalid size for input " + std::to_string(inputIndex) + ": " +
+          std::to_string(width) + "x" + std::to_string(height));
+    }
+
+    std::vector<int64_t> &shape = _inputTensors[inputIndex].shape;
+    if (shape.size() >= 4) {
+      shape[shape.size() - 2] = static_cast<int64_t>(height);
+      shape[shape.size() - 1] = static_cast<int64_t>(width);
+    }
+  }
+
+  /**
+   * Set the number of frames along the time axis of a temporal (NCTHW)
+   * input
+   * @param inputIndex The index of the input tensor
+   * @param frames Frames in the window
+   */
+  void setInputFrameCount(int inputIndex, int frames) {
+    if (inputIndex < 0 ||
+        inputIndex >= static_cast<int>(_inputTensors.size())) {
+      std::string msg =
+          "Input index " + std::to_string(inputIndex) +
+          " out of range (size: " + std::to_string(_inputTensors.size()) + ")";
+      throw InvalidArgumentException(msg);
+    }
+
+    std::vector<int64_t> &shape = _inputTensors[inputIndex].shape;
+    if (shape.size() == 5 && frames > 0) {
+      shape[2] = static_cast<int64_t>(frames);
+    }
+  }
+
+  /**
+   * Set the values of a parameter (non-image) input. The tensor takes the
+   * model's shape with dynamic dimensions resolved from the batch size and
+   * the number of values; see TensorProcessor::parameterTensor.
+   * @param inputIndex The index of the input tensor
+   * @param values The parameter values; empty gives zeros
+   */
+  void setParameterInput(int inputIndex, const std::vector<float> &values) {
+    if (inputIndex < 0 ||
+        inputIndex >= static_cast<int>(_inputTensors.size())) {
+      std::string msg =
+          "Input index " + std::to_string(inputIndex) +
+          " out of range (size: " + std::to_string(_inputTensors.size()) + ")";
+      throw InvalidArgumentException(msg);
+    }
+
+    const auto &modelInputDims = _modelManager->getInputDims();
+    std::vector<int64_t> modelShape;
+    if (inputIndex < static_cast<int>(modelInputDims.size())) {
+      modelShape = modelInputDims[inputIndex];
+    }
+
+    TensorProcessor::InputTensorInfo &input = _inputTensors[inputIndex];
+    try {
+      input.data = std::make_shared<const std::vector<float>>(
+          TensorProcessor::parameterTensor(modelShape, values, _batchSize,
+                                           input.shape));
+    } catch (const std::invalid_argument &e) {
+      throw InvalidArgumentException("Parameter input " + input.name + ": " +
+                                     e.what());
+    }
+    input.valid = !input.data->empty();
+  }
+
   /**
    * Run inference using prepared input tensors
    * @param outputTensor Output tensor to store results
+   * @param statistics Optional statistics of the output, collected while it
+   *                   is copied (NaN and Inf are then stored as 0)
    */
-  void runInference(std::vector<float> &outputTensor) {
+  void runInference(std::vector<float> &outputTensor,
+                    TensorProcessor::OutputStatistics *statistics = nullptr) {
+    outputTensor.clear();
+    runPrepared([&](const std::vector<const std::vector<float> *> &inputs,
+                    const std::vector<std::vector<int64_t>> &shapes,
+                    const std::vector<std::string> &names,
+                    std::vector<int64_t> *outputShape) {
+      if (inputs.size() > 1) {
+        _modelManager->runInferenceMultiInput(inputs, shapes, names,
+                                              outputTensor, outputShape,
+                                              statistics);
+      } else {
+        _modelManager->runInference(*inputs[0], shapes[0], outputTensor,
+                                    outputShape, statistics);
+      }
+    });
+  }
+
+  /**
+   * Run inference using prepared input tensors, keeping the output in the
+   * buffer ONNX Runtime produced it in instead of copying it
+   * @param output Receives the output
+   * @param statistics Optional statistics of the output, collected in place
+   *                   (NaN and Inf are then stored as 0)
+   */
+  void runInference(ONNXModelManager::InferenceOutput &output,
+                    TensorProcessor::OutputStatistics *statistics = nullptr) {
+    output.reset();
+    runPrepared([&](const std::vector<const std::vector<float> *> &inputs,
+                    const std::vector<std::vector<int64_t>> &shapes,
+                    const std::vector<std::string> &names,
+                    std::vector<int64_t> *outputShape) {
+      _modelManager->runInferenceInPlace(inputs, shapes, names, output,
+                                         outputShape, statistics);
+    });
+  }
+
+  /**
+   * Check if the output is single-channel
+   * @return True if output is single-channel
+   */
+  bool isSingleChannelOutput() const { return _isSingleChannel; }
+
+  /**
+   * Get the number of output channels
+   * @return Output channel count
+   */
+  int getOutputChannelCount() const { return _outputChannels; }
+
+  /**
+   * Access a specific input tensor
+   * @param index The input tensor index
+   * @return Reference to the input tensor
+   */
+  TensorProcessor::InputTensorInfo &getInputTensor(size_t index) {
+    if (index >= _inputTensors.size()) {
+      throw std::out_of_range("Input tensor index out of range");
+    }
+    return _inputTensors[index];
+  }
+
+  /**
+   * Get all input tensors
+   * @return Vector of input tensors
+   */
+  const std::vector<TensorProcessor::InputTensorInfo> &getInputTensors() const {
+    return _inputTensors;
+  }
+
+private:
+  // Runs the model on the collected inputs and reports the output shape
+  using ModelRunner = std::function<void(
+      const std::vector<const std::vector<float> *> &,
+      const std::vector<std::vector<int64_t>> &,
+      const std::vector<std::string> &, std::vector<int64_t> *)>;
+
+  /**
+   * Collect the valid input tensors, run the model on them with runModel and
+   * update the output dimensions from the shape it produced
+   */
+  void runPrepared(const ModelRunner &runModel) {
     if (!_modelManager) {
       throw ConfigurationException("Model manager is not set");
     }
@@ -164,26 +389,28 @@ public:
 
     try {
       // Prepare data for inference
-      std::vector<std::vector<float>> inputTensors;
+      std::vector<const std::vector<float> *> inputTensors;
       std::vector<std::vector<int64_t>> inputShapes;
       std::vector<std::string> inputNames;
 
       // Collect all valid input tensors
       for (size_t i = 0; i < _inputTensors.size(); i++) {
         if (_inputTensors[i].valid) {
-          if (_inputTensors[i].data.empty()) {
+          if (!_inputTensors[i].data || _inputTensors[i].data->empty()) {
             throw ConfigurationException(
                 "Input tensor " + std::to_string(i) +
                 " has empty data despite being marked valid");
           }
 
-          if (_inputTensors[i].shape.empty()) {
+          // Only a scalar parameter has an empty (rank 0) shape
+          if (_inputTensors[i].shape.empty() &&
+              _inputTensors[i].data->size() != 1) {
             throw ConfigurationException(
                 "Input tensor " + std::to_string(i) +
                 " has empty shape despite being marked valid");
           }
 
-          inputTensors.push_back(_inputTensors[i].data);
+          inputTensors.push_back(_inputTensors[i].data.get());
           inputShapes.push_back(_inputTensors[i].shape);
           inputNames.push_back(_inputTensors[i].name);
         }
@@ -195,30 +422,15 @@ public:
             "No valid input tensors available for inference");
       }
 
-      // Clear output
-      outputTensor.clear();
-
-      // Use multi-input method if multiple valid inputs
-      if (inputTensors.size() > 1) {
-        try {
-          _modelManager->runInferenceMultiInput(inputTensors, inputShapes,
-                                                inputNames, outputTensor);
-        } catch (const std::exception &e) {
-          // Rethrow underlying exceptions as InferenceException
-          throw InferenceException(
-              std::string("Multi-input inference failed: ") + e.what());
-        }
-      }
-      // Fall back to single input method if only one valid input
-      else if (inputTensors.size() == 1) {
-        try {
-          _modelManager->runInference(inputTensors[0], inputShapes[0],
-                                      outputTensor);
-        } catch (const std::exception &e) {
-          // Rethrow underlying exceptions as InferenceException
-          throw InferenceException(
-              std::string("Single-input inference failed: ") + e.what());
-        }
+      std::vector<int64_t> outputShape;
+      try {
+        runModel(inputTensors, inputShapes, inputNames, &outputShape);
+      } catch (const std::exception &e) {
+        // Rethrow underlying exceptions as InferenceException
+        throw InferenceException(std::string(inputTensors.size() > 1
+                                                 ? "Multi-input"
+                                                 : "Single-input") +
+                                 " inference failed: " + e.what());
       }
 
       // Calculate output dimensions based on result
@@ -226,27 +438,29 @@ public:
       _outputWidth = _width;   // Default: same as input
       _outputHeight = _height; // Default: same as input
       _outputChannels = 1;     // Default: 1 channel
+      _outputBatch = 1;        // Default: 1 image
 
-      // Try to get model's output information
-      const auto &outputDims = _modelManager->getOutputDims();
-      if (!outputDims.empty() && !outputDims[0].empty()) {
+      // Use the shape produced by this run (the model's declared output
+      // shape may be shared with concurrent runs)
+      if (!outputShape.empty()) {
         // NCHW format: [batch, channels, height, width]
-        if (outputDims[0].size() >= 4) {
-          _outputChannels = static_cast<int>(outputDims[0][1]);
-          _outputHeight = static_cast<int>(outputDims[0][2]);
-          _outputWidth = static_cast<int>(outputDims[0][3]);
+        if (outputShape.size() >= 4) {
+          _outputBatch = static_cast<int>(outputShape[0]);
+          _outputChannels = static_cast<int>(outputShape[1]);
+          _outputHeight = static_cast<int>(outputShape[2]);
+          _outputWidth = static_cast<int>(outputShape[3]);
         }
         // CHW format: [channels, height, width]
-        else if (outputDims[0].size() == 3) {
-          _outputChannels = static_cast<int>(outputDims[0][0]);
-          _outputHeight = static_cast<int>(outputDims[0][1]);
-          _outputWidth = static_cast<int>(outputDims[0][2]);
+        else if (outputShape.size() == 3) {
+          _outputChannels = static_cast<int>(outputShape[0]);
+          _outputHeight = static_cast<int>(outputShape[1]);
+          _outputWidth = static_cast<int>(outputShape[2]);
         }
         // HW format: [height, width] - single channel
-        else if (outputDims[0].size() == 2) {
+        else if (outputShape.size() == 2) {
           _outputChannels = 1;
-          _outputHeight = static_cast<int>(outputDims[0][0]);
-          _outputWidth = static_cast<int>(outputDims[0][1]);
+          _outputHeight = static_cast<int>(outputShape[0]);
+          _outputWidth = static_cast<int>(outputShape[1]);
         }
       }
 
@@ -265,39 +479,6 @@ public:
     }
   }
 
-  /**
-   * Check if the output is single-channel
-   * @return True if output is single-channel
-   */
-  bool isSingleChannelOutput() const { return _isSingleChannel; }
-
-  /**
-   * Get the number of output channels
-   * @return Output channel count
-   */
-  int getOutputChannelCount() const { return _outputChannels; }
-
-  /**
-   * Access a specific input tensor
-   * @param index The input tensor index
-   * @return Reference to the input tensor
-   */
-  TensorProcessor::InputTensorInfo &getInputTensor(size_t index) {
-    if (index >= _inputTensors.size()) {
-      throw std::out_of_range("Input tensor index out of range");
-    }
-    return _inputTensors[index];
-  }
-
-  /**
-   * Get all input tensors
-   * @return Vector of input tensors
-   */
-  const std::vector<TensorProcessor::InputTensorInfo> &getInputTensors() const {
-    return _inputTensors;
-  }
-
-private:
   ONNXModelManager *_modelManager; // Model manager to use for inference
   std::vector<TensorProcessor::InputTensorInfo> _inputTensors; // Input tensors
 
@@ -305,10 +486,12 @@ private:
   int _width;
   int _height;
   int _channels;
+  int _batchSize;
 
   // Output dimensions
   int _outputWidth;
   int _outputHeight;
   int _outputChannels;
+  int _outputBatch;
   bool _isSingleChannel;
 };
\ No newline at end of file
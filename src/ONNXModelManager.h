@@ -1,10 +1,18 @@
 #pragma once
 
 #include "ErrorHandling.h"
+#include "InferenceDaemonClient.h"
+#include "Metrics.h"
+#include "TensorProcessor.h"
+#include "TraceRecorder.h"
 #include "onnxruntime_cxx_api.h"
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -12,15 +20,112 @@
  */
 class ONNXModelManager {
 public:
+  // Provides the destination buffer for a run's output, given its shape and
+  // element count
+  using OutputAllocator = InferenceDaemonClient::OutputAllocator;
+
+  /**
+   * First output of a run, kept in the buffer it was produced in. In-process
+   * runs hold on to ONNX Runtime's output value, and daemon runs to the
+   * shared memory segment the daemon wrote, so the result can be read
+   * without copying it.
+   * Further outputs, such as the state of a recurrent model, are returned
+   * too when requested by name.
+   */
+  class InferenceOutput {
+  public:
+    // An output returned by name, besides the first
+    struct NamedOutput {
+      std::string name;
+      std::vector<int64_t> shape;
+      const float *data;
+      size_t size;
+    };
+
+    InferenceOutput()
+        : _value(nullptr), _segment(), _owned(), _data(nullptr), _size(0),
+          _requestedNames(), _named(), _namedValues() {}
+
+    InferenceOutput(const InferenceOutput &) = delete;
+    InferenceOutput &operator=(const InferenceOutput &) = delete;
+
+    float *data() { return _data; }
+    const float *data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /**
+     * Own a buffer of count values in place of a run's output, e.g. for an
+     * output assembled from tiles
+     * @return The buffer, to be filled in
+     */
+    float *allocate(size_t count) {
+      reset();
+      _owned.resize(count);
+      _data = _owned.data();
+      _size = count;
+      return _data;
+    }
+
+    /**
+     * Set the outputs, besides the first, that later runs also return. The
+     * inference daemon only serves the first output, so runs that request
+     * others fail while it serves the model.
+     */
+    void requestOutputs(const std::vector<std::string> &names) {
+      _requestedNames = names;
+    }
+
+    /**
+     * A requested output of the last run, or nullptr if it was not returned
+     */
+    const NamedOutput *output(const std::string &name) const {
+      for (const NamedOutput &named : _named) {
+        if (named.name == name) {
+          return &named;
+        }
+      }
+      return nullptr;
+    }
+
+    /**
+     * Release the output buffers; the requested output names are kept
+     */
+    void reset() {
+      _value = Ort::Value(nullptr);
+      _segment.reset();
+      std::vector<float>().swap(_owned);
+      _data = nullptr;
+      _size = 0;
+      _named.clear();
+      _namedValues.clear();
+    }
+
+  private:
+    friend class ONNXModelManager;
+
+    Ort::Value _value;         // ONNX Runtime's output, when run in process
+    InferenceDaemonClient::OutputSegment _segment; // Daemon output
+    std::vector<float> _owned; // Output assembled by the caller
+    float *_data;
+    size_t _size;
+    std::vector<std::string> _requestedNames; // Outputs besides the first
+    std::vector<NamedOutput> _named;          // Requested outputs of the run
+    std::vector<Ort::Value> _namedValues;     // Values holding _named data
+  };
+
   ONNXModelManager()
       : _env(ORT_LOGGING_LEVEL_WARNING, "ONNXModelManager"), _session(nullptr),
         _allocator(std::make_unique<Ort::AllocatorWithDefaultOptions>()),
-        _modelLoaded(false) {}
+        _modelLoaded(false), _intraOpThreads(0), _useGPU(false),
+        _daemonModelId(0) {}
 
   ~ONNXModelManager() { unload(); }
 
   /**
-   * Load ONNX model from file
+   * Load ONNX model from file. When a daemon socket is set and the daemon is
+   * running, the model is loaded once in the daemon and shared; otherwise an
+   * in-process session is created.
    */
   void load(const char *modelPath, bool useGPU) {
     if (_modelLoaded) {
@@ -28,36 +133,27 @@ public:
     }
 
     _modelLoaded = false;
+    _modelPath = modelPath ? modelPath : "";
+    _useGPU = useGPU;
 
-    try {
-      // Configure session options
-      Ort::SessionOptions sessionOptions;
-
-      // Enable CUDA if requested and available
-      if (useGPU) {
-        OrtCUDAProviderOptions cudaOptions;
-        sessionOptions.AppendExecutionProvider_CUDA(cudaOptions);
-      }
-
-      // Create session
-      _session =
-          std::make_unique<Ort::Session>(_env, modelPath, sessionOptions);
-
-      // Extract model information
-      extractModelInfo();
-
-      _modelLoaded = true;
-    } catch (const Ort::Exception &e) {
-      throw ModelLoadException(std::string("ONNX Runtime error: ") + e.what());
-    } catch (const std::exception &e) {
-      throw ModelLoadException(std::string("Standard exception: ") + e.what());
+    Metrics::ScopedTimer timer(Metrics::registry().modelLoadTime);
+    if (_daemonSocketPath.empty() || !loadFromDaemon()) {
+      createLocalSession(true);
     }
+
+    _modelLoaded = true;
+    Metrics::registry().modelLoads.add();
+    Metrics::registry().modelsLoaded.add(1);
   }
 
   /**
    * Unload the model and free resources
    */
   void unload() {
+    {
+      std::lock_guard<std::mutex> lock(_daemonMutex);
+      _daemonClient.reset();
+    }
     _session.reset();
 
     // Clear input and output information
@@ -65,159 +161,204 @@ public:
     _outputNames.clear();
     _inputDims.clear();
     _outputDims.clear();
+    _inputTypes.clear();
+    {
+      std::lock_guard<std::mutex> lock(_shapeMutex);
+      _runShapes.clear();
+    }
 
+    if (_modelLoaded) {
+      Metrics::registry().modelsLoaded.add(-1);
+    }
     _modelLoaded = false;
   }
 
   /**
-   * Run inference on input tensor data
+   * Set the socket of the local inference daemon used by load(). An empty
+   * path always runs in-process.
    */
-  void runInference(const std::vector<float> &inputTensor,
-                    const std::vector<int64_t> &inputShape,
-                    std::vector<float> &outputTensor) {
-    if (!_modelLoaded || !_session) {
-      throw InferenceException("Model not loaded");
-    }
-
-    // Prepare memory info
-    Ort::MemoryInfo memoryInfo =
-        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-    // Create input tensor
-    Ort::Value inputOrtValue = Ort::Value::CreateTensor<float>(
-        memoryInfo, const_cast<float *>(inputTensor.data()), inputTensor.size(),
-        inputShape.data(), inputShape.size());
-
-    // Get input and output names
-    const char *inputName = _inputNames[0].c_str();
-    const char *outputName = _outputNames[0].c_str();
-
-    // Run inference
-    auto outputTensors = _session->Run(Ort::RunOptions{nullptr}, &inputName,
-                                       &inputOrtValue, 1, &outputName, 1);
-
-    // Process output
-    if (outputTensors.size() == 0 || !outputTensors[0].IsTensor()) {
-      throw InferenceException("Invalid output tensor from ONNX Runtime");
-    }
-
-    // Get output tensor info
-    auto typeInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
-    auto outputShape = typeInfo.GetShape();
-    size_t outputSize = typeInfo.GetElementCount();
+  void setDaemonSocketPath(const std::string &socketPath) {
+    _daemonSocketPath = socketPath;
+  }
 
-    // Store updated output shape
-    _outputDims[0] = outputShape;
+  /**
+   * Whether the loaded model is served by the inference daemon
+   */
+  bool isUsingDaemon() const {
+    std::lock_guard<std::mutex> lock(_daemonMutex);
+    return _daemonClient != nullptr;
+  }
 
-    // Get output data
-    const float *outputData = outputTensors[0].GetTensorData<float>();
+  /**
+   * Set the number of intra-op threads used by sessions created by load().
+   * Zero lets ONNX Runtime choose.
+   */
+  void setIntraOpThreads(int threads) {
+    _intraOpThreads = std::max(0, threads);
+  }
 
-    // Copy to output tensor
-    outputTensor.assign(outputData, outputData + outputSize);
+  /**
+   * Run inference on input tensor data
+   * @param outputShape Optional output for the shape produced by this run;
+   *                    safe to use when several threads run concurrently
+   * @param statistics Optional output statistics, gathered during the copy
+   */
+  void runInference(const std::vector<float> &inputTensor,
+                    const std::vector<int64_t> &inputShape,
+                    std::vector<float> &outputTensor,
+                    std::vector<int64_t> *outputShape = nullptr,
+                    TensorProcessor::OutputStatistics *statistics = nullptr) {
+    std::vector<const std::vector<float> *> inputTensors(1, &inputTensor);
+    std::vector<std::vector<int64_t>> inputShapes(1, inputShape);
+    std::vector<std::string> inputNames(1, std::string());
+
+    runInferenceMultiInput(inputTensors, inputShapes, inputNames, outputTensor,
+                           outputShape, statistics);
   }
 
   /**
    * Run inference with multiple input tensors
-   * @param inputTensors Vector of input tensors
+   * @param inputTensors Vector of pointers to input tensors (not copied)
    * @param inputShapes Vector of input shapes
    * @param inputNames Vector of input names (must match model's input names)
    * @param outputTensor Output tensor data
+   * @param outputShape Optional output for the shape produced by this run
+   * @param statistics Optional output statistics, gathered during the copy
    * @return True if inference was successful
    */
-  bool
-  runInferenceMultiInput(const std::vector<std::vector<float>> &inputTensors,
-                         const std::vector<std::vector<int64_t>> &inputShapes,
-                         const std::vector<std::string> &inputNames,
-                         std::vector<float> &outputTensor) {
-
-    if (!_modelLoaded || !_session) {
-      throw InferenceException("Model not loaded");
-    }
-
-    if (inputTensors.empty() || inputTensors.size() != inputShapes.size()) {
+  bool runInferenceMultiInput(
+      const std::vector<const std::vector<float> *> &inputTensors,
+      const std::vector<std::vector<int64_t>> &inputShapes,
+      const std::vector<std::string> &inputNames,
+      std::vector<float> &outputTensor,
+      std::vector<int64_t> *outputShape = nullptr,
+      TensorProcessor::OutputStatistics *statistics = nullptr) {
+    if (inputTensors.size() != inputNames.size()) {
       throw InvalidArgumentException(
-          "Mismatch between input tensors and shapes");
+          "Mismatch between input tensors and names");
     }
 
-    // Validate input names match model inputs
-    size_t numInputs = inputNames.size();
-    if (numInputs > _inputNames.size()) {
-      throw InvalidArgumentException("Too many inputs provided for the model");
+    std::vector<const float *> inputData;
+    std::vector<size_t> inputSizes;
+    for (size_t i = 0; i < inputTensors.size(); i++) {
+      if (!inputTensors[i]) {
+        throw InvalidArgumentException("Input tensor " + std::to_string(i) +
+                                       " is null");
+      }
+      inputData.push_back(inputTensors[i]->data());
+      inputSizes.push_back(inputTensors[i]->size());
     }
 
-    // Prepare memory info
-    Ort::MemoryInfo memoryInfo =
-        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-    // Create vector of input tensor values
-    std::vector<Ort::Value> inputValues;
-    std::vector<const char *> inputNamesCStr;
-
-    for (size_t i = 0; i < numInputs; i++) {
-      // Create tensor for this input
-      Ort::Value inputOrtValue = Ort::Value::CreateTensor<float>(
-          memoryInfo, const_cast<float *>(inputTensors[i].data()),
-          inputTensors[i].size(), inputShapes[i].data(), inputShapes[i].size());
-
-      inputValues.push_back(std::move(inputOrtValue));
-
-      // Get the correct input name from model
-      const char *inputName = nullptr;
-
-      // Try to match with provided name first
-      if (!inputNames[i].empty()) {
-        // Find matching input name in model
-        for (const auto &name : _inputNames) {
-          if (name == inputNames[i]) {
-            inputName = name.c_str();
-            break;
+    runInferenceRaw(
+        inputData, inputSizes, inputShapes, inputNames,
+        [&outputTensor](const std::vector<int64_t> &, size_t count) {
+          if (count > outputTensor.capacity()) {
+            Metrics::registry().bytesAllocated.add(
+                (count - outputTensor.capacity()) * sizeof(float));
           }
-        }
-      }
+          outputTensor.resize(count);
+          return outputTensor.data();
+        },
+        outputShape, statistics);
 
-      // If no match, use the default input name
-      if (inputName == nullptr) {
-        inputName = _inputNames[i].c_str();
-      }
+    return true;
+  }
 
-      inputNamesCStr.push_back(inputName);
+  /**
+   * Run inference and keep the first output where ONNX Runtime produced it,
+   * saving the copy runInferenceMultiInput makes
+   * @param inputTensors Vector of pointers to input tensors (not copied)
+   * @param inputShapes Vector of input shapes
+   * @param inputNames Vector of input names (empty names bind by position)
+   * @param output Receives the output
+   * @param outputShape Optional output for the shape produced by this run
+   * @param statistics When set, NaN and Inf are replaced with 0 and the
+   *                   output statistics collected, in place
+   */
+  void runInferenceInPlace(
+      const std::vector<const std::vector<float> *> &inputTensors,
+      const std::vector<std::vector<int64_t>> &inputShapes,
+      const std::vector<std::string> &inputNames, InferenceOutput &output,
+      std::vector<int64_t> *outputShape = nullptr,
+      TensorProcessor::OutputStatistics *statistics = nullptr) {
+    if (inputTensors.size() != inputNames.size()) {
+      throw InvalidArgumentException(
+          "Mismatch between input tensors and names");
     }
 
-    // Get first output name
-    const char *outputName = _outputNames[0].c_str();
-
-    // Run inference
-    auto outputTensors =
-        _session->Run(Ort::RunOptions{nullptr}, inputNamesCStr.data(),
-                      inputValues.data(), numInputs, &outputName, 1);
-
-    // Process output
-    if (outputTensors.size() == 0 || !outputTensors[0].IsTensor()) {
-      throw InferenceException("Invalid output tensor from ONNX Runtime");
+    std::vector<const float *> inputData;
+    std::vector<size_t> inputSizes;
+    for (size_t i = 0; i < inputTensors.size(); i++) {
+      if (!inputTensors[i]) {
+        throw InvalidArgumentException("Input tensor " + std::to_string(i) +
+                                       " is null");
+      }
+      inputData.push_back(inputTensors[i]->data());
+      inputSizes.push_back(inputTensors[i]->size());
     }
 
-    // Get output tensor info
-    auto typeInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
-    auto outputShape = typeInfo.GetShape();
-    size_t outputSize = typeInfo.GetElementCount();
-
-    // Store updated output shape
-    _outputDims[0] = outputShape;
-
-    // Get output data
-    const float *outputData = outputTensors[0].GetTensorData<float>();
-
-    // Copy to output tensor
-    outputTensor.assign(outputData, outputData + outputSize);
+    output.reset();
+    Metrics::Registry &metrics = Metrics::registry();
+    Metrics::ScopedTimer timer(metrics.runLatency);
+    try {
+      // A kept output is never copied, so no allocator is needed
+      runOnce(inputData, inputSizes, inputShapes, inputNames,
+              OutputAllocator(), outputShape, statistics, &output, false);
+    } catch (...) {
+      timer.dismiss();
+      metrics.inferenceFailures.add();
+      output.reset();
+      throw;
+    }
+    metrics.inferences.add();
+  }
 
-    return true;
+  /**
+   * Run inference on caller-owned input buffers. Inputs are wrapped in place;
+   * the first output is copied to the buffer returned by allocateOutput.
+   * @param inputData Pointers to the input tensors
+   * @param inputSizes Element counts of the input tensors
+   * @param inputShapes Vector of input shapes
+   * @param inputNames Vector of input names (empty names bind by position)
+   * @param allocateOutput Called with the output shape and element count;
+   *                       returns the destination for the output data
+   * @param outputShape Optional output for the shape produced by this run
+   * @param statistics When set, NaN and Inf are written as 0 and the output
+   *                   statistics are collected in the same pass as the copy
+   * @param bindOutput Let ONNX Runtime write the output straight into the
+   *                   buffer from allocateOutput when its shape is known
+   *                   before the run, i.e. the model declares it or an
+   *                   earlier run with the same input shapes produced it.
+   *                   allocateOutput may then be called before the run,
+   *                   and again if the guess was wrong.
+   */
+  void runInferenceRaw(
+      const std::vector<const float *> &inputData,
+      const std::vector<size_t> &inputSizes,
+      const std::vector<std::vector<int64_t>> &inputShapes,
+      const std::vector<std::string> &inputNames,
+      const OutputAllocator &allocateOutput,
+      std::vector<int64_t> *outputShape = nullptr,
+      TensorProcessor::OutputStatistics *statistics = nullptr,
+      bool bindOutput = false) {
+    Metrics::Registry &metrics = Metrics::registry();
+    Metrics::ScopedTimer timer(metrics.runLatency);
+    try {
+      runOnce(inputData, inputSizes, inputShapes, inputNames, allocateOutput,
+              outputShape, statistics, nullptr, bindOutput);
+    } catch (...) {
+      timer.dismiss(); // Keep failures out of the latency distribution
+      metrics.inferenceFailures.add();
+      throw;
+    }
+    metrics.inferences.add();
   }
 
   /**
    * Get model information as a formatted string
    */
   std::string getInfoString() const {
-    if (!_modelLoaded || !_session) {
+    if (!_modelLoaded) {
       return "No model loaded";
     }
 
@@ -240,6 +381,9 @@ public:
         }
         info << "]";
       }
+      if (!isImageInput(static_cast<int>(i))) {
+        info << " (parameter)";
+      }
       info << "\n";
     }
     info << "\n";
@@ -263,6 +407,11 @@ public:
     }
     info << "\n";
 
+    if (isUsingDaemon()) {
+      info << "Served by inference daemon: " << _daemonSocketPath << "\n";
+      return info.str();
+    }
+
     // Try to add model metadata if available
     try {
       Ort::ModelMetadata metadata = _session->GetModelMetadata();
@@ -295,6 +444,8 @@ public:
   const std::vector<std::vector<int64_t>> &getInputDims() const {
     return _inputDims;
   }
+  // Output shapes as the model declares them, -1 on dynamic axes; a run's
+  // actual shape is returned through its outputShape parameter
   const std::vector<std::vector<int64_t>> &getOutputDims() const {
     return _outputDims;
   }
@@ -304,6 +455,28 @@ public:
   // Get input names for mapping to Nuke inputs
   const std::vector<std::string> &getInputNames() const { return _inputNames; }
 
+  /**
+   * Whether a model input takes images (see TensorProcessor::isImageShape);
+   * the others are parameters fed from numbers
+   */
+  bool isImageInput(int index) const {
+    return index >= 0 && index < static_cast<int>(_inputDims.size()) &&
+           TensorProcessor::isImageShape(_inputDims[index]);
+  }
+
+  /**
+   * Indices of the model inputs that take images, in model order
+   */
+  std::vector<int> getImageInputs() const { return inputsWhere(true); }
+
+  /**
+   * Indices of the model inputs that take parameters, in model order
+   */
+  std::vector<int> getParameterInputs() const { return inputsWhere(false); }
+  const std::vector<std::string> &getOutputNames() const {
+    return _outputNames;
+  }
+
   // Extract channel and dimension information
   bool getOutputDimensions(int &width, int &height, int &channels) const {
     if (!_modelLoaded || _outputDims.empty() || _outputDims[0].empty()) {
@@ -330,6 +503,394 @@ public:
   }
 
 private:
+  // Run the model once; the public run methods add the metrics around it.
+  // With keepOutput, the output value or daemon segment is moved there
+  // instead of being copied to the buffer from allocateOutput.
+  void runOnce(const std::vector<const float *> &inputData,
+               const std::vector<size_t> &inputSizes,
+               const std::vector<std::vector<int64_t>> &inputShapes,
+               const std::vector<std::string> &inputNames,
+               const OutputAllocator &allocateOutput,
+               std::vector<int64_t> *outputShape,
+               TensorProcessor::OutputStatistics *statistics,
+               InferenceOutput *keepOutput, bool bindOutput) {
+    if (!_modelLoaded) {
+      throw InferenceException("Model not loaded");
+    }
+
+    if (inputData.empty() || inputData.size() != inputShapes.size() ||
+        inputData.size() != inputSizes.size()) {
+      throw InvalidArgumentException(
+          "Mismatch between input tensors and shapes");
+    }
+
+    // Validate input names match model inputs
+    size_t numInputs = inputNames.size();
+    if (numInputs > _inputNames.size()) {
+      throw InvalidArgumentException("Too many inputs provided for the model");
+    }
+    if (numInputs != inputData.size()) {
+      throw InvalidArgumentException(
+          "Mismatch between input tensors and names");
+    }
+
+    // Resolve the model input each tensor is bound to
+    std::vector<const char *> inputNamesCStr;
+    for (size_t i = 0; i < numInputs; i++) {
+      if (!inputData[i]) {
+        throw InvalidArgumentException("Input tensor " + std::to_string(i) +
+                                       " is null");
+      }
+
+      // Get the correct input name from model
+      const char *inputName = nullptr;
+
+      // Try to match with provided name first
+      if (!inputNames[i].empty()) {
+        // Find matching input name in model
+        for (const auto &name : _inputNames) {
+          if (name == inputNames[i]) {
+            inputName = name.c_str();
+            break;
+          }
+        }
+      }
+
+      // If no match, use the default input name
+      if (inputName == nullptr) {
+        inputName = _inputNames[i].c_str();
+      }
+
+      inputNamesCStr.push_back(inputName);
+    }
+
+    // Prefer the shared daemon; fall back to a local session if it has gone.
+    // The daemon returns only the first output, and a second copy of the
+    // model in process would defeat it, so runs that need others are
+    // refused while it serves the model.
+    bool namedOutputs = keepOutput && !keepOutput->_requestedNames.empty();
+    std::shared_ptr<InferenceDaemonClient> daemonClient;
+    {
+      std::lock_guard<std::mutex> lock(_daemonMutex);
+      daemonClient = _daemonClient;
+    }
+    if (daemonClient && namedOutputs) {
+      throw InferenceException(
+          "The inference daemon only returns the first output; turn off "
+          "Use Inference Daemon to run models with state bindings");
+    }
+    if (daemonClient) {
+      try {
+        std::vector<std::string> boundNames(inputNamesCStr.begin(),
+                                            inputNamesCStr.end());
+        std::vector<int64_t> runOutputShape;
+        Trace::Span span(Trace::kCategoryRuntime, "daemon run");
+        if (keepOutput) {
+          // Read the daemon's segment in place
+          size_t count = 0;
+          InferenceDaemonClient::OutputSegment segment =
+              daemonClient->runShared(_daemonModelId, inputData, inputSizes,
+                                      inputShapes, boundNames,
+                                      runOutputShape, count);
+          float *data = static_cast<float *>(segment->data());
+          TensorProcessor::copyOutput(data, data, count, runOutputShape,
+                                      statistics);
+          keepOutput->_segment = std::move(segment);
+          keepOutput->_data = data;
+          keepOutput->_size = count;
+        } else {
+          daemonClient->run(_daemonModelId, inputData, inputSizes,
+                            inputShapes, boundNames, allocateOutput,
+                            runOutputShape, statistics);
+        }
+        if (outputShape) {
+          *outputShape = runOutputShape;
+        }
+        return;
+      } catch (const DaemonUnavailableException &e) {
+        std::cerr << e.what() << "; falling back to in-process inference"
+                  << std::endl;
+        fallBackToLocalSession();
+      }
+    }
+
+    if (!_session) {
+      throw InferenceException("Model not loaded");
+    }
+
+    // Prepare memory info
+    Ort::MemoryInfo memoryInfo =
+        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+    // Create vector of input tensor values. Integer inputs, such as class
+    // ids, are converted from the float values they are given as.
+    std::vector<Ort::Value> inputValues;
+    std::vector<std::vector<int64_t>> int64Inputs(numInputs);
+    std::vector<std::vector<int32_t>> int32Inputs(numInputs);
+    for (size_t i = 0; i < numInputs; i++) {
+      ONNXTensorElementDataType type = inputType(inputNamesCStr[i]);
+      if (type == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+        int64Inputs[i].assign(inputData[i], inputData[i] + inputSizes[i]);
+        inputValues.push_back(Ort::Value::CreateTensor<int64_t>(
+            memoryInfo, int64Inputs[i].data(), inputSizes[i],
+            inputShapes[i].data(), inputShapes[i].size()));
+      } else if (type == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32) {
+        int32Inputs[i].assign(inputData[i], inputData[i] + inputSizes[i]);
+        inputValues.push_back(Ort::Value::CreateTensor<int32_t>(
+            memoryInfo, int32Inputs[i].data(), inputSizes[i],
+            inputShapes[i].data(), inputShapes[i].size()));
+      } else {
+        inputValues.push_back(Ort::Value::CreateTensor<float>(
+            memoryInfo, const_cast<float *>(inputData[i]), inputSizes[i],
+            inputShapes[i].data(), inputShapes[i].size()));
+      }
+    }
+
+    // The first output, then any requested by name
+    std::vector<const char *> outputNamesCStr(1, _outputNames[0].c_str());
+    if (namedOutputs) {
+      for (const std::string &name : keepOutput->_requestedNames) {
+        auto found = std::find(_outputNames.begin(), _outputNames.end(), name);
+        if (found == _outputNames.end()) {
+          throw InferenceException("Model has no output named " + name);
+        }
+        outputNamesCStr.push_back(found->c_str());
+      }
+    }
+
+    // Write into the caller's buffer when the output shape is known
+    std::vector<int64_t> expectedShape;
+    if (bindOutput && !namedOutputs && expectedOutputShape(inputShapes,
+                                                          expectedShape)) {
+      size_t count = 1;
+      for (int64_t d : expectedShape) {
+        count *= static_cast<size_t>(d);
+      }
+      float *destination = allocateOutput(expectedShape, count);
+      Ort::Value bound = Ort::Value::CreateTensor<float>(
+          memoryInfo, destination, count, expectedShape.data(),
+          expectedShape.size());
+      Ort::IoBinding binding(*_session);
+      for (size_t i = 0; i < numInputs; i++) {
+        binding.BindInput(inputNamesCStr[i], inputValues[i]);
+      }
+      binding.BindOutput(outputNamesCStr[0], bound);
+      try {
+        Trace::Span runSpan(Trace::kCategoryRuntime, "Session::Run");
+        runSpan.arg("bound", static_cast<int64_t>(1));
+        _session->Run(Ort::RunOptions{nullptr}, binding);
+        if (outputShape) {
+          *outputShape = expectedShape;
+        }
+        TensorProcessor::copyOutput(destination, destination, count,
+                                    expectedShape, statistics);
+        return;
+      } catch (const Ort::Exception &) {
+        // The shape changed; forget it and run again unbound
+        std::lock_guard<std::mutex> lock(_shapeMutex);
+        _runShapes.erase(inputShapes);
+      }
+    }
+
+    // Run inference
+    Trace::Span runSpan(Trace::kCategoryRuntime, "Session::Run");
+    auto outputTensors = _session->Run(
+        Ort::RunOptions{nullptr}, inputNamesCStr.data(), inputValues.data(),
+        numInputs, outputNamesCStr.data(), outputNamesCStr.size());
+    runSpan.end();
+
+    // Process output
+    if (outputTensors.size() == 0 || !outputTensors[0].IsTensor()) {
+      throw InferenceException("Invalid output tensor from ONNX Runtime");
+    }
+
+    // Get output tensor info
+    auto typeInfo = outputTensors[0].GetTensorTypeAndShapeInfo();
+    auto runOutputShape = typeInfo.GetShape();
+    size_t outputSize = typeInfo.GetElementCount();
+
+    // The run's shape goes only to the caller; the declared dims stay as
+    // loaded, so they can be read while other threads run the model
+    if (outputShape) {
+      *outputShape = runOutputShape;
+    }
+    if (bindOutput) {
+      rememberOutputShape(inputShapes, runOutputShape);
+    }
+
+    // Keep the output value; statistics are then gathered in place
+    if (keepOutput) {
+      Trace::Span keepSpan(Trace::kCategoryRuntime, "scan output");
+      keepSpan.arg("elements", static_cast<int64_t>(outputSize));
+      float *data = outputTensors[0].GetTensorMutableData<float>();
+      TensorProcessor::copyOutput(data, data, outputSize, runOutputShape,
+                                  statistics);
+      keepOutput->_value = std::move(outputTensors[0]);
+      keepOutput->_data = data;
+      keepOutput->_size = outputSize;
+
+      for (size_t i = 1; i < outputTensors.size(); i++) {
+        if (!outputTensors[i].IsTensor()) {
+          throw InferenceException(std::string("Output ") +
+                                   outputNamesCStr[i] + " is not a tensor");
+        }
+        auto namedInfo = outputTensors[i].GetTensorTypeAndShapeInfo();
+        if (namedInfo.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+          throw InferenceException(std::string("Output ") +
+                                   outputNamesCStr[i] + " is not float");
+        }
+        keepOutput->_named.push_back(InferenceOutput::NamedOutput{
+            outputNamesCStr[i], namedInfo.GetShape(),
+            outputTensors[i].GetTensorData<float>(),
+            namedInfo.GetElementCount()});
+        keepOutput->_namedValues.push_back(std::move(outputTensors[i]));
+      }
+      return;
+    }
+
+    // Get output data
+    const float *outputData = outputTensors[0].GetTensorData<float>();
+
+    // Copy to the caller's output buffer
+    Trace::Span copySpan(Trace::kCategoryRuntime, "copy output");
+    copySpan.arg("elements", static_cast<int64_t>(outputSize));
+    float *destination = allocateOutput(runOutputShape, outputSize);
+    TensorProcessor::copyOutput(outputData, destination, outputSize,
+                                runOutputShape, statistics);
+  }
+
+  // Create an in-process session for _modelPath
+  void createLocalSession(bool extractInfo) {
+    try {
+      // Configure session options
+      Ort::SessionOptions sessionOptions;
+
+      // Limit per-session threading when several runs share the machine
+      if (_intraOpThreads > 0) {
+        sessionOptions.SetIntraOpNumThreads(_intraOpThreads);
+      }
+
+      // Enable CUDA if requested and available
+      if (_useGPU) {
+        OrtCUDAProviderOptions cudaOptions;
+        sessionOptions.AppendExecutionProvider_CUDA(cudaOptions);
+      }
+
+      // Create session
+      Trace::Span span(Trace::kCategoryRuntime, "create session");
+      span.arg("model", _modelPath);
+      _session = std::make_unique<Ort::Session>(_env, _modelPath.c_str(),
+                                                sessionOptions);
+      readInputTypes();
+
+      // Extract model information
+      if (extractInfo) {
+        extractModelInfo();
+      }
+    } catch (const Ort::Exception &e) {
+      throw ModelLoadException(std::string("ONNX Runtime error: ") + e.what());
+    } catch (const std::exception &e) {
+      throw ModelLoadException(std::string("Standard exception: ") + e.what());
+    }
+  }
+
+  // Load the model in the daemon and take its model information.
+  // Returns false if the daemon is not running.
+  bool loadFromDaemon() {
+    std::shared_ptr<InferenceDaemonClient> client =
+        std::make_shared<InferenceDaemonClient>(_daemonSocketPath);
+    try {
+      InferenceDaemonClient::ModelInfo info =
+          client->loadModel(_modelPath, _useGPU);
+      _inputNames = info.inputNames;
+      _inputDims = info.inputDims;
+      _outputNames = info.outputNames;
+      _outputDims = info.outputDims;
+      if (_inputNames.empty() || _outputNames.empty()) {
+        throw ModelLoadException("Inference daemon returned no model inputs "
+                                 "or outputs");
+      }
+      _daemonModelId = info.modelId;
+
+      std::lock_guard<std::mutex> lock(_daemonMutex);
+      _daemonClient = client;
+      return true;
+    } catch (const DaemonUnavailableException &) {
+      return false;
+    }
+  }
+
+  // The daemon went away: switch to an in-process session of the same model
+  void fallBackToLocalSession() {
+    std::lock_guard<std::mutex> lock(_daemonMutex);
+    if (!_daemonClient) {
+      return; // Another thread already switched
+    }
+    if (!_session) {
+      createLocalSession(false);
+    }
+    _daemonClient.reset();
+  }
+
+  // Element types of the session's inputs, by name. Kept separately from
+  // the model information, which a daemon provides without them.
+  void readInputTypes() {
+    _inputTypes.clear();
+    for (size_t i = 0; i < _session->GetInputCount(); i++) {
+      Ort::AllocatedStringPtr namePtr =
+          _session->GetInputNameAllocated(i, *_allocator);
+      _inputTypes.emplace_back(namePtr.get(), _session->GetInputTypeInfo(i)
+                                                  .GetTensorTypeAndShapeInfo()
+                                                  .GetElementType());
+    }
+  }
+
+  ONNXTensorElementDataType inputType(const char *name) const {
+    for (const auto &input : _inputTypes) {
+      if (input.first == name) {
+        return input.second;
+      }
+    }
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+  }
+
+  std::vector<int> inputsWhere(bool image) const {
+    std::vector<int> indices;
+    for (int i = 0; i < getInputCount(); i++) {
+      if (isImageInput(i) == image) {
+        indices.push_back(i);
+      }
+    }
+    return indices;
+  }
+
+  // Shape the first output will have for these input shapes, if known
+  bool expectedOutputShape(const std::vector<std::vector<int64_t>> &inputShapes,
+                           std::vector<int64_t> &shape) {
+    if (!_outputDims.empty() && !_outputDims[0].empty() &&
+        std::all_of(_outputDims[0].begin(), _outputDims[0].end(),
+                    [](int64_t d) { return d > 0; })) {
+      shape = _outputDims[0];
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(_shapeMutex);
+    auto found = _runShapes.find(inputShapes);
+    if (found == _runShapes.end()) {
+      return false;
+    }
+    shape = found->second;
+    return true;
+  }
+
+  void rememberOutputShape(const std::vector<std::vector<int64_t>> &inputShapes,
+                           const std::vector<int64_t> &shape) {
+    std::lock_guard<std::mutex> lock(_shapeMutex);
+    if (_runShapes.size() >= 64) {
+      _runShapes.clear(); // Input sizes keep changing; start afresh
+    }
+    _runShapes[inputShapes] = shape;
+  }
+
   void extractModelInfo() {
     // Clear existing info
     _inputNames.clear();
@@ -383,10 +944,24 @@ private:
   std::unique_ptr<Ort::Session> _session;
   std::unique_ptr<Ort::AllocatorWithDefaultOptions> _allocator;
   bool _modelLoaded;
+  int _intraOpThreads; // Intra-op thread count for new sessions (0 = default)
+  std::string _modelPath; // Path of the loaded model
+  bool _useGPU;           // Whether the loaded model uses GPU execution
+
+  // Shared inference daemon
+  std::string _daemonSocketPath; // Daemon socket; empty runs in-process
+  std::shared_ptr<InferenceDaemonClient> _daemonClient; // Set while remote
+  uint32_t _daemonModelId;       // Model id inside the daemon
+  mutable std::mutex _daemonMutex; // Guards _daemonClient and fallback
+  std::mutex _shapeMutex; // Guards _runShapes
+  std::map<std::vector<std::vector<int64_t>>, std::vector<int64_t>>
+      _runShapes; // Output shape of earlier bound runs by input shapes
 
   // Model information
   std::vector<std::string> _inputNames;
   std::vector<std::string> _outputNames;
   std::vector<std::vector<int64_t>> _inputDims;
   std::vector<std::vector<int64_t>> _outputDims;
+  std::vector<std::pair<std::string, ONNXTensorElementDataType>>
+      _inputTypes; // Element type of each session input
 };
\ No newline at end of file
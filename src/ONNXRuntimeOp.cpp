@@ -1,14 +1,21 @@
 #include "ONNXRuntimeOp.h"
+#include "DDImage/Application.h"
 #include "DDImage/Format.h"
 #include "DDImage/NukeWrapper.h" // For Python integration
 #include "DDImage/Tile.h"
 #include "DDImage/gl.h"
 #include "ErrorHandling.h" // Include error handling
+#include "InferenceDaemonProtocol.h"
 #include "TensorProcessor.h"
+#include "TraceRecorder.h"
 #include "Utils.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstring>
+#include <exception>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <sstream>
@@ -18,21 +25,70 @@ using namespace DD::Image;
 static const char *const CLASS = "ONNXRuntimeOp";
 static const char *const HELP = "Runs inference on images using ONNX Runtime";
 
+// Labels for the normalize_mode knob, in TensorProcessor::NormalizeMode order
+static const char *const NORMALIZE_MODES[] = {"global", "per channel",
+                                              "per layer", nullptr};
+
+// Names and labels of the knobs that set the model's non-image inputs
+static const char *const PARAMETER_KNOBS[] = {"parameter_1", "parameter_2",
+                                              "parameter_3", "parameter_4"};
+static const char *const PARAMETER_LABELS[] = {"Parameter 1", "Parameter 2",
+                                               "Parameter 3", "Parameter 4"};
+
+// Labels for the normalize_range knob, in NormalizationIndex::RangeMode order
+static const char *const NORMALIZE_RANGES[] = {"per frame", "sequence",
+                                               "sliding window", nullptr};
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
 ONNXRuntimeOp::ONNXRuntimeOp(Node *node)
-    : Iop(node), _modelPath(""), _useGPU(false), _normalize(false),
-      _isSingleChannel(true), _outputChannelCount(1), _minValue(0.0f),
-      _maxValue(1.0f), _formats(), _dimensionsSet(false), _imgWidth(0),
-      _imgHeight(0), _imgChannels(0), _outputWidth(0), _outputHeight(0),
-      _modelManager(std::make_unique<ONNXModelManager>()),
+    : Iop(node), _modelPath(""), _interactiveModelPath(""),
+      _useInteractiveModel(true), _viewerShortcuts(false), _useGPU(false),
+      _normalize(false),
+      _normalizeMode(TensorProcessor::kNormalizeGlobal),
+      _normalizeLayers(""), _normalizeRange(NormalizationIndex::kRangeFrame),
+      _normalizeWindow(5), _normalizeLow(0.0f), _normalizeHigh(100.0f),
+      _normalizeStatsFile(""), _temporalFrames(3), _stateBindings(""),
+      _stateReach(10), _tiledInference(false), _tileSize(256),
+      _tileHalo(32), _maskedInference(false), _tightBBox(false),
+      _bboxThreshold(0.0f), _progressive(false), _previewScale(0.25f),
+      _progressiveTiles(false), _playbackFps(0.0f),
+      _useDaemon(false),
+      _isSingleChannel(true),
+      _outputChannelCount(1), _minValue(0.0f), _maxValue(1.0f),
+      _channelRanges(), _outputStatistics(), _normalizationIndex(),
+      _loadedStatsFile(), _formats(), _dimensionsSet(false),
+      _imgWidth(0), _imgHeight(0), _imgChannels(0), _outputWidth(0),
+      _outputHeight(0),
+      _renderModel(std::make_unique<ONNXModelManager>()),
+      _interactiveModel(std::make_unique<ONNXModelManager>()),
+      _modelManager(_renderModel.get()),
       _inferenceProcessor(std::make_unique<ONNXInferenceProcessor>()),
       _cacheLock(), _cacheValid(false), _processingDone(false),
-      _processedData(), _activeInputs(1) {
+      _postProcessValid(false), _inferenceHash(), _output(),
+      _activeInputs(1), _imageInputs(), _parameterInputs(),
+      _packedInputs(), _temporalBuffers(), _stateInputs(), _recurrentState(),
+      _tileCache(), _shownTiles(), _allTilesShown(true), _interest(),
+      _showingPreview(false), _reopened(false), _modelChanged(false),
+      _tileJobKey(0),
+      _tilesRemaining(0), _tilesUnpublished(false), _pastedTiles(),
+      _tileError(),
+      _contentBounds(), _contentBoundsKey(0), _contentBoundsKnown(false),
+      _governor(), _refinements(0), _refiner() {
+  for (int i = 0; i < kParameterKnobs; i++) {
+    _parameterValues[i] = "";
+  }
+
   // Initialize the format to use Format::None
   _formats.format(&DD::Image::Format::None);
   _formats.fullSizeFormat(&DD::Image::Format::None);
 
   // Connect the inference processor to the model manager
-  _inferenceProcessor->setModelManager(_modelManager.get());
+  _inferenceProcessor->setModelManager(_modelManager);
 }
 
 ONNXRuntimeOp::~ONNXRuntimeOp() {
@@ -49,26 +105,62 @@ std::string ONNXRuntimeOp::input_longlabel(int input) const {
     const auto &modelInputNames = _modelManager->getInputNames();
 
     // If we have a name for this input from the model, use it
-    if (input < static_cast<int>(modelInputNames.size())) {
+    if (input < static_cast<int>(_imageInputs.size())) {
       return std::string(label ? label : std::string("Input")) + " (" +
-             modelInputNames[input] + ")";
+             modelInputNames[_imageInputs[input]] + ")";
     }
   }
 
   return label ? std::string(label) : std::string();
 }
 
+const char *ONNXRuntimeOp::input_label(int input, char *buffer) const {
+  if (input == maskInput()) {
+    return "mask";
+  }
+  return Iop::input_label(input, buffer);
+}
+
 void ONNXRuntimeOp::updateActiveInputs() {
   if (!_modelManager->isLoaded()) {
     _activeInputs = 1; // Default to 1 input when no model is loaded
+    _imageInputs.clear();
+    _parameterInputs.clear();
+    _stateInputs.clear();
     return;
   }
 
-  // Get input count from the model
-  int modelInputCount = _modelManager->getInputCount();
-
-  // Set active inputs to the minimum of model inputs and maximum allowed
-  _activeInputs = std::min(modelInputCount, maximum_inputs());
+  // Image inputs become Nuke inputs; the others are set from knobs, apart
+  // from recurrent state fed back from the model's outputs. Bad bindings
+  // are reported when a frame is processed.
+  _imageInputs = _modelManager->getImageInputs();
+  _parameterInputs = _modelManager->getParameterInputs();
+  _stateInputs.clear();
+  try {
+    const auto &modelInputNames = _modelManager->getInputNames();
+    for (const RecurrentStateStore::Binding &binding : stateBindings()) {
+      _stateInputs.push_back(static_cast<int>(
+          std::find(modelInputNames.begin(), modelInputNames.end(),
+                    binding.input) -
+          modelInputNames.begin()));
+    }
+  } catch (const ConfigurationException &) {
+    _stateInputs.clear();
+  }
+  auto isState = [this](int index) {
+    return std::find(_stateInputs.begin(), _stateInputs.end(), index) !=
+           _stateInputs.end();
+  };
+  _imageInputs.erase(
+      std::remove_if(_imageInputs.begin(), _imageInputs.end(), isState),
+      _imageInputs.end());
+  _parameterInputs.erase(std::remove_if(_parameterInputs.begin(),
+                                        _parameterInputs.end(), isState),
+                         _parameterInputs.end());
+  int imageInputCount = static_cast<int>(_imageInputs.size());
+
+  // Set active inputs to the minimum of image inputs and maximum allowed
+  _activeInputs = std::min(imageInputCount, maximum_inputs());
 
   // Ensure at least one input is active
   if (_activeInputs < 1) {
@@ -76,6 +168,67 @@ void ONNXRuntimeOp::updateActiveInputs() {
   }
 }
 
+std::vector<RecurrentStateStore::Binding>
+ONNXRuntimeOp::stateBindings() const {
+  std::vector<RecurrentStateStore::Binding> bindings;
+  try {
+    bindings = RecurrentStateStore::parseBindings(
+        _stateBindings ? _stateBindings : "");
+  } catch (const std::invalid_argument &e) {
+    throw ConfigurationException(e.what());
+  }
+
+  const auto &inputNames = _modelManager->getInputNames();
+  const auto &outputNames = _modelManager->getOutputNames();
+  for (const RecurrentStateStore::Binding &binding : bindings) {
+    if (std::find(outputNames.begin(), outputNames.end(), binding.output) ==
+        outputNames.end()) {
+      throw ConfigurationException("State binding: model has no output " +
+                                   binding.output);
+    }
+    if (std::find(inputNames.begin(), inputNames.end(), binding.input) ==
+        inputNames.end()) {
+      throw ConfigurationException("State binding: model has no input " +
+                                   binding.input);
+    }
+    if (!outputNames.empty() && binding.output == outputNames[0]) {
+      throw ConfigurationException("State binding: the first output, " +
+                                   binding.output + ", is the image");
+    }
+  }
+  return bindings;
+}
+
+int ONNXRuntimeOp::maskInput() const {
+  // The input after the model's image inputs
+  return _maskedInference && _activeInputs < maximum_inputs() ? _activeInputs
+                                                              : -1;
+}
+
+int ONNXRuntimeOp::inputFrameCount(int input) const {
+  if (input < 0 || input >= static_cast<int>(_imageInputs.size()) ||
+      !_modelManager->isLoaded()) {
+    return 1;
+  }
+  return TensorProcessor::temporalFrames(
+      _modelManager->getInputDims()[_imageInputs[input]], _temporalFrames);
+}
+
+int ONNXRuntimeOp::split_input(int input) const {
+  return inputFrameCount(input);
+}
+
+const OutputContext &ONNXRuntimeOp::inputContext(int input, int split,
+                                                 OutputContext &context) const {
+  context = outputContext();
+  int frameCount = inputFrameCount(input);
+  if (frameCount > 1) {
+    context.setFrame(outputContext().frame() +
+                     TemporalFrameBuffer::splitOffset(split, frameCount));
+  }
+  return context;
+}
+
 void ONNXRuntimeOp::_validate(bool for_real) {
   // First copy input format and bbox
   copy_info();
@@ -105,10 +258,34 @@ void ONNXRuntimeOp::_validate(bool for_real) {
         error("Primary input (input 0) must be connected");
       }
 
+      // Other inputs are packed at their own formats, so they need them,
+      // as do the other frames of temporal inputs
+      for (int i = 0; i < _activeInputs; i++) {
+        for (int split = i == 0 ? 1 : 0; split < inputFrameCount(i);
+             split++) {
+          if (input(i, split)) {
+            input(i, split)->validate(for_real);
+          }
+        }
+      }
+      if (maskInput() >= 0 && input(maskInput())) {
+        input(maskInput())->validate(for_real);
+      }
+
       // Update output dimensions if model is loaded
       if (!_dimensionsSet) {
         updateDimensions(); // updateDimensions handles its own errors
       }
+
+      // Where the output has content is only known once the engine ran
+      if (_tightBBox) {
+        setContentBounds();
+      }
+    }
+
+    // Pick up saved statistics, e.g. when a script is opened
+    if (_normalizeStatsFile && _loadedStatsFile != _normalizeStatsFile) {
+      loadNormalizationStats();
     }
   }
 
@@ -122,29 +299,133 @@ void ONNXRuntimeOp::_validate(bool for_real) {
 
 void ONNXRuntimeOp::_request(int x, int y, int r, int t, ChannelMask channels,
                              int count) {
+  // Progressive tiles start from the middle of what was asked for
+  _interest.set(x, y, r, t);
+
   // Request the entire image from all active inputs
   // This ensures we have access to complete images for ONNX processing
-  Format f = input0().format();
 
   // We'll always need RGBA channels for processing
   ChannelMask requestChannels = Mask_RGBA;
 
-  // Create the requested output but request RGBA from all inputs
+  // Create the requested output but request RGBA from all inputs, each at
+  // its own format
   for (int i = 0; i < _activeInputs; i++) {
-    if (input(i)) {
-      // Use the format of the first input for consistency
-      input(i)->request(f.x(), f.y(), f.r(), f.t(), requestChannels, count);
+    for (int split = 0; split < inputFrameCount(i); split++) {
+      Iop *frameInput = input(i, split);
+      if (frameInput) {
+        const Format &f = frameInput->format();
+        frameInput->request(f.x(), f.y(), f.r(), f.t(), requestChannels,
+                            count);
+      }
     }
   }
+  if (maskInput() >= 0 && input(maskInput())) {
+    const Format &f = input(maskInput())->format();
+    input(maskInput())->request(f.x(), f.y(), f.r(), f.t(), Mask_Alpha,
+                                count);
+  }
 }
 
 void ONNXRuntimeOp::_open() {
-  // Reset cache when the node is opened
-  _cacheValid = false;
-  _processingDone = false;
+  // Reset cache when the node is opened, unless only knobs applied after
+  // inference changed, e.g. normalization
+  if (!_cacheValid || inferenceHash() != _inferenceHash) {
+    _cacheValid = false;
+    _processingDone = false;
+  }
+  _postProcessValid = false;
+  _reopened = true;
   _dimensionsSet = false; // Reset dimensions flag on open
 }
 
+Hash ONNXRuntimeOp::contentBoundsKey() const {
+  Hash hash;
+  hash.append(inferenceHash().value());
+  hash.append(_normalize);
+  hash.append(_normalizeMode);
+  hash.append(_normalizeLayers ? _normalizeLayers : "");
+  hash.append(_normalizeRange);
+  hash.append(_normalizeWindow);
+  hash.append(_normalizeLow);
+  hash.append(_normalizeHigh);
+  hash.append(_bboxThreshold);
+  return hash;
+}
+
+void ONNXRuntimeOp::setContentBounds() {
+  if (!input(0)) {
+    return;
+  }
+
+  // Validation never waits for the model: it uses the bounds of the last
+  // inference of this image, and the full bbox until they are known
+  Guard guard(_cacheLock);
+  if (!_contentBoundsKnown ||
+      _contentBoundsKey != contentBoundsKey().value()) {
+    return; // Keep the full bbox
+  }
+  Box content = _contentBounds;
+
+  // Input alpha the model does not replace, and the input away from the
+  // mask, pass through where the input has them
+  bool alphaPasses = _isSingleChannel || _outputChannelCount <= 3;
+  bool inputPasses = !_allTilesShown;
+  if ((alphaPasses && input0().channels().contains(Chan_Alpha)) ||
+      inputPasses) {
+    content.merge(input0().info());
+  }
+  info_.set(content);
+}
+
+void ONNXRuntimeOp::updateContentBounds() {
+  // Bounds of a preview or of a frame with tiles still to come would crop
+  // the final image
+  if (!_processingDone || _showingPreview || !_allTilesShown) {
+    return;
+  }
+
+  // Compare what the engine will output: the first four channels, after
+  // normalization
+  int channels = std::min(_isSingleChannel ? 1 : _outputChannelCount, 4);
+  size_t planeSize = static_cast<size_t>(_outputWidth) * _outputHeight;
+  if (_output.size() < channels * planeSize) {
+    return;
+  }
+  std::vector<float> thresholds(channels, _bboxThreshold);
+  if (_normalize) {
+    for (int c = 0; c < channels; c++) {
+      thresholds[c] = TensorProcessor::normalizedThreshold(
+          c < static_cast<int>(_channelRanges.size())
+              ? _channelRanges[c]
+              : TensorProcessor::NormalizationRange(_minValue, _maxValue),
+          _bboxThreshold);
+    }
+  }
+
+  Trace::Span span(Trace::kCategoryPipeline, "content bbox");
+  int x = 0, y = 0, r = 1, t = 1; // Nuke boxes are at least one pixel
+  TensorProcessor::contentBounds(_output.data(), _outputWidth, _outputHeight,
+                                 thresholds, !_normalize, x, y, r, t);
+  Box content(x, y, r, t);
+  uint64_t key = contentBoundsKey().value();
+  bool changed = !_contentBoundsKnown || _contentBoundsKey != key ||
+                 content.x() != _contentBounds.x() ||
+                 content.y() != _contentBounds.y() ||
+                 content.r() != _contentBounds.r() ||
+                 content.t() != _contentBounds.t();
+  _contentBounds = content;
+  _contentBoundsKey = key;
+  _contentBoundsKnown = true;
+
+  // The viewer validated with the previous bounds; the new hash validates
+  // again, from the bounds kept here
+  if (changed) {
+    _refinements++;
+    asapUpdate();
+  }
+}
+
 void ONNXRuntimeOp::setupOutputChannels(ChannelSet &channels) {
   // Simply ensure the output channels (typically RGBA) are turned on
   info_.turn_on(channels);
@@ -152,6 +433,8 @@ void ONNXRuntimeOp::setupOutputChannels(ChannelSet &channels) {
 
 void ONNXRuntimeOp::engine(int y, int x, int r, ChannelMask channels,
                            Row &row) {
+  Trace::RowScope traceRow(this, y);
+
   // When model isn't loaded or operation is aborted, pass through input
   if (!_modelManager->isLoaded() || aborted()) {
     if (input(0)) {
@@ -163,32 +446,7 @@ void ONNXRuntimeOp::engine(int y, int x, int r, ChannelMask channels,
   }
 
   // Process the image if needed
-  bool processing_succeeded = false;
-  { // Scope for lock guard
-    Guard guard(_cacheLock);
-    if (!_cacheValid) {
-      try {
-        cacheAndProcessImage();
-        processing_succeeded = true;
-
-        // Find min/max values for normalization if successfully processed
-        if (_normalize) { // No need to check _processingDone, exception handles
-                          // failure
-          findMinMaxValues();
-        }
-
-      } catch (const ONNXPluginError &e) {
-        error("Processing failed: %s", e.what());
-        processing_succeeded = false;
-      } catch (const std::exception &e) {
-        error("Unexpected error during processing: %s", e.what());
-        processing_succeeded = false;
-      }
-      _processingDone =
-          processing_succeeded; // Update status based on try-catch
-      _cacheValid = true; // Mark cache as checked, even if processing failed
-    }
-  }
+  processIfNeeded();
 
   // If processing failed or y is out of bounds, use input data if available
   if (!_processingDone || y < 0 ||
@@ -210,13 +468,162 @@ void ONNXRuntimeOp::engine(int y, int x, int r, ChannelMask channels,
     inputRow.erase(Mask_RGBA);
   }
 
-  Utils::processTensorDataToRow(_processedData, y, x, r, channels, row,
-                                inputRow, _outputWidth, _outputHeight,
-                                _outputChannelCount, _isSingleChannel,
-                                _normalize, _minValue, _maxValue);
+  Utils::processTensorDataToRow(
+      _output.data(), _output.size(), y, x, r, channels, row, inputRow,
+      _outputWidth, _outputHeight, _outputChannelCount, _isSingleChannel,
+      _normalize, _minValue, _maxValue,
+      _channelRanges.empty() ? nullptr : &_channelRanges);
+
+  // Away from the mask, and where tiles are still being inferred, the input
+  // passes through
+  if (!_allTilesShown) {
+    int start = x;
+    for (const std::pair<int, int> &span :
+         _tileCache.tileSpans(y, _shownTiles)) {
+      if (span.first > start && start < r) {
+        row.copy(inputRow, channels, start, std::min(span.first, r));
+      }
+      start = std::max(start, span.second);
+    }
+    if (start < r) {
+      row.copy(inputRow, channels, start, r);
+    }
+  }
+}
+
+void ONNXRuntimeOp::processIfNeeded() {
+  Trace::Span lockWait(Trace::kCategoryLock, "wait _cacheLock");
+  Guard guard(_cacheLock);
+  lockWait.end();
+
+  // After a model change the input shows until the node is opened again,
+  // as rows of the old output may still be read until then
+  if (_modelChanged) {
+    if (!_reopened) {
+      return;
+    }
+    dropModelBuffers();
+    _modelChanged = false;
+  }
+
+  // The full-resolution result replaces the preview once it is ready, and
+  // tiles finished in the background are shown; neither is kept once
+  // progressive mode is off. Rows of the old output may still be read until
+  // the op is opened again.
+  if (_reopened) {
+    ProgressiveRefiner::Result refined;
+    bool previewWanted = progressiveActive() || governorActive();
+    if ((_showingPreview && !previewWanted) ||
+        (_tilesRemaining > 0 && !progressiveActive())) {
+      _cacheValid = false;
+    } else if (_showingPreview &&
+               _refiner.take(inferenceHash().value(), refined)) {
+      if (refined.error.empty()) {
+        adoptRefinement(refined);
+      } else {
+        error("Full resolution inference failed: %s", refined.error.c_str());
+      }
+    }
+    if (_cacheValid && _tilesUnpublished) {
+      if (!_tileError.empty()) {
+        error("Tile inference failed: %s", _tileError.c_str());
+        _tileError.clear();
+      }
+      publishTiles(true);
+      storeFrameStatistics();
+      _postProcessValid = false;
+    }
+  }
+
+  if (!_cacheValid) {
+    bool processing_succeeded = false;
+    try {
+      cacheAndProcessImage();
+      processing_succeeded = true;
+    } catch (const ONNXPluginError &e) {
+      error("Processing failed: %s", e.what());
+      processing_succeeded = false;
+    } catch (const std::exception &e) {
+      error("Unexpected error during processing: %s", e.what());
+      processing_succeeded = false;
+    }
+    _processingDone = processing_succeeded; // Update status based on try-catch
+    _cacheValid = true; // Mark cache as checked, even if processing failed
+    _inferenceHash = inferenceHash();
+    _postProcessValid = false;
+  }
+
+  // The normalization ranges come from the kept output, so changing the
+  // post-processing knobs only redoes this
+  if (!_postProcessValid) {
+    if (_processingDone && _normalize) {
+      Trace::Span span(Trace::kCategoryPipeline, "normalization range");
+      try {
+        findMinMaxValues();
+      } catch (const std::exception &e) {
+        error("Normalization failed: %s", e.what());
+      }
+    }
+    if (_tightBBox && Application::gui) {
+      updateContentBounds(); // Renders have validated for good already
+    }
+    _postProcessValid = true;
+  }
+  _reopened = false;
+}
+
+bool ONNXRuntimeOp::progressiveActive() const {
+  // A preview, or a frame with tiles missing, is only served once the user
+  // has said that requests in the GUI come from the viewer
+  return _progressive && viewerShortcuts();
+}
+
+bool ONNXRuntimeOp::governorActive() const {
+  // A Write rendered from the GUI looks like playback, as its frames also
+  // step one at a time, so frames are only lowered for a vouched-for viewer
+  return _playbackFps > 0.0f && viewerShortcuts();
+}
+
+void ONNXRuntimeOp::append(Hash &hash) {
+  // A finished refinement, or newly known content bounds, change the image
+  // without changing the inputs
+  hash.append(_refinements.load());
+}
+
+Hash ONNXRuntimeOp::inferenceHash() const {
+  Hash hash;
+  hash.append(_modelPath ? _modelPath : "");
+  hash.append(_modelManager == _interactiveModel.get()
+                  ? _interactiveModelPath
+                  : ""); // Switching sessions infers again
+  hash.append(_useDaemon);
+  hash.append(outputContext().frame());
+  for (int i = 0; i < kParameterKnobs; i++) {
+    hash.append(_parameterValues[i] ? _parameterValues[i] : "");
+  }
+  hash.append(_temporalFrames);
+  hash.append(_stateBindings ? _stateBindings : "");
+  hash.append(_stateReach);
+  hash.append(_tiledInference);
+  hash.append(_tileSize);
+  hash.append(_tileHalo);
+  hash.append(_maskedInference);
+  for (int i = 0; i < _activeInputs; i++) {
+    for (int split = 0; split < inputFrameCount(i); split++) {
+      hash.append(input(i, split) ? input(i, split)->hash().value() : 0);
+    }
+  }
+  if (maskInput() >= 0 && input(maskInput())) {
+    hash.append(input(maskInput())->hash().value());
+  }
+  return hash;
 }
 
 void ONNXRuntimeOp::cacheAndProcessImage() {
+  Trace::Span span(Trace::kCategoryPipeline, "cacheAndProcessImage");
+  span.arg("node", node_name());
+  Clock::time_point started = Clock::now();
+
   if (!_modelManager->isLoaded()) {
     throw ConfigurationException(
         "Attempted to process image but no model is loaded");
@@ -241,9 +648,72 @@ void ONNXRuntimeOp::cacheAndProcessImage() {
   }
 
   _inferenceProcessor->setInputDimensions(_imgWidth, _imgHeight, _imgChannels);
-  _inferenceProcessor->prepareInputs(_activeInputs);
+  _inferenceProcessor->prepareInputs(_modelManager->getInputCount());
+
+  // Parameter inputs are small tensors built from their knobs
+  for (size_t p = 0; p < _parameterInputs.size(); p++) {
+    if (p >= static_cast<size_t>(kParameterKnobs)) {
+      throw ConfigurationException(
+          "Model has more than " + std::to_string(kParameterKnobs) +
+          " non-image inputs");
+    }
+    std::vector<float> values;
+    try {
+      values = TensorProcessor::parseParameterValues(
+          _parameterValues[p] ? _parameterValues[p] : "");
+    } catch (const std::invalid_argument &e) {
+      throw ConfigurationException(std::string("Parameter ") +
+                                   std::to_string(p + 1) + ": " + e.what());
+    }
+    _inferenceProcessor->setParameterInput(_parameterInputs[p], values);
+  }
 
-  for (int i = 0; i < _activeInputs; i++) {
+  // Inputs to pack; inputs with the same upstream and packed size (e.g. one
+  // image wired to two inputs) share one job
+  struct PackJob {
+    const Iop *input;
+    InputTensorCache::Key key;
+    int firstInput;               // Model input that needs it first
+    std::vector<int> modelInputs; // Model inputs bound to it directly
+    InputTensorCache::TensorPtr tensor;
+  };
+  std::vector<PackJob> jobs;
+  int reusedInputs = 0;
+  auto jobFor = [&](const Iop *op, const InputTensorCache::Key &key,
+                    int modelInput) -> int {
+    auto same = std::find_if(jobs.begin(), jobs.end(), [&](const PackJob &j) {
+      return !(j.key < key) && !(key < j.key);
+    });
+    if (same != jobs.end()) {
+      return static_cast<int>(same - jobs.begin());
+    }
+    jobs.push_back(PackJob{op, key, modelInput, {}, nullptr});
+    return static_cast<int>(jobs.size()) - 1;
+  };
+
+  // Temporal inputs gather one packed frame per time step of their window
+  struct TemporalWindow {
+    int modelInput;
+    int width, height;
+    std::vector<int> frames;
+    std::vector<InputTensorCache::Key> keys;
+    std::vector<InputTensorCache::TensorPtr> tensors;
+    std::vector<int> jobIndices; // Pack job per frame, or -1 if buffered
+  };
+  std::vector<TemporalWindow> windows;
+  int frame = currentFrame();
+  bool governed = governorActive();
+  bool playing =
+      governed &&
+      _governor.frameRequested(
+          frame,
+          std::chrono::duration<double>(started.time_since_epoch()).count(),
+          _playbackFps);
+
+  int imageInputCount =
+      std::min(_activeInputs, static_cast<int>(_imageInputs.size()));
+  for (int i = 0; i < imageInputCount; i++) {
+    int modelInput = _imageInputs[i];
     const Iop *currentInput = input(i);
     // Skip disconnected inputs (but input 0 check already happened)
     if (currentInput == nullptr) {
@@ -253,45 +723,702 @@ void ONNXRuntimeOp::cacheAndProcessImage() {
       }
       // Mark corresponding tensor as invalid if an optional input is
       // disconnected
-      if (i < static_cast<int>(_inferenceProcessor->getInputTensors().size())) {
-        _inferenceProcessor->getInputTensor(i).valid = false;
+      if (modelInput <
+          static_cast<int>(_inferenceProcessor->getInputTensors().size())) {
+        _inferenceProcessor->getInputTensor(modelInput).valid = false;
       }
+      _packedInputs.erase(modelInput);
       continue; // Skip preprocessing for disconnected optional inputs
     }
+    // Each input is packed at its own size, or resampled to the size the
+    // model declares for it, so small auxiliary inputs stay small
+    int width = 0, height = 0;
+    const Format &inputFormat = currentInput->format();
+    TensorProcessor::packedImageSize(
+        _modelManager->getInputDims()[modelInput], inputFormat.width(),
+        inputFormat.height(), width, height);
+    _inferenceProcessor->setInputImageSize(modelInput, width, height);
+
+    // A temporal input takes frames around the current one from the splits
+    // of its Nuke input; frames still in its ring buffer are not repacked
+    int frameCount = inputFrameCount(i);
+    if (frameCount > 1) {
+      TemporalFrameBuffer &buffer = _temporalBuffers[modelInput];
+      int capacity = TemporalFrameBuffer::kDefaultCapacity;
+      buffer.setCapacity(std::max(capacity, 2 * frameCount));
+      TemporalWindow window{modelInput, width, height, {}, {}, {}, {}};
+      for (int offset : TemporalFrameBuffer::windowOffsets(frameCount)) {
+        const Iop *frameInput =
+            input(i, TemporalFrameBuffer::splitOf(offset, frameCount));
+        if (!frameInput) {
+          throw ConfigurationException("Input " + std::to_string(i) +
+                                       " has no frame at offset " +
+                                       std::to_string(offset));
+        }
+        InputTensorCache::Key key =
+            Utils::makeInputTensorKey(*frameInput, width, height, 3);
+        InputTensorCache::TensorPtr tensor = buffer.find(frame + offset, key);
+        int jobIndex = -1;
+        if (tensor) {
+          reusedInputs++;
+        } else {
+          jobIndex = jobFor(frameInput, key, modelInput);
+        }
+        window.frames.push_back(frame + offset);
+        window.keys.push_back(key);
+        window.tensors.push_back(tensor);
+        window.jobIndices.push_back(jobIndex);
+      }
+      _inferenceProcessor->setInputFrameCount(modelInput, frameCount);
+      _packedInputs.erase(modelInput);
+      windows.push_back(std::move(window));
+      continue;
+    }
 
-    // Process this input image (throws on error)
-    std::vector<float> inputTensor;
-    preprocessImage(currentInput, inputTensor);
+    // Inputs whose upstream hash and packed size have not changed since the
+    // last inference keep their tensor, e.g. the plate while a mask is edited
+    InputTensorCache::Key key =
+        Utils::makeInputTensorKey(*currentInput, width, height, 3);
+    auto packed = _packedInputs.find(modelInput);
+    if (packed != _packedInputs.end() && !(packed->second.first < key) &&
+        !(key < packed->second.first)) {
+      _inferenceProcessor->setInputTensorData(modelInput,
+                                              packed->second.second);
+      reusedInputs++;
+      continue;
+    }
 
-    _inferenceProcessor->setInputTensorData(i, inputTensor);
+    jobs[jobFor(currentInput, key, modelInput)].modelInputs.push_back(
+        modelInput);
   }
 
-  _processedData.clear();
-  _inferenceProcessor->runInference(_processedData);
+  // Reuse the tensors another node already packed from the same upstream.
+  // The others are fetched on this Nuke thread, as a Tile already spreads
+  // the upstream work over Nuke's threads, and only packed concurrently.
+  // Failures are rethrown here, in input order.
+  span.arg("inputs_reused", reusedInputs);
+  std::vector<std::unique_ptr<Tile>> tiles(jobs.size());
+  for (size_t j = 0; j < jobs.size(); j++) {
+    jobs[j].tensor = InputTensorCache::instance().find(jobs[j].key);
+    if (!jobs[j].tensor) {
+      Trace::Span fetchSpan(Trace::kCategoryPipeline, "fetch input");
+      fetchSpan.arg("input", jobs[j].firstInput);
+      tiles[j] = Utils::fetchTile(*jobs[j].input, Mask_RGB);
+    }
+  }
+  std::vector<std::exception_ptr> failures(jobs.size());
+  TensorProcessor::parallelFor(jobs.size(), [&](size_t j) {
+    if (!tiles[j]) {
+      return;
+    }
+    try {
+      Trace::Span packSpan(Trace::kCategoryPipeline, "pack NCHW");
+      packSpan.arg("input", jobs[j].firstInput);
+      jobs[j].tensor = packTile(*tiles[j], jobs[j].key);
+    } catch (...) {
+      failures[j] = std::current_exception();
+    }
+  });
+  for (const std::exception_ptr &failure : failures) {
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+  for (const PackJob &job : jobs) {
+    for (int modelInput : job.modelInputs) {
+      _inferenceProcessor->setInputTensorData(modelInput, job.tensor);
+      _packedInputs[modelInput] = std::make_pair(job.key, job.tensor);
+    }
+  }
+  for (TemporalWindow &window : windows) {
+    TemporalFrameBuffer &buffer = _temporalBuffers[window.modelInput];
+    for (size_t t = 0; t < window.frames.size(); t++) {
+      if (window.jobIndices[t] >= 0) {
+        window.tensors[t] = jobs[window.jobIndices[t]].tensor;
+        buffer.store(window.frames[t], window.keys[t], window.tensors[t],
+                     frame);
+      }
+    }
+
+    Trace::Span windowSpan(Trace::kCategoryPipeline, "pack NCTHW");
+    windowSpan.arg("input", window.modelInput);
+    try {
+      _inferenceProcessor->setInputTensorData(
+          window.modelInput,
+          std::make_shared<const std::vector<float>>(
+              TemporalFrameBuffer::assemble(window.tensors, 3, window.width,
+                                            window.height)));
+    } catch (const std::invalid_argument &e) {
+      throw PreprocessException(e.what());
+    }
+  }
+
+  // Recurrent models start from the state the previous frame produced, or
+  // after a jump from the nearest earlier checkpoint; zeros otherwise
+  std::vector<RecurrentStateStore::Binding> bindings = stateBindings();
+  if (!bindings.empty() && _modelManager->isUsingDaemon()) {
+    throw ConfigurationException(
+        "State bindings need the model in process, as the inference daemon "
+        "only returns the first output: turn off Use Inference Daemon");
+  }
+  std::vector<std::string> stateOutputs;
+  uint64_t sourceHash = bindings.empty() ? 0 : inputsHashAt(frame);
+  int fromFrame = frame;
+  if (!bindings.empty()) {
+    _recurrentState.invalidateIfChanged(frame, sourceHash);
+    const RecurrentStateStore::State *previous = _recurrentState.resume(
+        frame, _stateReach,
+        [this](int checkpointFrame) { return inputsHashAt(checkpointFrame); },
+        fromFrame);
+    span.arg("state_age", previous ? frame - fromFrame : 0); // 0: zeros
+
+    const auto &modelInputNames = _modelManager->getInputNames();
+    for (const RecurrentStateStore::Binding &binding : bindings) {
+      int modelInput = static_cast<int>(
+          std::find(modelInputNames.begin(), modelInputNames.end(),
+                    binding.input) -
+          modelInputNames.begin());
+      RecurrentStateStore::Tensor tensor;
+      if (previous && previous->count(binding.input)) {
+        tensor = previous->at(binding.input);
+      } else {
+        tensor = RecurrentStateStore::zeroState(
+            _modelManager->getInputDims()[modelInput]);
+      }
+      _inferenceProcessor->setInputTensorData(modelInput, tensor.shape,
+                                              tensor.data);
+      stateOutputs.push_back(binding.output);
+    }
+  }
+
+  // The output stays in the buffer ONNX Runtime wrote it to; NaN and Inf are
+  // replaced and the statistics gathered there
+  _output.reset();
+  _showingPreview = false;
+  _allTilesShown = true;
+  _tileJobKey = 0; // Background tiles of an earlier frame are dropped
+  _tilesRemaining = 0;
+
+  // During playback the governor picks the scale, and the full resolution
+  // follows once playback stops; otherwise a progressive preview uses
+  // Preview Scale and is refined straight away
+  bool scalable = windows.empty() && bindings.empty();
+  double previewScale = 1.0, refineDelay = 0.0;
+  if (scalable && playing) {
+    previewScale = _governor.scale(_playbackFps);
+    refineDelay = PlaybackGovernor::idleSeconds(_playbackFps);
+    span.arg("playback_scale", previewScale);
+  } else if (scalable && progressiveActive()) {
+    previewScale = std::max(0.05f, std::min(1.0f, _previewScale));
+  }
+  bool progressiveTiles =
+      scalable && !playing && progressiveActive() && _progressiveTiles;
+
+  Clock::time_point inferenceStarted = Clock::now();
+  if (_tiledInference || _maskedInference || progressiveTiles) {
+    if (!windows.empty() || !bindings.empty()) {
+      throw ConfigurationException("Tiled inference cannot be used with "
+                                   "temporal inputs or state bindings");
+    }
+    runDirtyTiles();
+  } else if (previewScale < 1.0 && runPreview(previewScale, refineDelay)) {
+    _showingPreview = true;
+  } else {
+    _output.requestOutputs(stateOutputs);
+    Trace::Span inferenceSpan(Trace::kCategoryPipeline, "inference");
+    _inferenceProcessor->runInference(_output, &_outputStatistics);
+    inferenceSpan.end();
+    _inferenceProcessor->getOutputDimensions(_outputWidth, _outputHeight,
+                                             _outputChannelCount);
+  }
+
+  // Keep the state this frame produced for the next one
+  if (!bindings.empty()) {
+    RecurrentStateStore::State state;
+    for (const RecurrentStateStore::Binding &binding : bindings) {
+      const ONNXModelManager::InferenceOutput::NamedOutput *named =
+          _output.output(binding.output);
+      if (!named) {
+        throw InferenceException("State output " + binding.output +
+                                 " was not returned");
+      }
+      state[binding.input] = RecurrentStateStore::Tensor{
+          named->shape, std::make_shared<const std::vector<float>>(
+                            named->data, named->data + named->size)};
+    }
+    _recurrentState.store(frame, sourceHash, fromFrame, std::move(state));
+  }
 
-  if (_processedData.empty()) {
+  // The governor learns the cost of a frame from every frame it sees
+  if (governed) {
+    double inferenceSeconds = secondsSince(inferenceStarted);
+    uint64_t missed = _governor.missedDeadlines();
+    _governor.record(secondsSince(started), inferenceSeconds,
+                     _showingPreview ? previewScale : 1.0, _playbackFps);
+    Metrics::registry().playbackDeadlinesMissed.add(
+        _governor.missedDeadlines() - missed);
+  }
+
+  if (_output.empty()) {
     // Although runInference should throw if the ONNX result is invalid,
     // we add a check here for safety.
     throw InferenceException(
         "Inference completed but resulted in empty output data");
   }
 
-  _inferenceProcessor->getOutputDimensions(_outputWidth, _outputHeight,
-                                           _outputChannelCount);
-  _isSingleChannel = _inferenceProcessor->isSingleChannelOutput();
+  _isSingleChannel = _outputChannelCount == 1;
+
+  storeFrameStatistics();
+}
+
+void ONNXRuntimeOp::storeFrameStatistics() {
+  // Remember this frame's statistics for sequence and window normalization;
+  // a preview's, or those of a frame still being tiled, wait for the rest
+  if (!_showingPreview && _tilesRemaining == 0 &&
+      _outputStatistics.elementCount == _output.size()) {
+    _normalizationIndex.store(
+        currentFrame(), NormalizationIndex::FrameStatistics::fromOutput(
+                            _outputStatistics, _outputChannelCount));
+  }
 }
 
-void ONNXRuntimeOp::preprocessImage(const Iop *input,
-                                    std::vector<float> &inputTensor) {
-  if (!input) {
-    throw InvalidArgumentException(
-        "Null input pointer passed to preprocessImage");
+bool ONNXRuntimeOp::runPreview(double scale, double refineDelay) {
+  // Every image input is inferred smaller, so each needs a free size
+  std::vector<int> scaledInputs;
+  for (int modelInput : _imageInputs) {
+    const TensorProcessor::InputTensorInfo &info =
+        _inferenceProcessor->getInputTensor(modelInput);
+    if (!info.valid) {
+      continue;
+    }
+    const std::vector<int64_t> &dims =
+        _modelManager->getInputDims()[modelInput];
+    if (info.shape.size() != 4 || dims.size() != 4 || dims[2] > 0 ||
+        dims[3] > 0) {
+      return false;
+    }
+    scaledInputs.push_back(modelInput);
+  }
+  if (scaledInputs.empty()) {
+    return false;
   }
 
+  // The full-resolution inputs are inferred in the background, on a copy
+  // of the processor sharing their tensors. The refiner only calls back
+  // when its request is not stale, and the op outlives the callback, as
+  // destroying the refiner first joins its thread. The counter changes the
+  // hash, so the redraw asked for here validates and reopens the node;
+  // invalidate() is left to the main thread.
+  _refiner.request(
+      inferenceHash().value(), *_inferenceProcessor,
+      [this]() {
+        _refinements++;
+        asapUpdate();
+      },
+      refineDelay);
+
+  Trace::Span span(Trace::kCategoryPipeline, "preview");
+  int fullWidth = 0, previewWidth = 0, fullHeight = 0, previewHeight = 0;
+  for (int modelInput : scaledInputs) {
+    TensorProcessor::InputTensorInfo info =
+        _inferenceProcessor->getInputTensor(modelInput);
+    int channels = static_cast<int>(info.shape[1]);
+    int height = static_cast<int>(info.shape[2]);
+    int width = static_cast<int>(info.shape[3]);
+    int smallWidth = std::max(1, static_cast<int>(std::lround(width * scale)));
+    int smallHeight =
+        std::max(1, static_cast<int>(std::lround(height * scale)));
+    if (fullWidth == 0) {
+      fullWidth = width;
+      fullHeight = height;
+      previewWidth = smallWidth;
+      previewHeight = smallHeight;
+    }
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    size_t smallPlaneSize = static_cast<size_t>(smallWidth) * smallHeight;
+    auto small =
+        std::make_shared<std::vector<float>>(channels * smallPlaneSize);
+    for (int c = 0; c < channels; c++) {
+      TensorProcessor::resamplePlane(info.data->data() + c * planeSize, width,
+                                     height, small->data() + c * smallPlaneSize,
+                                     smallWidth, smallHeight);
+    }
+    std::vector<int64_t> shape = info.shape;
+    shape[2] = smallHeight;
+    shape[3] = smallWidth;
+    _inferenceProcessor->setInputTensorData(modelInput, shape, small);
+  }
+
+  ONNXModelManager::InferenceOutput preview;
+  _inferenceProcessor->runInference(preview);
+  int width = 0, height = 0, channels = 0;
+  _inferenceProcessor->getOutputDimensions(width, height, channels);
+  if (preview.size() < static_cast<size_t>(channels) * width * height) {
+    throw InferenceException("Preview output is smaller than its shape");
+  }
+
+  // Shown upscaled to the size the full-resolution output will have
+  double upscale = double(fullWidth) / previewWidth;
+  _outputWidth = std::max(1, static_cast<int>(std::lround(width * upscale)));
+  upscale = double(fullHeight) / previewHeight;
+  _outputHeight = std::max(1, static_cast<int>(std::lround(height * upscale)));
+  _outputChannelCount = channels;
+  size_t planeSize = static_cast<size_t>(_outputWidth) * _outputHeight;
+  size_t previewPlaneSize = static_cast<size_t>(width) * height;
+  float *output = _output.allocate(channels * planeSize);
+  for (int c = 0; c < channels; c++) {
+    TensorProcessor::resamplePlane(preview.data() + c * previewPlaneSize,
+                                   width, height, output + c * planeSize,
+                                   _outputWidth, _outputHeight);
+  }
+  TensorProcessor::copyOutput(output, output, _output.size(),
+                              {1, channels, _outputHeight, _outputWidth},
+                              &_outputStatistics);
+  return true;
+}
+
+void ONNXRuntimeOp::adoptRefinement(ProgressiveRefiner::Result &refined) {
+  std::copy(refined.data.begin(), refined.data.end(),
+            _output.allocate(refined.data.size()));
+  _outputWidth = refined.width;
+  _outputHeight = refined.height;
+  _outputChannelCount = refined.channels;
+  _isSingleChannel = _outputChannelCount == 1;
+  _outputStatistics = std::move(refined.statistics);
+  _showingPreview = false;
+  storeFrameStatistics();
+  _processingDone = true;
+  _postProcessValid = false;
+}
+
+void ONNXRuntimeOp::runDirtyTiles() {
+  Trace::Span span(Trace::kCategoryPipeline, "dirty tiles");
+
+  // Every connected image input is cut into the same tiles
+  std::vector<int> tiledInputs;
+  std::vector<InputTensorCache::TensorPtr> fullTensors;
+  std::vector<const std::vector<float> *> tensors;
+  int width = 0, height = 0;
+  for (int modelInput : _imageInputs) {
+    const TensorProcessor::InputTensorInfo &info =
+        _inferenceProcessor->getInputTensor(modelInput);
+    if (!info.valid) {
+      continue;
+    }
+    const std::vector<int64_t> &dims =
+        _modelManager->getInputDims()[modelInput];
+    if (info.shape.size() != 4 || info.shape[0] != 1 || dims[2] > 0 ||
+        dims[3] > 0) {
+      throw ConfigurationException(
+          "Tiled inference needs NCHW image inputs with batch 1 and a "
+          "dynamic height and width");
+    }
+    if (tiledInputs.empty()) {
+      height = static_cast<int>(info.shape[2]);
+      width = static_cast<int>(info.shape[3]);
+    } else if (info.shape[2] != height || info.shape[3] != width) {
+      throw ConfigurationException("Tiled inference needs every image input "
+                                   "at the same size");
+    }
+    tiledInputs.push_back(modelInput);
+    fullTensors.push_back(info.data);
+    tensors.push_back(info.data.get());
+  }
+
+  // The output of every tile also depends on the inputs that are not tiled
+  std::vector<float> layout(tiledInputs.begin(), tiledInputs.end());
+  uint64_t settingsHash =
+      DirtyTileCache::hashValues(layout.data(), layout.size());
+  for (int modelInput : _parameterInputs) {
+    const TensorProcessor::InputTensorInfo &info =
+        _inferenceProcessor->getInputTensor(modelInput);
+    if (info.valid && info.data) {
+      settingsHash = DirtyTileCache::hashValues(
+          info.data->data(), info.data->size(), settingsHash);
+    }
+  }
+
+  _tileCache.configure(width, height, _tileSize, _tileHalo);
+  if (!_tiledInference) {
+    _tileCache.invalidate(); // Only skipping tiles away from the mask
+  }
+
+  // Only tiles within the halo of the mask's non-zero alpha are wanted; with
+  // no mask connected, every tile is
+  std::vector<bool> nearMask;
+  const Iop *mask = maskInput() >= 0 ? input(maskInput()) : nullptr;
+  if (mask) {
+    Trace::Span maskSpan(Trace::kCategoryPipeline, "mask tiles");
+    std::vector<float> maskAlpha(static_cast<size_t>(width) * height);
+    Utils::tileChannelToPlane(Utils::extractTile(*mask, Mask_Alpha),
+                              Chan_Alpha, maskAlpha.data(), width, height);
+    nearMask = _tileCache.tilesNearMask(maskAlpha.data());
+  }
+
+  std::vector<size_t> dirty;
   try {
-    // Extract image and convert to NCHW tensor format (throws on error)
-    Tile tile = Utils::extractTile(*input, Mask_RGB);
-    Utils::tileToNCHWTensor(tile, inputTensor, _imgWidth, _imgHeight, 3);
+    dirty = _tileCache.dirtyTiles(tensors, settingsHash,
+                                  mask ? &nearMask : nullptr);
+  } catch (const std::invalid_argument &e) {
+    throw PreprocessException(e.what());
+  }
+  size_t tileCount = _tileCache.tileCount();
+  span.arg("tiles", static_cast<int64_t>(tileCount));
+  span.arg("tiles_inferred", static_cast<int64_t>(dirty.size()));
+  span.arg("tiles_wanted", static_cast<int64_t>(_tileCache.activeCount()));
+
+  // Progressive tiles start at the centre of the region the viewer asked
+  // for; the first is inferred now, the others in the background
+  size_t inferNow = dirty.size();
+  uint64_t key = inferenceHash().value();
+  _tileJobKey = key;
+  _tilesRemaining = 0;
+  if (progressiveActive() && _progressiveTiles && dirty.size() > 1) {
+    double toPacked = _outputWidth > 0 ? double(width) / _outputWidth : 1.0;
+    _tileCache.orderFromCentre(
+        dirty, static_cast<int>(_interest.x() * toPacked),
+        static_cast<int>(_interest.y() * toPacked),
+        static_cast<int>(std::ceil(_interest.r() * toPacked)),
+        static_cast<int>(std::ceil(_interest.t() * toPacked)));
+    inferNow = 1;
+  }
+
+  // Infer each changed tile with its halo and keep its centre
+  ONNXModelManager::InferenceOutput tileOutput;
+  for (size_t n = 0; n < inferNow; n++) {
+    size_t index = dirty[n];
+    const DirtyTileCache::Tile &tile = _tileCache.tiles()[index];
+    Trace::Span tileSpan(Trace::kCategoryPipeline, "tile");
+    tileSpan.arg("tile", static_cast<int64_t>(index));
+    std::vector<InputTensorCache::TensorPtr> crops;
+    for (const InputTensorCache::TensorPtr &tensor : fullTensors) {
+      crops.push_back(std::make_shared<const std::vector<float>>(
+          _tileCache.crop(*tensor, tile)));
+    }
+    int tileWidth = 0, tileHeight = 0, tileChannels = 0;
+    inferTile(*_inferenceProcessor, tiledInputs, crops, tile, tileOutput,
+              tileWidth, tileHeight, tileChannels);
+    try {
+      _tileCache.paste(index, tileOutput.data(), tileChannels, tileWidth,
+                       tileHeight);
+    } catch (const std::invalid_argument &e) {
+      throw InferenceException(e.what());
+    }
+  }
+  Metrics::registry().tilesInferred.add(inferNow);
+  Metrics::registry().tilesSkipped.add(tileCount - dirty.size());
+
+  if (inferNow < dirty.size()) {
+    std::vector<size_t> remaining(dirty.begin() + inferNow, dirty.end());
+    _tilesRemaining = static_cast<int>(remaining.size());
+    scheduleTiles(key, remaining, tiledInputs, fullTensors);
+  }
+
+  // An empty mask infers nothing; the input passes through everywhere
+  const std::vector<std::vector<int64_t>> &outputDims =
+      _modelManager->getOutputDims();
+  _tileCache.ensureOutput(outputDims[0].size() >= 4 && outputDims[0][1] > 0
+                              ? static_cast<int>(outputDims[0][1])
+                              : _outputChannelCount);
+  if (mask && (_tileCache.outputWidth() != width ||
+               _tileCache.outputHeight() != height)) {
+    throw ConfigurationException("Only Inside Mask needs an output the size "
+                                 "of the input");
+  }
+
+  publishTiles(false);
+}
+
+void ONNXRuntimeOp::inferTile(
+    ONNXInferenceProcessor &processor, const std::vector<int> &tiledInputs,
+    const std::vector<InputTensorCache::TensorPtr> &crops,
+    const DirtyTileCache::Tile &tile,
+    ONNXModelManager::InferenceOutput &output, int &width, int &height,
+    int &channels) {
+  for (size_t i = 0; i < tiledInputs.size(); i++) {
+    std::vector<int64_t> shape = processor.getInputTensor(tiledInputs[i]).shape;
+    shape[2] = tile.regionHeight();
+    shape[3] = tile.regionWidth();
+    processor.setInputTensorData(tiledInputs[i], shape, crops[i]);
+  }
+  processor.runInference(output);
+  processor.getOutputDimensions(width, height, channels);
+}
+
+void ONNXRuntimeOp::scheduleTiles(
+    uint64_t key, const std::vector<size_t> &tiles,
+    const std::vector<int> &tiledInputs,
+    const std::vector<InputTensorCache::TensorPtr> &fullTensors) {
+  // A copy of the processor shares the parameter inputs; the image inputs
+  // are replaced by each tile's crop
+  ONNXInferenceProcessor processor = *_inferenceProcessor;
+  _refiner.schedule(key, [this, key, tiles, tiledInputs, fullTensors,
+                          processor](
+                             const std::function<bool()> &stale) mutable {
+    ONNXModelManager::InferenceOutput tileOutput;
+    for (size_t index : tiles) {
+      if (stale()) {
+        return;
+      }
+
+      // The layout is read under the lock, as the next frame may change it
+      DirtyTileCache::Tile tile;
+      std::vector<InputTensorCache::TensorPtr> crops;
+      {
+        Guard guard(_cacheLock);
+        if (_tileJobKey != key) {
+          return;
+        }
+        tile = _tileCache.tiles()[index];
+        for (const InputTensorCache::TensorPtr &tensor : fullTensors) {
+          crops.push_back(std::make_shared<const std::vector<float>>(
+              _tileCache.crop(*tensor, tile)));
+        }
+      }
+
+      int tileWidth = 0, tileHeight = 0, tileChannels = 0;
+      std::string failure;
+      try {
+        Trace::Span tileSpan(Trace::kCategoryPipeline, "background tile");
+        tileSpan.arg("tile", static_cast<int64_t>(index));
+        inferTile(processor, tiledInputs, crops, tile, tileOutput, tileWidth,
+                  tileHeight, tileChannels);
+      } catch (const std::exception &e) {
+        failure = e.what();
+      }
+
+      {
+        Guard guard(_cacheLock);
+        if (_tileJobKey != key) {
+          return;
+        }
+        if (failure.empty()) {
+          try {
+            _tileCache.paste(index, tileOutput.data(), tileChannels,
+                             tileWidth, tileHeight);
+          } catch (const std::invalid_argument &e) {
+            failure = e.what();
+          }
+        }
+        if (!failure.empty()) {
+          _tileError = failure;
+          _tilesRemaining = 0;
+        } else {
+          _tilesRemaining = std::max(0, _tilesRemaining - 1);
+          _pastedTiles.push_back(index);
+          Metrics::registry().tilesInferred.add(1);
+        }
+        _tilesUnpublished = true;
+      }
+
+      // Redraw with the tile; engine() picks it up once reopened. A newer
+      // job or the op going away makes the tile stale: whoever replaced the
+      // job redraws instead.
+      if (stale()) {
+        return;
+      }
+      _refinements++;
+      asapUpdate();
+      if (!failure.empty()) {
+        return;
+      }
+    }
+  });
+}
+
+void ONNXRuntimeOp::publishTiles(bool landed) {
+  // While background tiles land, only theirs are copied into the output
+  // already published; the statistics wait for the last one
+  const std::vector<float> &assembled = _tileCache.output();
+  bool published = landed && _output.size() == assembled.size() &&
+                   _outputWidth == _tileCache.outputWidth() &&
+                   _outputHeight == _tileCache.outputHeight() &&
+                   _outputChannelCount == _tileCache.outputChannels();
+  if (published && _tilesRemaining > 0) {
+    for (size_t index : _pastedTiles) {
+      _tileCache.copyTile(index, _output.data());
+    }
+    _pastedTiles.clear();
+    _shownTiles = _tileCache.readyTiles();
+    _tilesUnpublished = false;
+    return;
+  }
+  _pastedTiles.clear();
+
+  // The engine reads a copy of the assembled output; NaN and Inf are
+  // replaced and the statistics gathered while copying
+  _outputWidth = _tileCache.outputWidth();
+  _outputHeight = _tileCache.outputHeight();
+  _outputChannelCount = _tileCache.outputChannels();
+  _isSingleChannel = _outputChannelCount == 1;
+  TensorProcessor::copyOutput(
+      assembled.data(), _output.allocate(assembled.size()), assembled.size(),
+      {1, _outputChannelCount, _outputHeight, _outputWidth},
+      &_outputStatistics);
+
+  // The input passes through where tiles are not shown, when it lines up
+  // with the output
+  _shownTiles = _tileCache.readyTiles();
+  _allTilesShown =
+      std::find(_shownTiles.begin(), _shownTiles.end(), false) ==
+          _shownTiles.end() ||
+      _outputWidth != _tileCache.width() ||
+      _outputHeight != _tileCache.height();
+  _tilesUnpublished = false;
+}
+
+int ONNXRuntimeOp::currentFrame() const {
+  return static_cast<int>(std::lround(outputContext().frame()));
+}
+
+uint64_t ONNXRuntimeOp::inputsHashAt(int frame) const {
+  // The inputs as Nuke would build them at that frame, so a checkpoint is
+  // checked against its own frame's upstream rather than the current one's
+  Hash hash;
+  int imageInputCount =
+      std::min(_activeInputs, static_cast<int>(_imageInputs.size()));
+  for (int i = 0; i < imageInputCount; i++) {
+    if (input(i) == nullptr) {
+      continue;
+    }
+    OutputContext context = outputContext();
+    context.setFrame(frame);
+    const Op *upstream = node_input(i, Op::EXECUTABLE_INPUT, &context);
+    hash.append(upstream ? upstream->hash().value() : 0);
+  }
+  return hash.value();
+}
+
+void ONNXRuntimeOp::loadNormalizationStats() {
+  _loadedStatsFile = _normalizeStatsFile ? _normalizeStatsFile : "";
+  if (_loadedStatsFile.empty()) {
+    return;
+  }
+
+  // A stats file that does not exist yet is written by Save Stats later
+  std::ifstream probe(_loadedStatsFile);
+  if (!probe) {
+    return;
+  }
+  try {
+    _normalizationIndex.load(_loadedStatsFile);
+  } catch (const ONNXPluginError &e) {
+    error("%s", e.what());
+  }
+}
+
+InputTensorCache::TensorPtr
+ONNXRuntimeOp::packTile(const Tile &tile, const InputTensorCache::Key &key) {
+  try {
+    // Nodes fed by the same upstream with the same packing settings share
+    // one read-only tensor
+    std::vector<float> inputTensor;
+    Utils::tileToNCHWTensor(tile, inputTensor, key.width, key.height,
+                            key.channels);
+    Metrics::registry().bytesAllocated.add(inputTensor.size() *
+                                           sizeof(float));
+    return InputTensorCache::instance().insert(key, std::move(inputTensor));
   } catch (const ONNXPluginError &e) {
     // Rethrow specific plugin errors
     throw;
@@ -303,26 +1430,121 @@ void ONNXRuntimeOp::preprocessImage(const Iop *input,
 }
 
 void ONNXRuntimeOp::findMinMaxValues() {
-  if (_processedData.empty()) {
+  _channelRanges.clear();
+  if (_output.empty()) {
     _minValue = 0.0f;
     _maxValue = 1.0f;
     return;
   }
 
-  // Use TensorProcessor to find min/max values
-  if (_isSingleChannel) {
-    // For single channel, just find min/max of the whole data
-    TensorProcessor::findMinMax(_processedData, _minValue, _maxValue);
+  // The ranges were gathered when the output was produced; rescan it in
+  // place, as planes of the output size, if they do not describe it
+  const TensorProcessor::OutputStatistics &stats = _outputStatistics;
+  size_t planeSize = static_cast<size_t>(_outputWidth) * _outputHeight;
+  if (stats.elementCount != _output.size() || stats.planeSize != planeSize ||
+      stats.channels.size() < static_cast<size_t>(_outputChannelCount)) {
+    TensorProcessor::copyOutput(
+        _output.data(), _output.data(), _output.size(),
+        {_outputChannelCount, _outputHeight, _outputWidth}, &_outputStatistics);
+  }
+
+  // Sequence and window ranges, and percentile clipping, come from the
+  // statistics index, which already holds this frame
+  auto rangeMode =
+      static_cast<NormalizationIndex::RangeMode>(_normalizeRange);
+  int frame = currentFrame();
+  double low = std::max(0.0f, std::min(100.0f, _normalizeLow)) / 100.0;
+  double high = std::max(0.0f, std::min(100.0f, _normalizeHigh)) / 100.0;
+  bool useIndex = _normalizationIndex.contains(frame) &&
+                  (rangeMode != NormalizationIndex::kRangeFrame || low > 0.0 ||
+                   high < 1.0);
+
+  // Per-channel and per-layer ranges are applied per channel in engine()
+  if (_normalizeMode != TensorProcessor::kNormalizeGlobal) {
+    auto mode = static_cast<TensorProcessor::NormalizeMode>(_normalizeMode);
+    const char *layers = _normalizeLayers ? _normalizeLayers : "";
+    if (useIndex) {
+      _channelRanges = TensorProcessor::normalizationRanges(
+          _normalizationIndex.channelRanges(frame, rangeMode, _normalizeWindow),
+          _outputChannelCount, mode, layers);
+    } else {
+      _channelRanges = TensorProcessor::normalizationRanges(
+          stats.channels, _outputChannelCount, mode, layers);
+    }
+  }
+
+  if (useIndex && _normalizationIndex.range(frame, rangeMode, _normalizeWindow,
+                                            low, high, _minValue, _maxValue)) {
+    // Same fallback as findMinMaxMultiChannel for flat ranges
+    if (!(_minValue < _maxValue)) {
+      _maxValue = _minValue + 1.0f;
+    }
+  } else {
+    TensorProcessor::findMinMax(stats, 0, _outputChannelCount,
+                                _isSingleChannel, _minValue, _maxValue);
+  }
+}
+
+void ONNXRuntimeOp::resetModelState() {
+  _refiner.cancel(); // It may be running the old model
+  Guard guard(_cacheLock);
+  if (_modelManager->isLoaded()) {
+    _modelChanged = true; // Engines may be reading the old output
   } else {
-    // For multi-channel, use multichannel min/max function
-    TensorProcessor::findMinMaxMultiChannel(_processedData, _minValue,
-                                            _maxValue, _outputChannelCount,
-                                            _outputWidth, _outputHeight);
+    dropModelBuffers(); // Nothing reads the output without a model
   }
 }
 
+void ONNXRuntimeOp::dropModelBuffers() {
+  _tileJobKey = 0;
+  _tilesRemaining = 0;
+  _governor.reset(); // The new model costs something else
+  _output.reset();
+  _packedInputs.clear();
+  _temporalBuffers.clear();
+  _recurrentState.clear();
+  _tileCache.clear();
+
+  // Statistics of another model's output do not apply; the stats file is
+  // merged in again, as _validate already did that for this frame
+  _normalizationIndex.clear();
+  loadNormalizationStats();
+}
+
+void ONNXRuntimeOp::loadSession(ONNXModelManager &session, const char *path) {
+  // Share one copy of the model through the local daemon when enabled;
+  // the manager falls back to in-process inference if it is not running
+  session.setDaemonSocketPath(
+      _useDaemon ? InferenceDaemon::defaultSocketPath() : std::string());
+  session.load(path, _useGPU); // Throws ModelLoadException on failure
+
+  // Check if model has at least one input
+  if (session.getInputCount() <= 0) {
+    session.unload(); // Unload the invalid model
+    throw ModelLoadException("Invalid model: No inputs found");
+  }
+}
+
+bool ONNXRuntimeOp::viewerShortcuts() const {
+  // The NDK does not say whether rows go to the viewer or to a Write
+  // rendered in the GUI, so the user vouches for it; renders without a GUI
+  // always get the final result
+  return _viewerShortcuts && Application::gui;
+}
+
+bool ONNXRuntimeOp::interactiveWanted() const {
+  // Renders never load it, so their output always comes from Model Path
+  return viewerShortcuts() && _interactiveModelPath &&
+         strlen(_interactiveModelPath) > 0;
+}
+
 void ONNXRuntimeOp::loadModel() {
-  _processedData.clear();
+  resetModelState();
+  {
+    Guard guard(_cacheLock);
+    _modelManager = _renderModel.get(); // Until the sessions are loaded
+    _inferenceProcessor->setModelManager(_modelManager);
+  }
 
   // Model path validation
   if (_modelPath == nullptr || strlen(_modelPath) == 0) {
@@ -331,38 +1553,7 @@ void ONNXRuntimeOp::loadModel() {
 
   // Load the model with the current settings
   try {
-    _modelManager->load(_modelPath,
-                        _useGPU); // Throws ModelLoadException on failure
-
-    // Check if model has at least one input
-    if (_modelManager->getInputCount() <= 0) {
-      _modelManager->unload(); // Unload the invalid model
-      throw ModelLoadException("Invalid model: No inputs found");
-    }
-
-    // Extract information about channels
-    int channels;
-    if (_modelManager->getOutputDimensions(_outputWidth, _outputHeight,
-                                           channels)) {
-      _outputChannelCount = channels;
-      _isSingleChannel = (channels == 1);
-    } else {
-      warning("Could not retrieve fixed output dimensions from model. Output "
-              "size might adapt to input.");
-      // Assume output dimensions match input initially if not specified
-      _outputWidth = _imgWidth > 0 ? _imgWidth : 0;
-      _outputHeight = _imgHeight > 0 ? _imgHeight : 0;
-      _outputChannelCount = 1; // Default guess
-      _isSingleChannel = true;
-    }
-
-    updateActiveInputs();
-
-    // printf("ONNX Model Inputs: %d (active: %d)\n",
-    //     _modelManager->getInputCount(), _activeInputs);
-
-    _cacheValid = false;
-    _processingDone = false;
+    loadSession(*_renderModel, _modelPath);
   } catch (const ONNXPluginError &e) {
     error("Failed to load model: %s",
           e.what()); // Use error() for user feedback
@@ -372,6 +1563,93 @@ void ONNXRuntimeOp::loadModel() {
     throw ModelLoadException(std::string("Unexpected: ") +
                              e.what()); // Wrap and re-throw
   }
+  loadInteractiveModel();
+}
+
+void ONNXRuntimeOp::loadInteractiveModel() {
+  if (!_renderModel->isLoaded()) {
+    return; // Loaded along with Model Path
+  }
+
+  // New work uses Model Path, so once the refiner has stopped nothing runs
+  // the interactive session while it is replaced. Renders have none.
+  if (_interactiveModel->isLoaded() || interactiveWanted()) {
+    {
+      Guard guard(_cacheLock);
+      _modelManager = _renderModel.get();
+      _inferenceProcessor->setModelManager(_modelManager);
+      _modelChanged = true;
+      _cacheValid = false;
+      _processingDone = false;
+    }
+    _refiner.cancel();
+  }
+
+  std::string failure;
+  if (interactiveWanted()) {
+    try {
+      loadSession(*_interactiveModel, _interactiveModelPath);
+
+      // Renders swap in the other model, so it must fit the same node
+      int width, height, channels, renderChannels;
+      bool fixed =
+          _interactiveModel->getOutputDimensions(width, height, channels) &&
+          _renderModel->getOutputDimensions(width, height, renderChannels);
+      if (_interactiveModel->getInputCount() !=
+              _renderModel->getInputCount() ||
+          _interactiveModel->getImageInputs() !=
+              _renderModel->getImageInputs() ||
+          (fixed && channels != renderChannels)) {
+        _interactiveModel->unload();
+        throw ModelLoadException("Interactive model does not take the same "
+                                 "inputs and give the same channels as "
+                                 "Model Path");
+      }
+    } catch (const std::exception &e) {
+      failure = e.what();
+    }
+  } else {
+    _interactiveModel->unload();
+  }
+
+  // Model Path stays in use if the interactive model failed to load
+  {
+    Guard guard(_cacheLock);
+    selectModel();
+  }
+  if (!failure.empty()) {
+    error("Failed to load interactive model: %s", failure.c_str());
+    throw ModelLoadException(failure);
+  }
+}
+
+void ONNXRuntimeOp::selectModel() {
+  _modelManager = _useInteractiveModel && _interactiveModel->isLoaded()
+                      ? _interactiveModel.get()
+                      : _renderModel.get();
+  _inferenceProcessor->setModelManager(_modelManager);
+
+  // Extract information about channels
+  int channels;
+  if (_modelManager->getOutputDimensions(_outputWidth, _outputHeight,
+                                         channels)) {
+    _outputChannelCount = channels;
+    _isSingleChannel = (channels == 1);
+  } else {
+    warning("Could not retrieve fixed output dimensions from model. Output "
+            "size might adapt to input.");
+    // Assume output dimensions match input initially if not specified
+    _outputWidth = _imgWidth > 0 ? _imgWidth : 0;
+    _outputHeight = _imgHeight > 0 ? _imgHeight : 0;
+    _outputChannelCount = 1; // Default guess
+    _isSingleChannel = true;
+  }
+
+  updateActiveInputs();
+
+  _dimensionsSet = false;
+  _cacheValid = false;
+  _processingDone = false;
 }
 
 void ONNXRuntimeOp::updateDimensions() {
@@ -435,15 +1713,108 @@ void ONNXRuntimeOp::updateDimensions() {
 }
 
 void ONNXRuntimeOp::displayModelInfo() {
+  // Nuke inputs are the model's image inputs
+  std::vector<std::string> imageInputNames;
+  for (int index : _imageInputs) {
+    imageInputNames.push_back(_modelManager->getInputNames()[index]);
+  }
+
   // Build the info string using the utility function
   std::string infoStr = Utils::buildModelInfoString(
       _modelManager->getInfoString(), _useGPU, _isSingleChannel,
       _outputChannelCount, _imgWidth, _imgHeight, _outputWidth, _outputHeight,
-      _activeInputs, _modelManager->getInputCount(),
-      _modelManager->getInputNames(),
+      _activeInputs, static_cast<int>(_imageInputs.size()), imageInputNames,
       [this](int idx) { return input(idx) != nullptr; }, _normalize, _minValue,
       _maxValue, &DD::Image::getName);
 
+  if (_interactiveModel->isLoaded()) {
+    infoStr += std::string("Interactive model: ") + _interactiveModelPath +
+               (_modelManager == _interactiveModel.get()
+                    ? " (in use; renders use Model Path)\n"
+                    : " (loaded, not in use)\n");
+  }
+
+  const auto &modelInputNames = _modelManager->getInputNames();
+  if (!_parameterInputs.empty()) {
+    std::stringstream parameters;
+    parameters << "Parameter inputs:\n";
+    for (size_t p = 0; p < _parameterInputs.size(); p++) {
+      parameters << "  Parameter " << p + 1 << ": "
+                 << modelInputNames[_parameterInputs[p]];
+      if (p < static_cast<size_t>(kParameterKnobs)) {
+        parameters << " = "
+                   << (_parameterValues[p] && *_parameterValues[p]
+                           ? _parameterValues[p]
+                           : "0");
+      } else {
+        parameters << " (no knob)";
+      }
+      parameters << "\n";
+    }
+    infoStr += parameters.str();
+  }
+
+  if (!_stateInputs.empty()) {
+    std::stringstream state;
+    state << "Recurrent state inputs:";
+    for (int index : _stateInputs) {
+      state << " " << modelInputNames[index];
+    }
+    state << " (" << _recurrentState.size() << " frames kept)\n";
+    infoStr += state.str();
+  }
+
+  if ((_tiledInference || _maskedInference) && _tileCache.tileCount() > 0) {
+    size_t skipped = _tileCache.tileCount() - _tileCache.inferredCount();
+    infoStr += "Tiled inference: " +
+               std::to_string(_tileCache.inferredCount()) + " of " +
+               std::to_string(_tileCache.tileCount()) +
+               " tiles inferred on the last frame, " +
+               std::to_string(skipped) + " skipped";
+    if (_maskedInference) {
+      infoStr += ", " + std::to_string(_tileCache.activeCount()) +
+                 " near the mask";
+    }
+    infoStr += "\n";
+  }
+
+  if (_governor.playedFrames() > 0) {
+    std::stringstream playback;
+    playback << "Playback: " << _governor.missedDeadlines() << " of "
+             << _governor.playedFrames() << " played frames missed the "
+             << _playbackFps << " fps target\n";
+    infoStr += playback.str();
+  }
+
+  if (_normalize && !_channelRanges.empty()) {
+    std::stringstream ranges;
+    ranges << "Normalization mode: " << NORMALIZE_MODES[_normalizeMode]
+           << "\n";
+    for (size_t c = 0; c < _channelRanges.size(); c++) {
+      ranges << "  Channel " << c << ": min=" << _channelRanges[c].min
+             << ", max=" << _channelRanges[c].max << "\n";
+    }
+    infoStr += ranges.str();
+  }
+
+  if (_normalizationIndex.size() > 0) {
+    infoStr += "Normalization stats: " +
+               std::to_string(_normalizationIndex.size()) +
+               " frames indexed\n";
+  }
+
+  const TensorProcessor::OutputStatistics &stats = _outputStatistics;
+  if (stats.elementCount > 0) {
+    std::stringstream summary;
+    summary << "Output mean: " << stats.mean
+            << ", median: " << stats.percentile(0.5) << "\n";
+    if (stats.replacedCount > 0) {
+      summary << "NaN/Inf values replaced with 0: " << stats.replacedCount
+              << "\n";
+    }
+    infoStr += summary.str();
+  }
+
   // Display the message using the simplified utility function (prints to
   // stderr)
   Utils::displayNukeMessage(infoStr);
@@ -453,12 +1824,181 @@ void ONNXRuntimeOp::knobs(Knob_Callback f) {
   File_knob(f, &_modelPath, "model_path", "Model Path");
   Tooltip(f, "Path to ONNX model file");
 
+  File_knob(f, &_interactiveModelPath, "interactive_model_path",
+            "Interactive Model");
+  Tooltip(f, "Optional lighter version of the model, e.g. quantized or "
+             "distilled, used in the viewer while Viewer Shortcuts is on. "
+             "It must take the same inputs and give the same channels. "
+             "Renders (nuke -x, Write nodes on the farm) never load it and "
+             "always use Model Path.");
+
+  Bool_knob(f, &_useInteractiveModel, "use_interactive_model",
+            "Use In Viewer");
+  Tooltip(f, "Use the interactive model in the viewer. Both models stay "
+             "loaded, so turning this off shows the full model without "
+             "loading anything.");
+
+  Bool_knob(f, &_viewerShortcuts, "viewer_shortcuts", "Viewer Shortcuts");
+  Tooltip(f, "Let the viewer use the Interactive Model, show Progressive "
+             "previews and tiles, and lower the scale to keep up with "
+             "Playback FPS. Nuke does not tell the node whether it renders "
+             "for the viewer or for a Write rendered in the GUI, so while "
+             "this is off every request gets the full-resolution result of "
+             "Model Path. Turn it off before rendering from the GUI; "
+             "command-line and farm renders always get the final result.");
+
   // Bool_knob(f, &_useGPU, "use_gpu", "Use GPU");
   // Tooltip(f, "Use GPU for inference if available");
 
   Bool_knob(f, &_normalize, "normalize", "Normalize Output");
   Tooltip(f, "Normalize output values to range 0-1");
 
+  Enumeration_knob(f, &_normalizeMode, NORMALIZE_MODES, "normalize_mode",
+                   "Normalize Mode");
+  Tooltip(f, "global: one range for all output channels\n"
+             "per channel: each output channel is scaled to 0-1 on its own "
+             "(e.g. normal maps)\n"
+             "per layer: channels are grouped by Layer Sizes and each group "
+             "shares one range (e.g. multi-task outputs)");
+
+  String_knob(f, &_normalizeLayers, "normalize_layers", "Layer Sizes");
+  Tooltip(f, "Output channels per layer for per-layer normalization, in "
+             "output channel order, e.g. \"3 1\" for normals followed by "
+             "depth. Remaining channels form one more layer.");
+
+  Enumeration_knob(f, &_normalizeRange, NORMALIZE_RANGES, "normalize_range",
+                   "Normalize Range");
+  Tooltip(f, "per frame: each frame uses its own range (may flicker)\n"
+             "sequence: one range from every frame inferred so far or "
+             "loaded from the stats file\n"
+             "sliding window: range of the known frames within Window "
+             "frames of the current one\n"
+             "Frame statistics are kept as frames are inferred, so other "
+             "frames are never inferred again to find the range.");
+
+  Int_knob(f, &_normalizeWindow, "normalize_window", "Window");
+  Tooltip(f, "Frames either side of the current frame for the sliding "
+             "window range");
+
+  Float_knob(f, &_normalizeLow, "normalize_low", "Low Percentile");
+  SetRange(f, 0, 100);
+  Tooltip(f, "Percentile mapped to 0. 0 uses the minimum; raise it to "
+             "ignore outliers. Global mode only.");
+
+  Float_knob(f, &_normalizeHigh, "normalize_high", "High Percentile");
+  SetRange(f, 0, 100);
+  Tooltip(f, "Percentile mapped to 1. 100 uses the maximum; lower it to "
+             "ignore outliers. Global mode only.");
+
+  File_knob(f, &_normalizeStatsFile, "normalize_stats_file", "Stats File");
+  Tooltip(f, "Per-frame output statistics to load, e.g. written by "
+             "onnx_batch --stats-file or by Save Stats after a render, so "
+             "sequence ranges are known before every frame is inferred");
+
+  Button(f, "save_normalize_stats", "Save Stats");
+  Tooltip(f, "Write the statistics of every frame inferred so far to the "
+             "stats file");
+
+  Button(f, "clear_normalize_stats", "Clear Stats");
+  Tooltip(f, "Forget the statistics of every frame inferred or loaded");
+
+  Bool_knob(f, &_useDaemon, "use_inference_daemon", "Use Inference Daemon");
+  Tooltip(f, "Run the model in the local onnx_inference_daemon so Nuke "
+             "sessions on this machine share one loaded copy. Falls back to "
+             "in-process inference when the daemon is not running. Not "
+             "available to models with state bindings.");
+
+  Int_knob(f, &_temporalFrames, "temporal_frames", "Temporal Frames");
+  Tooltip(f, "Frames in the window of video model inputs (NCTHW) whose time "
+             "axis is dynamic; a fixed time axis sets the window itself. "
+             "Odd windows are centred on the current frame. Packed frames "
+             "are kept, so stepping one frame packs only the new one.");
+
+  String_knob(f, &_stateBindings, "state_bindings", "State Bindings");
+  Tooltip(f, "Recurrent state of video models: outputs fed back to inputs "
+             "on the next frame, as output:input pairs (e.g. \"r1o:r1i "
+             "r2o:r2i\"). The first frame starts from zeros. The state of "
+             "each frame is kept, so scrubbing resumes from the nearest "
+             "earlier frame instead of the start of the shot.");
+
+  Int_knob(f, &_stateReach, "state_reach", "Resume Within");
+  Tooltip(f, "How many frames back the kept state may come from. When the "
+             "nearest earlier frame with state is farther away, the frame "
+             "starts from zeros.");
+
+  Button(f, "clear_state", "Clear State");
+  Tooltip(f, "Forget the recurrent state of every frame");
+
+  Bool_knob(f, &_tiledInference, "tiled_inference", "Incremental Tiles");
+  Tooltip(f, "Infer the image in tiles and keep the output, so the next "
+             "frame only infers the tiles whose inputs changed within the "
+             "halo around them, e.g. on locked-off shots and paint fixes. "
+             "For models with a receptive field no wider than the halo.");
+
+  Bool_knob(f, &_maskedInference, "masked_inference", "Only Inside Mask");
+  Tooltip(f, "Add a mask input after the image inputs and infer only the "
+             "tiles within Tile Halo of its non-zero alpha; the image input "
+             "passes through everywhere else, so the cost follows the masked "
+             "area. With no mask connected the whole image is inferred.");
+
+  Int_knob(f, &_tileSize, "tile_size", "Tile Size");
+  Tooltip(f, "Width and height of the tiles, in model input pixels");
+
+  Int_knob(f, &_tileHalo, "tile_halo", "Tile Halo");
+  Tooltip(f, "Pixels of context inferred around each tile; at least the "
+             "model's receptive field radius. A change within the halo "
+             "also infers the tile again.");
+
+  Bool_knob(f, &_tightBBox, "tight_bbox", "Tight BBox");
+  Tooltip(f, "Shrink the bbox to where the output exceeds BBox Threshold, "
+             "e.g. around a matte, so Merge and Blur nodes below only "
+             "process that region. The bbox is only known once the frame "
+             "has been inferred: the viewer shrinks it then, while renders "
+             "keep the full bbox.");
+
+  Bool_knob(f, &_progressive, "progressive", "Progressive");
+  Tooltip(f, "Show a quick result inferred at Preview Scale first, then "
+             "infer the full resolution in the background and swap it in "
+             "when it is done. For models with a dynamic input size. Only "
+             "while Viewer Shortcuts is on; otherwise, and in renders, the "
+             "full resolution is inferred before any row is returned.");
+
+  Float_knob(f, &_previewScale, "preview_scale", "Preview Scale");
+  SetRange(f, 0.05, 1);
+  Tooltip(f, "Size of the preview inference, as a fraction of the input");
+
+  Float_knob(f, &_playbackFps, "playback_fps", "Playback FPS");
+  SetRange(f, 0, 60);
+  Tooltip(f, "While frames are played back, infer at the largest scale "
+             "that keeps up with this frame rate, measured from the recent "
+             "inference times, instead of stuttering. The frame playback "
+             "stops on is inferred at full resolution. 0 turns this off. "
+             "Only while Viewer Shortcuts is on; otherwise, and in renders, "
+             "every frame is inferred at full resolution. Print Model Info "
+             "reports the frames that missed the rate.");
+
+  Bool_knob(f, &_progressiveTiles, "progressive_tiles", "Centre-Out Tiles");
+  Tooltip(f, "With Progressive on, infer the frame in tiles of Tile Size "
+             "instead of a preview: the tiles in view first, spiralling out "
+             "from the middle of the view, each shown as soon as it is "
+             "done. The input shows through the tiles not done yet.");
+
+  Float_knob(f, &_bboxThreshold, "bbox_threshold", "BBox Threshold");
+  SetRange(f, 0, 1);
+  Tooltip(f, "Output values at or below this (in magnitude, or after "
+             "normalization when normalizing) are left outside the bbox");
+
+  Divider(f);
+
+  for (int i = 0; i < kParameterKnobs; i++) {
+    String_knob(f, &_parameterValues[i], PARAMETER_KNOBS[i],
+                PARAMETER_LABELS[i]);
+    Tooltip(f, "Values for the model's non-image inputs, in model input "
+               "order (e.g. strength, timestep or class id): whitespace or "
+               "comma separated numbers, repeated to fill the input. Print "
+               "Model Info lists which input each parameter sets.");
+  }
+
   Divider(f);
 
   Button(f, "reload_model", "Reload Model");
@@ -476,6 +2016,22 @@ int ONNXRuntimeOp::knob_changed(Knob *k) {
     _processingDone = false; // Reset processing state
     asapUpdate();            // Request immediate UI refresh
     return 1;
+  } else if (k->name() == "interactive_model_path" ||
+             k->name() == "viewer_shortcuts") {
+    // Model Path stays loaded; only the viewer's session changes
+    loadInteractiveModel();
+    asapUpdate();
+    return 1;
+  } else if (k->name() == "use_interactive_model") {
+    // Both sessions are loaded, so switching loads nothing. The buffers of
+    // the old model are dropped once the node is opened again.
+    {
+      Guard guard(_cacheLock);
+      _modelChanged = true;
+      selectModel();
+    }
+    asapUpdate();
+    return 1;
   } else if (k->name() == "reload_model") {
     loadModel();
     _dimensionsSet = false;  // Reset dimensions flag on model reload
@@ -483,6 +2039,15 @@ int ONNXRuntimeOp::knob_changed(Knob *k) {
     _processingDone = false; // Reset processing state
     asapUpdate();            // Request immediate UI refresh
     return 1;
+  } else if (k->name() == "use_inference_daemon") {
+    // Reload model in or out of the daemon
+    if (strcmp(_modelPath, "") != 0) {
+      loadModel();
+    }
+    _dimensionsSet = false;  // Reset dimensions flag on daemon setting change
+    _cacheValid = false;     // Invalidate cache
+    _processingDone = false; // Reset processing state
+    return 1;
   } else if (k->name() == "use_gpu") {
     // Reload model with new setting
     loadModel();
@@ -490,8 +2055,74 @@ int ONNXRuntimeOp::knob_changed(Knob *k) {
     _cacheValid = false;     // Invalidate cache
     _processingDone = false; // Reset processing state
     return 1;
-  } else if (k->name() == "normalize") {
-    // Invalidate cache to reprocess with normalization
+  } else if (k->name() == "normalize" || k->name() == "normalize_mode" ||
+             k->name() == "normalize_layers" ||
+             k->name() == "normalize_range" ||
+             k->name() == "normalize_window" || k->name() == "normalize_low" ||
+             k->name() == "normalize_high") {
+    // Normalization is applied to the kept output; the model is not run
+    _postProcessValid = false;
+    return 1;
+  } else if (k->name() == "temporal_frames") {
+    // The inputs are split again for the new window
+    _cacheValid = false;
+    return 1;
+  } else if (k->name().compare(0, 10, "parameter_") == 0) {
+    // New parameter values need a new inference, and the state the old
+    // values produced no longer applies
+    Guard guard(_cacheLock);
+    _recurrentState.clear();
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "state_bindings") {
+    // State inputs stop being Nuke inputs or parameters, and back
+    Guard guard(_cacheLock);
+    _recurrentState.clear();
+    updateActiveInputs();
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "tiled_inference" || k->name() == "tile_size" ||
+             k->name() == "tile_halo") {
+    // A new layout infers every tile again
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "progressive_tiles") {
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "masked_inference") {
+    // The mask input appears or goes away
+    _cacheValid = false;
+    asapUpdate();
+    return 1;
+  } else if (k->name() == "state_reach") {
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "clear_state") {
+    Guard guard(_cacheLock);
+    _recurrentState.clear();
+    _cacheValid = false;
+    return 1;
+  } else if (k->name() == "normalize_stats_file") {
+    Guard guard(_cacheLock);
+    loadNormalizationStats();
+    _postProcessValid = false;
+    return 1;
+  } else if (k->name() == "save_normalize_stats") {
+    Guard guard(_cacheLock);
+    if (!_normalizeStatsFile || strlen(_normalizeStatsFile) == 0) {
+      error("Set Stats File before saving statistics");
+      return 1;
+    }
+    try {
+      _normalizationIndex.save(_normalizeStatsFile);
+      _loadedStatsFile = _normalizeStatsFile;
+    } catch (const ONNXPluginError &e) {
+      error("%s", e.what());
+    }
+    return 1;
+  } else if (k->name() == "clear_normalize_stats") {
+    Guard guard(_cacheLock);
+    _normalizationIndex.clear();
     _cacheValid = false;
     return 1;
   } else if (k->name() == "show_model_info") {
@@ -4,14 +4,24 @@
 #include "DDImage/Knobs.h"
 #include "DDImage/Row.h"
 #include "DDImage/Thread.h"
+#include "DDImage/Tile.h"
+#include "DirtyTileCache.h"
+#include "InputTensorCache.h"
 #include "ONNXInferenceProcessor.h"
+#include "NormalizationIndex.h"
 #include "ONNXModelManager.h"
+#include "PlaybackGovernor.h"
+#include "ProgressiveRefiner.h"
+#include "RecurrentStateStore.h"
+#include "TemporalFrameBuffer.h"
 #include "TensorProcessor.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -37,23 +47,66 @@ public:
   const char *node_help() const override;
   static const DD::Image::Iop::Description description;
   std::string input_longlabel(int input) const override;
+  const char *input_label(int input, char *buffer) const override;
   void _open() override;
+  void append(DD::Image::Hash &hash) override;
+
+  // Temporal inputs are split into one input per frame of their window
+  int split_input(int input) const override;
+  const DD::Image::OutputContext &
+  inputContext(int input, int split,
+               DD::Image::OutputContext &context) const override;
 
   // Multi-input support
   int minimum_inputs() const override { return 1; }
   int maximum_inputs() const override { return 10; }
 
+  // Model inputs that are not images are set from this many knobs
+  static const int kParameterKnobs = 4;
+
 private:
   // ONNX model configuration
   const char *_modelPath; // Path to the ONNX model file
+  const char *_interactiveModelPath; // Lighter model used in the viewer
+  bool _useInteractiveModel;         // Whether the viewer uses it
+  bool _viewerShortcuts; // Whether GUI requests may get non-final results
   bool _useGPU;           // Whether to use GPU acceleration
   bool _normalize;        // Whether to normalize output values to [0,1]
+  int _normalizeMode;     // TensorProcessor::NormalizeMode
+  const char *_normalizeLayers; // Channels per layer for per-layer mode
+  int _normalizeRange;          // NormalizationIndex::RangeMode
+  int _normalizeWindow;         // Frames either side for the sliding window
+  float _normalizeLow;          // Lower percentile of the range (0-100)
+  float _normalizeHigh;         // Upper percentile of the range (0-100)
+  const char *_normalizeStatsFile; // Saved per-frame statistics
+  const char *_parameterValues[kParameterKnobs]; // Parameter input values
+  int _temporalFrames; // Window of temporal inputs with a dynamic time axis
+  const char *_stateBindings; // Recurrent outputs fed back as "out:in"
+  int _stateReach; // Frames back a state checkpoint is resumed from
+  bool _tiledInference; // Whether only changed tiles are inferred again
+  int _tileSize;        // Tile width and height, in packed input pixels
+  int _tileHalo;        // Context inferred around each tile
+  bool _maskedInference; // Whether only tiles near the mask are inferred
+  bool _tightBBox;       // Whether the bbox is shrunk to the output content
+  float _bboxThreshold;  // Output values at or below this are not content
+  bool _progressive;     // Whether a low resolution preview is shown first
+  float _previewScale;   // Size of the preview inference, 0-1
+  bool _progressiveTiles; // Whether tiles are shown as they are inferred
+  float _playbackFps;     // Frame rate playback keeps up with; 0 is off
+  bool _useDaemon;        // Whether to run models in the shared local daemon
 
   // Output configuration
   bool _isSingleChannel;   // Whether output is single-channel (like depth)
   int _outputChannelCount; // Number of channels in the model output
   float _minValue;         // Minimum value for normalization
   float _maxValue;         // Maximum value for normalization
+  std::vector<TensorProcessor::NormalizationRange>
+      _channelRanges; // Per-channel ranges (empty in global mode)
+  TensorProcessor::OutputStatistics
+      _outputStatistics; // Collected while scanning the output
+  NormalizationIndex
+      _normalizationIndex;       // Statistics of every inferred frame
+  std::string _loadedStatsFile; // Stats file merged into the index
 
   // Dimensions and format tracking
   DD::Image::FormatPair _formats; // Nuke format information
@@ -62,27 +115,99 @@ private:
   int _outputWidth, _outputHeight;         // Output dimensions
 
   // Processing state
+  std::unique_ptr<ONNXModelManager> _renderModel; // Model Path session
   std::unique_ptr<ONNXModelManager>
-      _modelManager; // Manages ONNX model and inference
+      _interactiveModel; // Interactive Model session, GUI only
+  ONNXModelManager *_modelManager; // Session in use, one of the two
   std::unique_ptr<ONNXInferenceProcessor>
       _inferenceProcessor;           // Handles inference workflow
-  DD::Image::Lock _cacheLock;        // Thread safety for caching
-  bool _cacheValid;                  // Whether cached data is valid
-  bool _processingDone;              // Whether processing is complete
-  std::vector<float> _processedData; // Processed tensor data
+  DD::Image::Lock _cacheLock; // Thread safety for caching
+  bool _cacheValid;           // Whether cached data is valid
+  bool _processingDone;       // Whether processing is complete
+  bool _postProcessValid;     // Whether the normalization ranges are current
+  DD::Image::Hash _inferenceHash; // Inputs and knobs the output came from
+  ONNXModelManager::InferenceOutput
+      _output; // Model output, read by engine() where it was produced
 
   // Multi-input support
   int _activeInputs; // Number of active inputs
+  std::vector<int> _imageInputs;     // Model input of each Nuke input
+  std::vector<int> _parameterInputs; // Model input of each parameter knob
+  std::map<int, std::pair<InputTensorCache::Key, InputTensorCache::TensorPtr>>
+      _packedInputs; // Last tensor packed for each model input
+  std::map<int, TemporalFrameBuffer>
+      _temporalBuffers; // Packed frames of each temporal model input
+  std::vector<int> _stateInputs; // Model inputs fed from recurrent state
+  RecurrentStateStore _recurrentState; // State checkpoint of each frame
+  DirtyTileCache _tileCache; // Output kept tile by tile for tiled inference
+  std::vector<bool> _shownTiles; // Tiles in _output; the input shows elsewhere
+  bool _allTilesShown;           // Whether _output covers the whole image
+  DD::Image::Box _interest;      // Region last requested, in output pixels
+
+  // Progressive refinement
+  bool _showingPreview; // Whether _output is the upscaled preview
+  bool _reopened;       // Whether nothing was processed since _open()
+  bool _modelChanged;   // Whether the old model's buffers wait for _open()
+  uint64_t _tileJobKey; // Inference hash of the background tiles wanted
+  int _tilesRemaining;  // Background tiles not inferred yet
+  bool _tilesUnpublished; // Whether tiles finished since publishTiles()
+  std::vector<size_t> _pastedTiles; // Background tiles since publishTiles()
+  std::string _tileError; // Why a background tile failed, or empty
+  DD::Image::Box _contentBounds; // Where the last full output has content
+  uint64_t _contentBoundsKey;    // contentBoundsKey() of _contentBounds
+  bool _contentBoundsKnown;      // Whether _contentBounds was computed
+  PlaybackGovernor _governor; // Scale that keeps up with playback
+  std::atomic<int> _refinements; // Results finished, appended to the hash
+  ProgressiveRefiner _refiner; // Declared last: runs on the model manager
 
   // Core functionality
   void loadModel();            // Load the ONNX model
+  void loadInteractiveModel(); // Load or drop the viewer's model
+  void loadSession(ONNXModelManager &session,
+                   const char *path); // Load one model with the settings
+  void selectModel();          // Use the session the viewer or render wants
+  void resetModelState();      // Stop using what the old model produced
+  void dropModelBuffers();     // Free it, under the lock
+  bool interactiveWanted() const; // Whether Interactive Model is loaded
+  bool viewerShortcuts() const;   // Whether GUI requests are all viewers
   void updateDimensions();     // Update output dimensions based on model info
+  void processIfNeeded();      // Process under the lock unless cached
+  DD::Image::Hash inferenceHash() const; // What the model output depends on
   void cacheAndProcessImage(); // Process input image through the model
-  void preprocessImage(const DD::Image::Iop *input,
-                       std::vector<float> &inputTensor);
+  void runDirtyTiles();        // Infer the tiles whose inputs changed
+  bool runPreview(double scale,
+                  double refineDelay); // Infer a small copy, then refine
+  void inferTile(ONNXInferenceProcessor &processor,
+                 const std::vector<int> &tiledInputs,
+                 const std::vector<InputTensorCache::TensorPtr> &crops,
+                 const DirtyTileCache::Tile &tile,
+                 ONNXModelManager::InferenceOutput &output, int &width,
+                 int &height, int &channels); // Run the model on one tile
+  void scheduleTiles(uint64_t key, const std::vector<size_t> &tiles,
+                     const std::vector<int> &tiledInputs,
+                     const std::vector<InputTensorCache::TensorPtr>
+                         &fullTensors); // Infer tiles in the background
+  void publishTiles(bool landed); // Copy landed or all tiles to _output
+  void storeFrameStatistics(); // Index this frame's finished output
+  void adoptRefinement(ProgressiveRefiner::Result &refined); // Swap it in
+  bool progressiveActive() const; // Whether previews are shown
+  bool governorActive() const;    // Whether playback may lower the scale
+  InputTensorCache::TensorPtr
+  packTile(const DD::Image::Tile &tile,
+           const InputTensorCache::Key &key); // Packed, shared tensor
 
   // Output handling
   void findMinMaxValues(); // Find min/max values for normalization
+  void setContentBounds(); // Shrink the bbox to where the output has content
+  void updateContentBounds(); // Find the content of a finished output
+  DD::Image::Hash contentBoundsKey() const; // What the bounds depend on
+  void loadNormalizationStats(); // Merge the stats file into the index
+  int currentFrame() const;      // Frame being rendered, for the index
+  int inputFrameCount(int input) const; // Window frames of a Nuke input
+  uint64_t inputsHashAt(int frame) const; // Image inputs' upstream at a frame
+  int maskInput() const; // Nuke input of the mask, or -1 if not used
+  std::vector<RecurrentStateStore::Binding>
+  stateBindings() const; // Parsed and checked state bindings
   void setupOutputChannels(
       DD::Image::ChannelSet &channels); // Configure output channels
 
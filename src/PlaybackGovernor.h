@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * PlaybackGovernor - Inference scale that keeps up with playback
+ *
+ * During playback a frame that takes longer than the frame interval makes
+ * the viewer stutter. The governor estimates what a full-resolution
+ * inference costs from the frames inferred so far, at whatever scale, on
+ * the assumption that the cost follows the pixel count. It also tracks the
+ * time each frame spends outside inference. From these it picks the
+ * largest scale that fits the target frame rate. Playback is recognised
+ * from consecutive frames requested in quick succession; outside playback
+ * the scale is 1.
+ */
+class PlaybackGovernor {
+public:
+  // Scales are whole multiples of 1 / kScaleSteps, so the scale does not
+  // change with every small variation in latency
+  static const int kScaleSteps = 8;
+
+  // Quick steps of one frame needed before frames count as playback
+  static const int kPlaybackSteps = 3;
+
+  PlaybackGovernor()
+      : _lastFrame(0), _lastTime(-1.0), _steps(0), _fullSeconds(0.0),
+        _overheadSeconds(0.0), _frames(0), _missed(0) {}
+
+  /**
+   * Note that a frame is about to be inferred
+   * @param frame The frame
+   * @param now Time in seconds, on a steady clock
+   * @param targetFps Frame rate playback should reach
+   * @return Whether playback is going on
+   */
+  bool frameRequested(int frame, double now, double targetFps) {
+    bool quick = _lastTime >= 0.0 && now - _lastTime < idleSeconds(targetFps);
+    if (quick && std::abs(frame - _lastFrame) == 1) {
+      _steps++;
+    } else if (frame != _lastFrame || !quick) {
+      _steps = 0;
+    }
+    _lastFrame = frame;
+    _lastTime = now;
+    return playing();
+  }
+
+  bool playing() const { return _steps >= kPlaybackSteps; }
+
+  /**
+   * Time without a new frame after which playback has stopped. A frame
+   * that took several intervals still continues playback.
+   */
+  static double idleSeconds(double targetFps) {
+    return std::max(0.25, 4.0 / std::max(1.0, targetFps));
+  }
+
+  /**
+   * Scale to infer the next frame at: the largest step whose estimated
+   * cost fits the frame interval, 1 outside playback or before anything
+   * has been measured
+   */
+  double scale(double targetFps) const {
+    if (!playing() || _fullSeconds <= 0.0) {
+      return 1.0;
+    }
+    double budget = 1.0 / std::max(1.0, targetFps) - _overheadSeconds;
+    double fit = budget > 0.0 ? std::sqrt(budget / _fullSeconds) : 0.0;
+    int steps = static_cast<int>(std::floor(fit * kScaleSteps));
+    steps = steps < 1 ? 1 : (steps > kScaleSteps ? kScaleSteps : steps);
+    return steps / static_cast<double>(kScaleSteps);
+  }
+
+  /**
+   * Record how long a frame took
+   * @param totalSeconds Whole frame, from frameRequested to the output
+   * @param inferenceSeconds Part spent inferring
+   * @param scale Scale the frame was inferred at
+   * @param targetFps Frame rate playback should reach
+   */
+  void record(double totalSeconds, double inferenceSeconds, double scale,
+              double targetFps) {
+    const double weight = 0.3; // Of the newest frame in the estimates
+    double full = inferenceSeconds / std::max(1e-3, scale * scale);
+    double overhead = std::max(0.0, totalSeconds - inferenceSeconds);
+    if (_fullSeconds <= 0.0) {
+      _fullSeconds = full;
+      _overheadSeconds = overhead;
+    } else {
+      _fullSeconds += weight * (full - _fullSeconds);
+      _overheadSeconds += weight * (overhead - _overheadSeconds);
+    }
+    if (playing()) {
+      _frames++;
+      if (totalSeconds > 1.0 / std::max(1.0, targetFps)) {
+        _missed++;
+      }
+    }
+  }
+
+  /**
+   * Frames played back, and those that missed the frame interval
+   */
+  uint64_t playedFrames() const { return _frames; }
+  uint64_t missedDeadlines() const { return _missed; }
+
+  /**
+   * Forget the estimates and counts, e.g. for another model
+   */
+  void reset() { *this = PlaybackGovernor(); }
+
+private:
+  int _lastFrame;
+  double _lastTime; // Negative before the first frame
+  int _steps;       // Quick one-frame steps in a row
+  double _fullSeconds;     // Estimated full-resolution inference time
+  double _overheadSeconds; // Estimated time outside inference per frame
+  uint64_t _frames;
+  uint64_t _missed;
+};
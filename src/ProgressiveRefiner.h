@@ -0,0 +1,216 @@
+#pragma once
+
+#include "ONNXInferenceProcessor.h"
+#include "TensorProcessor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * ProgressiveRefiner - Full-resolution work behind a quick first result
+ *
+ * In progressive mode a node shows something quickly, such as the output
+ * of a downscaled copy of its inputs, and hands the full-resolution work
+ * here. A background thread runs it, e.g. inferring the inputs on a copy
+ * of the node's inference processor, whose input tensors are shared
+ * read-only, and keeps the result for the node to swap in. Only the latest
+ * request is kept: when the user moves on before a request starts, the
+ * stale one is dropped, and a long task stops at its next step.
+ */
+class ProgressiveRefiner {
+public:
+  // Full-resolution output of one request
+  struct Result {
+    uint64_t key; // Key the request was made with
+    std::vector<float> data;
+    int width, height, channels;
+    TensorProcessor::OutputStatistics statistics;
+    std::string error; // Why inference failed, or empty
+
+    Result() : key(0), data(), width(0), height(0), channels(0),
+               statistics(), error() {}
+  };
+
+  // Work run on the background thread. stale() turns true once a newer
+  // request is waiting or the work is cancelled; long tasks check it
+  // between steps.
+  using Task = std::function<void(const std::function<bool()> &stale)>;
+
+  // The thread starts with the first schedule(): Nuke makes many op
+  // instances per node, and renders and most nodes never refine
+  ProgressiveRefiner()
+      : _pending(), _hasPending(false), _runningKey(0), _running(false),
+        _cancelled(false), _result(), _hasResult(false), _stop(false),
+        _thread() {}
+
+  ~ProgressiveRefiner() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    if (_thread.joinable()) {
+      _thread.join();
+    }
+  }
+
+  ProgressiveRefiner(const ProgressiveRefiner &) = delete;
+  ProgressiveRefiner &operator=(const ProgressiveRefiner &) = delete;
+
+  /**
+   * Infer the prepared inputs of a processor in the background, replacing
+   * any request that has not started
+   * @param key Identifies what the inputs were packed from
+   * @param processor Processor with every input set
+   * @param onReady Called on the background thread when the result is kept
+   * @param delaySeconds Time to wait before inferring; a newer request in
+   *        the meantime drops this one without inferring it
+   */
+  void request(uint64_t key, const ONNXInferenceProcessor &processor,
+               std::function<void()> onReady, double delaySeconds = 0.0) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_hasResult && _result.key == key) {
+        return; // Already done
+      }
+    }
+    ONNXInferenceProcessor copy = processor;
+    schedule(key, [this, key, copy, onReady,
+                   delaySeconds](const std::function<bool()> &stale) mutable {
+      auto start = std::chrono::steady_clock::now();
+      while (std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           start)
+                 .count() < delaySeconds) {
+        if (stale()) {
+          return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+
+      Result result;
+      result.key = key;
+      try {
+        copy.runInference(result.data, &result.statistics);
+        copy.getOutputDimensions(result.width, result.height,
+                                 result.channels);
+      } catch (const std::exception &e) {
+        result.data.clear();
+        result.error = e.what();
+      }
+      if (stale()) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _result = std::move(result);
+        _hasResult = true;
+      }
+      if (onReady) {
+        onReady();
+      }
+    });
+  }
+
+  /**
+   * Run a task in the background, replacing any request that has not
+   * started. A task with the key of the one running is not run again.
+   * @param key Identifies the work
+   * @param task The work
+   */
+  void schedule(uint64_t key, Task task) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_running && _runningKey == key && !_hasPending) {
+        return; // Already on its way
+      }
+      _pending = Job{key, std::move(task)};
+      _hasPending = true;
+      if (!_thread.joinable()) {
+        _thread = std::thread(&ProgressiveRefiner::run, this);
+      }
+    }
+    _wake.notify_all();
+  }
+
+  /**
+   * Take the result of a request if it has finished
+   * @param key Key of the wanted request
+   * @param result Receives the result
+   * @return false if no result for key is ready
+   */
+  bool take(uint64_t key, Result &result) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_hasResult || _result.key != key) {
+      return false;
+    }
+    result = std::move(_result);
+    _hasResult = false;
+    return true;
+  }
+
+  /**
+   * Drop the pending request and any kept result, and wait for a running
+   * one to stop, e.g. before the model it runs is unloaded
+   */
+  void cancel() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _hasPending = false;
+    _cancelled = true;
+    _idle.wait(lock, [this]() { return !_running; });
+    _cancelled = false;
+    _hasResult = false;
+  }
+
+private:
+  struct Job {
+    uint64_t key;
+    Task task;
+  };
+
+  void run() {
+    std::function<bool()> stale = [this]() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _stop || _cancelled || _hasPending;
+    };
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _wake.wait(lock, [this]() { return _stop || _hasPending; });
+      if (_stop) {
+        return;
+      }
+      Job job = std::move(_pending);
+      _hasPending = false;
+      _running = true;
+      _runningKey = job.key;
+      lock.unlock();
+
+      job.task(stale);
+
+      lock.lock();
+      _running = false;
+      _idle.notify_all();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _wake; // A request was made or stop was set
+  std::condition_variable _idle; // A request finished
+  Job _pending;
+  bool _hasPending;
+  uint64_t _runningKey;
+  bool _running;
+  bool _cancelled; // Set while cancel() waits for the running task
+  Result _result;
+  bool _hasResult;
+  bool _stop;
+  std::thread _thread; // Started by the first schedule()
+};
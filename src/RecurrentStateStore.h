@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * RecurrentStateStore - Hidden state of a recurrent model, frame by frame
+ *
+ * Recurrent video models (e.g. temporal matting) take the state their
+ * previous frame produced as extra inputs. A binding names the output a
+ * state comes from and the input it is fed back to. The store keeps the
+ * state each inferred frame produced as a checkpoint, so frame N+1 starts
+ * from frame N's state, and a jump resumes from the nearest earlier
+ * checkpoint instead of inferring again from the start of the shot.
+ * A checkpoint is dropped, with every later one, when the inputs of the
+ * frame it came from have changed, and the ones farthest from the current
+ * frame go first when the store is full.
+ */
+class RecurrentStateStore {
+public:
+  // Output fed back to an input on the next frame
+  struct Binding {
+    std::string output;
+    std::string input;
+  };
+
+  // One state tensor, shaped as the input it is fed to
+  struct Tensor {
+    std::vector<int64_t> shape;
+    std::shared_ptr<const std::vector<float>> data;
+  };
+
+  // State tensors of one frame, by model input name
+  using State = std::map<std::string, Tensor>;
+
+  // State tensors are small next to the images; this covers a few seconds
+  // of scrubbing
+  static const int kDefaultCapacity = 48;
+
+  explicit RecurrentStateStore(size_t capacity = kDefaultCapacity)
+      : _capacity(std::max<size_t>(1, capacity)), _checkpoints() {}
+
+  /**
+   * Parse state bindings written as "output:input" pairs separated by
+   * whitespace or commas, e.g. "r1o:r1i, r2o:r2i"
+   * @throws std::invalid_argument if a pair is malformed
+   */
+  static std::vector<Binding> parseBindings(const std::string &text) {
+    std::string spaced = text;
+    std::replace(spaced.begin(), spaced.end(), ',', ' ');
+    std::istringstream pairs(spaced);
+    std::vector<Binding> bindings;
+    std::string pair;
+    while (pairs >> pair) {
+      size_t colon = pair.find(':');
+      if (colon == std::string::npos || colon == 0 ||
+          colon + 1 == pair.size() ||
+          pair.find(':', colon + 1) != std::string::npos) {
+        throw std::invalid_argument("State binding \"" + pair +
+                                    "\" is not output:input");
+      }
+      bindings.push_back(
+          Binding{pair.substr(0, colon), pair.substr(colon + 1)});
+    }
+    return bindings;
+  }
+
+  /**
+   * Zero state for an input of the model's shape. Dynamic dimensions are
+   * given size 1, which recurrent models broadcast on their first frame.
+   */
+  static Tensor zeroState(const std::vector<int64_t> &modelShape) {
+    Tensor tensor;
+    size_t count = 1;
+    for (int64_t dim : modelShape) {
+      tensor.shape.push_back(dim > 0 ? dim : 1);
+      count *= static_cast<size_t>(tensor.shape.back());
+    }
+    tensor.data = std::make_shared<const std::vector<float>>(count, 0.0f);
+    return tensor;
+  }
+
+  /**
+   * Set the number of checkpoints kept
+   */
+  void setCapacity(size_t capacity) {
+    _capacity = std::max<size_t>(1, capacity);
+  }
+
+  /**
+   * Keep the state a frame produced
+   * @param frame Frame that was inferred
+   * @param sourceHash Hash of the inputs the frame was inferred from
+   * @param fromFrame Frame whose state it started from, or frame itself if
+   *                  it started from zeros
+   * @param state The state to feed to the next frame
+   */
+  void store(int frame, uint64_t sourceHash, int fromFrame, State state) {
+    _checkpoints[frame] = Checkpoint{sourceHash, fromFrame, std::move(state)};
+    while (_checkpoints.size() > _capacity) {
+      auto first = _checkpoints.begin();
+      auto last = std::prev(_checkpoints.end());
+      if (std::abs(first->first - frame) >= std::abs(last->first - frame)) {
+        _checkpoints.erase(first);
+      } else {
+        _checkpoints.erase(last);
+      }
+    }
+  }
+
+  /**
+   * Drop the checkpoints of a frame and the frames after it if the frame's
+   * inputs have changed since its checkpoint was stored
+   * @param frame Frame about to be inferred
+   * @param sourceHash Hash of the frame's inputs now
+   */
+  void invalidateIfChanged(int frame, uint64_t sourceHash) {
+    auto it = _checkpoints.find(frame);
+    if (it != _checkpoints.end() && it->second.sourceHash != sourceHash) {
+      _checkpoints.erase(it, _checkpoints.end());
+    }
+  }
+
+  /**
+   * State to start a frame from: the previous frame's, or the nearest
+   * earlier checkpoint within reach frames. The checkpoint's frame and the
+   * stored frames its state was carried through are checked against their
+   * inputs now; where one has changed, it and every later checkpoint are
+   * dropped and the search goes on from the checkpoint before.
+   * @param frame Frame about to be inferred
+   * @param reach How far back a checkpoint may be (at least 1)
+   * @param sourceHashAt Hash of a frame's inputs now
+   * @param fromFrame Set to the frame the state came from
+   * @return The state, or nullptr if there is none within reach
+   */
+  const State *resume(int frame, int reach,
+                      const std::function<uint64_t(int)> &sourceHashAt,
+                      int &fromFrame) {
+    auto it = _checkpoints.lower_bound(frame);
+    while (it != _checkpoints.begin()) {
+      --it;
+      if (frame - it->first > std::max(1, reach)) {
+        return nullptr;
+      }
+      auto stale = staleAncestor(it, sourceHashAt);
+      if (stale == _checkpoints.end()) {
+        fromFrame = it->first;
+        return &it->second.state;
+      }
+      it = _checkpoints.erase(stale, _checkpoints.end());
+    }
+    return nullptr;
+  }
+
+  size_t size() const { return _checkpoints.size(); }
+  void clear() { _checkpoints.clear(); }
+
+private:
+  struct Checkpoint {
+    uint64_t sourceHash;
+    int fromFrame; // Checkpoint it started from; its own frame if zeros
+    State state;
+  };
+
+  // The first checkpoint, following a state back through the frames it was
+  // carried from, whose inputs have changed; end() if there is none. The
+  // walk stops where a frame started from zeros or its seed was evicted.
+  std::map<int, Checkpoint>::iterator
+  staleAncestor(std::map<int, Checkpoint>::iterator it,
+                const std::function<uint64_t(int)> &sourceHashAt) {
+    while (true) {
+      if (it->second.sourceHash != sourceHashAt(it->first)) {
+        return it;
+      }
+      int seed = it->second.fromFrame;
+      if (seed >= it->first) {
+        return _checkpoints.end();
+      }
+      it = _checkpoints.find(seed);
+      if (it == _checkpoints.end()) {
+        return it;
+      }
+    }
+  }
+
+  size_t _capacity;
+  std::map<int, Checkpoint> _checkpoints;
+};
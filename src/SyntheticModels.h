@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * SyntheticModels - Small ONNX models generated in code
+ *
+ * Used by the benchmark so that its workload lives in the tree as source
+ * rather than as binary model files. Models are serialized straight to the
+ * ONNX protobuf wire format; every model takes one NCHW "input" with 3
+ * channels and dynamic batch, height and width, and produces one NCHW
+ * "output".
+ */
+namespace SyntheticModels {
+
+/**
+ * Minimal protobuf wire-format writer
+ */
+class ProtoWriter {
+public:
+  void varint(uint32_t field, uint64_t value) {
+    key(field, 0);
+    putVarint(value);
+  }
+  void float32(uint32_t field, float value) {
+    key(field, 5);
+    char bytes[4];
+    std::memcpy(bytes, &value, 4); // Little-endian hosts only
+    _data.append(bytes, 4);
+  }
+  // Strings, raw bytes and nested messages
+  void bytes(uint32_t field, const std::string &value) {
+    key(field, 2);
+    putVarint(value.size());
+    _data += value;
+  }
+  const std::string &data() const { return _data; }
+
+private:
+  void key(uint32_t field, uint32_t wireType) {
+    putVarint((static_cast<uint64_t>(field) << 3) | wireType);
+  }
+  void putVarint(uint64_t value) {
+    while (value >= 0x80) {
+      _data += static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    _data += static_cast<char>(value);
+  }
+
+  std::string _data;
+};
+
+// ONNX enum values used below
+const int kFloatType = 1;     // TensorProto.DataType.FLOAT
+const int kAttrFloat = 1;     // AttributeProto.AttributeType.FLOAT
+const int kAttrInt = 2;       // AttributeProto.AttributeType.INT
+const int kAttrInts = 7;      // AttributeProto.AttributeType.INTS
+const int kIRVersion = 7;     // ONNX IR version written
+const int kOpsetVersion = 13; // Default-domain opset imported
+
+/**
+ * Float initializer tensor (TensorProto)
+ */
+inline std::string tensor(const std::string &name,
+                          const std::vector<int64_t> &dims,
+                          const std::vector<float> &values) {
+  ProtoWriter writer;
+  for (int64_t d : dims) {
+    writer.varint(1, static_cast<uint64_t>(d)); // dims
+  }
+  writer.varint(2, kFloatType); // data_type
+  writer.bytes(8, name);        // name
+  writer.bytes(9, std::string(reinterpret_cast<const char *>(values.data()),
+                              values.size() * sizeof(float))); // raw_data
+  return writer.data();
+}
+
+/**
+ * NCHW float graph input or output (ValueInfoProto) with a fixed channel
+ * count and symbolic batch, height and width
+ */
+inline std::string imageValueInfo(const std::string &name, int channels) {
+  auto dimension = [](const char *param, int64_t value) {
+    ProtoWriter dim;
+    if (param) {
+      dim.bytes(2, param); // dim_param
+    } else {
+      dim.varint(1, static_cast<uint64_t>(value)); // dim_value
+    }
+    return dim.data();
+  };
+
+  ProtoWriter shape;
+  shape.bytes(1, dimension("N", 0));
+  shape.bytes(1, dimension(nullptr, channels));
+  shape.bytes(1, dimension("H", 0));
+  shape.bytes(1, dimension("W", 0));
+
+  ProtoWriter tensorType;
+  tensorType.varint(1, kFloatType); // elem_type
+  tensorType.bytes(2, shape.data());
+
+  ProtoWriter type;
+  type.bytes(1, tensorType.data()); // tensor_type
+
+  ProtoWriter valueInfo;
+  valueInfo.bytes(1, name);
+  valueInfo.bytes(2, type.data());
+  return valueInfo.data();
+}
+
+// Node attributes (AttributeProto)
+inline std::string intsAttribute(const std::string &name,
+                                 const std::vector<int64_t> &values) {
+  ProtoWriter writer;
+  writer.bytes(1, name);
+  for (int64_t v : values) {
+    writer.varint(8, static_cast<uint64_t>(v));
+  }
+  writer.varint(20, kAttrInts);
+  return writer.data();
+}
+
+inline std::string intAttribute(const std::string &name, int64_t value) {
+  ProtoWriter writer;
+  writer.bytes(1, name);
+  writer.varint(3, static_cast<uint64_t>(value));
+  writer.varint(20, kAttrInt);
+  return writer.data();
+}
+
+inline std::string floatAttribute(const std::string &name, float value) {
+  ProtoWriter writer;
+  writer.bytes(1, name);
+  writer.float32(2, value);
+  writer.varint(20, kAttrFloat);
+  return writer.data();
+}
+
+/**
+ * Graph node (NodeProto)
+ */
+inline std::string node(const std::string &opType,
+                        const std::vector<std::string> &inputs,
+                        const std::vector<std::string> &outputs,
+                        const std::vector<std::string> &attributes = {}) {
+  ProtoWriter writer;
+  for (const auto &input : inputs) {
+    writer.bytes(1, input);
+  }
+  for (const auto &output : outputs) {
+    writer.bytes(2, output);
+  }
+  writer.bytes(3, outputs.empty() ? opType : outputs[0] + "_" + opType);
+  writer.bytes(4, opType);
+  for (const auto &attribute : attributes) {
+    writer.bytes(5, attribute);
+  }
+  return writer.data();
+}
+
+/**
+ * Accumulates the parts of a graph and serializes the model (ModelProto)
+ */
+class GraphBuilder {
+public:
+  explicit GraphBuilder(const std::string &name) : _name(name) {}
+
+  void addNode(const std::string &node) { _nodes.push_back(node); }
+  void addInitializer(const std::string &tensor) {
+    _initializers.push_back(tensor);
+  }
+
+  std::string model(int inputChannels, int outputChannels) const {
+    ProtoWriter graph;
+    for (const auto &node : _nodes) {
+      graph.bytes(1, node);
+    }
+    graph.bytes(2, _name);
+    for (const auto &initializer : _initializers) {
+      graph.bytes(5, initializer);
+    }
+    graph.bytes(11, imageValueInfo("input", inputChannels));
+    graph.bytes(12, imageValueInfo("output", outputChannels));
+
+    ProtoWriter opset;
+    opset.bytes(1, "");
+    opset.varint(2, kOpsetVersion);
+
+    ProtoWriter model;
+    model.varint(1, kIRVersion);
+    model.bytes(2, "onnx_nuke synthetic");
+    model.bytes(7, graph.data());
+    model.bytes(8, opset.data());
+    return model.data();
+  }
+
+private:
+  std::string _name;
+  std::vector<std::string> _nodes;
+  std::vector<std::string> _initializers;
+};
+
+/**
+ * Deterministic weights in [-scale, scale], so every build benchmarks the
+ * same model
+ */
+inline std::vector<float> weights(size_t count, float scale, uint32_t seed) {
+  std::vector<float> values(count);
+  uint32_t state = seed;
+  for (size_t i = 0; i < count; i++) {
+    state = state * 1664525u + 1013904223u;
+    values[i] = scale * (2.0f * (state >> 8) / 16777216.0f - 1.0f);
+  }
+  return values;
+}
+
+// Square convolution with "same" padding, from input to output
+inline void addConvolution(GraphBuilder &graph, const std::string &input,
+                           const std::string &output, int inChannels,
+                           int outChannels, int kernel, uint32_t seed) {
+  std::string weightName = output + "_W";
+  std::string biasName = output + "_B";
+  graph.addInitializer(tensor(
+      weightName, {outChannels, inChannels, kernel, kernel},
+      weights(static_cast<size_t>(outChannels) * inChannels * kernel * kernel,
+              1.0f / (inChannels * kernel * kernel), seed)));
+  graph.addInitializer(
+      tensor(biasName, {outChannels}, weights(outChannels, 0.1f, seed + 1)));
+
+  int pad = kernel / 2;
+  graph.addNode(node("Conv", {input, weightName, biasName}, {output},
+                     {intsAttribute("kernel_shape", {kernel, kernel}),
+                      intsAttribute("pads", {pad, pad, pad, pad}),
+                      intAttribute("group", 1)}));
+}
+
+/**
+ * Pass-through model; measures packing, Run overhead and unpacking only
+ */
+inline std::string identity() {
+  GraphBuilder graph("identity");
+  graph.addNode(node("Identity", {"input"}, {"output"}));
+  return graph.model(3, 3);
+}
+
+/**
+ * Memory-bound elementwise chain: output = relu(input * 1.5 + 0.25) ^ 0.8
+ */
+inline std::string pointwise() {
+  GraphBuilder graph("pointwise");
+  graph.addInitializer(tensor("scale", {}, {1.5f}));
+  graph.addInitializer(tensor("offset", {}, {0.25f}));
+  graph.addInitializer(tensor("exponent", {}, {0.8f}));
+  graph.addNode(node("Mul", {"input", "scale"}, {"scaled"}));
+  graph.addNode(node("Add", {"scaled", "offset"}, {"shifted"}));
+  graph.addNode(node("Relu", {"shifted"}, {"rectified"}));
+  graph.addNode(node("Pow", {"rectified", "exponent"}, {"output"}));
+  return graph.model(3, 3);
+}
+
+/**
+ * Compute-bound image-to-image network: two 3x3 convolutions through a
+ * hidden layer
+ */
+inline std::string convolution(int hiddenChannels) {
+  GraphBuilder graph("convolution");
+  addConvolution(graph, "input", "hidden", 3, hiddenChannels, 3, 17);
+  graph.addNode(node("LeakyRelu", {"hidden"}, {"activated"},
+                     {floatAttribute("alpha", 0.1f)}));
+  addConvolution(graph, "activated", "output", hiddenChannels, 3, 3, 29);
+  return graph.model(3, 3);
+}
+
+/**
+ * Depth-estimation shaped network with a single-channel output
+ */
+inline std::string depth(int hiddenChannels) {
+  GraphBuilder graph("depth");
+  addConvolution(graph, "input", "features", 3, hiddenChannels, 3, 41);
+  graph.addNode(node("Relu", {"features"}, {"activated"}));
+  addConvolution(graph, "activated", "logits", hiddenChannels, 1, 1, 53);
+  graph.addNode(node("Sigmoid", {"logits"}, {"output"}));
+  return graph.model(3, 1);
+}
+
+/**
+ * Write serialized model bytes to a file
+ * @return True on success
+ */
+inline bool writeModel(const std::string &path, const std::string &model) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(model.data(), static_cast<std::streamsize>(model.size()));
+  return static_cast<bool>(file);
+}
+
+} // namespace SyntheticModels
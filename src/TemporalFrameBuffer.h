@@ -0,0 +1,158 @@
+#pragma once
+
+#include "InputTensorCache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * TemporalFrameBuffer - Packed frames of one temporal model input
+ *
+ * Video models take a window of frames as one NCTHW input. The buffer keeps
+ * the NCHW tensor packed for each frame, keyed by frame number and checked
+ * against the cache key of the upstream at that frame, so moving one frame
+ * forward packs only the frame entering the window. When the buffer is full,
+ * the frames farthest from the current one are dropped.
+ */
+class TemporalFrameBuffer {
+public:
+  using TensorPtr = InputTensorCache::TensorPtr;
+
+  // Enough for a window of several frames plus scrubbing back and forth
+  static const int kDefaultCapacity = 16;
+
+  explicit TemporalFrameBuffer(size_t capacity = kDefaultCapacity)
+      : _capacity(std::max<size_t>(1, capacity)), _frames() {}
+
+  /**
+   * Set the number of frames kept
+   */
+  void setCapacity(size_t capacity) {
+    _capacity = std::max<size_t>(1, capacity);
+  }
+
+  /**
+   * Look up the tensor of a frame
+   * @param frame Frame number
+   * @param key Cache key of the upstream at that frame
+   * @return The tensor, or nullptr if the frame is missing or has changed
+   */
+  TensorPtr find(int frame, const InputTensorCache::Key &key) const {
+    auto it = _frames.find(frame);
+    if (it == _frames.end() || it->second.key < key || key < it->second.key) {
+      return nullptr;
+    }
+    return it->second.tensor;
+  }
+
+  /**
+   * Add or replace the tensor of a frame
+   * @param frame Frame number
+   * @param key Cache key of the upstream at that frame
+   * @param tensor The packed NCHW tensor
+   * @param currentFrame Frame being rendered; the farthest frames are
+   *                     dropped first
+   */
+  void store(int frame, const InputTensorCache::Key &key, TensorPtr tensor,
+             int currentFrame) {
+    _frames[frame] = Entry{key, std::move(tensor)};
+    while (_frames.size() > _capacity) {
+      auto first = _frames.begin();
+      auto last = std::prev(_frames.end());
+      if (std::abs(first->first - currentFrame) >=
+          std::abs(last->first - currentFrame)) {
+        _frames.erase(first);
+      } else {
+        _frames.erase(last);
+      }
+    }
+  }
+
+  size_t size() const { return _frames.size(); }
+  void clear() { _frames.clear(); }
+
+  /**
+   * Frame offsets of a window of frameCount frames, in time order. Odd
+   * windows are centred on the current frame; even windows hold one more
+   * past frame than future frames.
+   */
+  static std::vector<int> windowOffsets(int frameCount) {
+    std::vector<int> offsets;
+    int first = -(std::max(1, frameCount) / 2);
+    for (int i = 0; i < std::max(1, frameCount); i++) {
+      offsets.push_back(first + i);
+    }
+    return offsets;
+  }
+
+  /**
+   * Frame offset fetched by a split of a temporal Nuke input. Split 0 is
+   * the current frame, so input(n) keeps returning it; the other splits
+   * follow in time order.
+   * @param split Split index, 0 to frameCount - 1
+   * @param frameCount Frames in the window
+   */
+  static int splitOffset(int split, int frameCount) {
+    if (split <= 0) {
+      return 0;
+    }
+    std::vector<int> offsets = windowOffsets(frameCount);
+    offsets.erase(std::find(offsets.begin(), offsets.end(), 0));
+    return offsets[std::min<size_t>(split - 1, offsets.size() - 1)];
+  }
+
+  /**
+   * Split index that fetches a frame offset (see splitOffset)
+   */
+  static int splitOf(int offset, int frameCount) {
+    for (int split = 0; split < std::max(1, frameCount); split++) {
+      if (splitOffset(split, frameCount) == offset) {
+        return split;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * Interleave per-frame NCHW tensors (batch 1) into one NCTHW tensor
+   * @param frames One tensor per time step, in time order
+   * @param channels Channels per frame
+   * @param width Frame width
+   * @param height Frame height
+   * @return The NCTHW tensor
+   * @throws std::invalid_argument if a frame has the wrong size
+   */
+  static std::vector<float> assemble(const std::vector<TensorPtr> &frames,
+                                     int channels, int width, int height) {
+    size_t planeSize = static_cast<size_t>(width) * height;
+    size_t frameCount = frames.size();
+    std::vector<float> tensor(channels * frameCount * planeSize);
+    for (size_t t = 0; t < frameCount; t++) {
+      if (!frames[t] || frames[t]->size() != channels * planeSize) {
+        throw std::invalid_argument("Frame " + std::to_string(t) +
+                                    " of the temporal window has the wrong "
+                                    "size");
+      }
+      for (int c = 0; c < channels; c++) {
+        const float *src = frames[t]->data() + c * planeSize;
+        std::copy(src, src + planeSize,
+                  tensor.data() + (c * frameCount + t) * planeSize);
+      }
+    }
+    return tensor;
+  }
+
+private:
+  struct Entry {
+    InputTensorCache::Key key;
+    TensorPtr tensor;
+  };
+
+  size_t _capacity;
+  std::map<int, Entry> _frames;
+};
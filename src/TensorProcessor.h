@@ -1,11 +1,26 @@
 #pragma once
 
+#include "WorkerPool.h"
+
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * TensorProcessor - Handles tensor operations for ONNX inference
  * Contains functions and structures for tensor manipulation independent of
@@ -13,9 +28,163 @@
  */
 class TensorProcessor {
 public:
+  // How output values are mapped to 0-1 when normalizing
+  enum NormalizeMode {
+    kNormalizeGlobal = 0,     // One range for the whole output
+    kNormalizePerChannel = 1, // One range per output channel
+    kNormalizePerLayer = 2,   // One range per group of output channels
+  };
+
+  // Normalization range of one output channel, with the scale and offset
+  // applied by normalizeRow
+  struct NormalizationRange {
+    float min;
+    float max;
+    float scale;
+    float offset;
+
+    NormalizationRange() : min(0.0f), max(1.0f), scale(1.0f), offset(0.0f) {}
+    NormalizationRange(float lo, float hi) : min(lo), max(hi) {
+      if (hi > lo) {
+        scale = 1.0f / (hi - lo);
+        offset = -lo * scale;
+      } else {
+        // Degenerate range: same result as normalize()
+        scale = 0.0f;
+        offset = 0.5f;
+      }
+    }
+  };
+
+  // Range of the finite values in part of a tensor. Empty ranges keep the
+  // max()/lowest() sentinels, as the scalar loops always did.
+  struct MinMax {
+    float min;
+    float max;
+  };
+
+  /**
+   * Statistics of a model output, collected by copyOutput while the output is
+   * copied out of the ONNX Runtime buffer. Ranges, mean and histogram cover
+   * finite values only.
+   */
+  struct OutputStatistics {
+    // Histogram buckets follow value order: sign, exponent and the top
+    // kHistogramMantissaBits bits of the mantissa, so any output range is
+    // covered with about 1/16 relative resolution. The histogram is built
+    // from a regular sample of the finite values.
+    static const int kHistogramMantissaBits = 3;
+    static const size_t kHistogramBins = size_t(1)
+                                         << (9 + kHistogramMantissaBits);
+
+    size_t elementCount;             // Values copied
+    size_t finiteCount;              // Values counted below
+    size_t replacedCount;            // NaN and Inf values written as 0
+    size_t planeSize;                // Values per channel plane
+    double mean;                     // Mean of the finite values
+    std::vector<MinMax> channels;    // Finite range of each plane
+    std::vector<uint32_t> histogram; // kHistogramBins counts
+
+    OutputStatistics()
+        : elementCount(0), finiteCount(0), replacedCount(0), planeSize(0),
+          mean(0.0), channels(), histogram() {}
+
+    /**
+     * Merged finite range of channels [first, first + count)
+     */
+    MinMax range(size_t first, size_t count) const {
+      MinMax merged{std::numeric_limits<float>::max(),
+                    std::numeric_limits<float>::lowest()};
+      for (size_t c = first; c < first + count && c < channels.size(); c++) {
+        merged.min = std::min(merged.min, channels[c].min);
+        merged.max = std::max(merged.max, channels[c].max);
+      }
+      return merged;
+    }
+
+    /**
+     * Estimate a percentile of the finite values from the histogram,
+     * interpolating inside the bucket
+     * @param fraction Percentile as a fraction, e.g. 0.99
+     */
+    float percentile(double fraction) const {
+      return percentiles(std::vector<double>(1, fraction))[0];
+    }
+
+    /**
+     * Estimate several percentiles in one walk over the histogram
+     * @param fractions Percentiles as fractions, in ascending order
+     * @return One value per fraction
+     */
+    std::vector<float> percentiles(const std::vector<double> &fractions) const {
+      MinMax all = range(0, channels.size());
+      double samples = 0.0;
+      for (uint32_t count : histogram) {
+        samples += count;
+      }
+      std::vector<float> values(fractions.size(), all.max);
+      if (samples == 0.0) {
+        std::fill(values.begin(), values.end(),
+                  finiteCount > 0 ? all.min : 0.0f);
+        return values;
+      }
+
+      size_t next = 0;
+      double before = 0.0;
+      for (size_t bucket = 0;
+           bucket < kHistogramBins && next < fractions.size(); bucket++) {
+        double count = histogram[bucket];
+        if (count == 0.0) {
+          continue;
+        }
+        float lo = std::max(all.min, bucketLowerBound(bucket));
+        float hi = bucket + 1 < kHistogramBins
+                       ? std::min(all.max, bucketLowerBound(bucket + 1))
+                       : all.max;
+        if (!(lo <= hi)) { // Bounds of the NaN and Inf buckets
+          lo = hi = std::max(all.min, std::min(all.max, lo));
+        }
+        for (; next < fractions.size(); next++) {
+          double rank =
+              std::max(0.0, std::min(1.0, fractions[next])) * samples;
+          if (before + count < rank) {
+            break;
+          }
+          double t = std::max(0.0, (rank - before) / count);
+          values[next] = static_cast<float>(lo + (hi - lo) * t);
+        }
+        before += count;
+      }
+      return values;
+    }
+
+    /**
+     * Histogram bucket of a finite value
+     */
+    static size_t bucketOf(float value) {
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      // Flip so that unsigned order matches float order
+      uint32_t key = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+      return key >> (23 - kHistogramMantissaBits);
+    }
+
+    /**
+     * Smallest value in a bucket
+     */
+    static float bucketLowerBound(size_t bucket) {
+      uint32_t key = static_cast<uint32_t>(bucket)
+                     << (23 - kHistogramMantissaBits);
+      uint32_t bits = (key & 0x80000000u) ? key & 0x7FFFFFFFu : ~key;
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+  };
+
   // Structure to hold input tensor information
   struct InputTensorInfo {
-    std::vector<float> data;    // Input tensor data
+    std::shared_ptr<const std::vector<float>> data; // Input tensor data
     std::vector<int64_t> shape; // Input tensor shape
     std::string name;           // Input tensor name
     bool valid;                 // Whether this input is valid
@@ -24,7 +193,347 @@ public:
   };
 
   /**
-   * Find minimum and maximum values in a tensor
+   * Whether a model input takes images: NCHW (or longer) with spatial
+   * dimensions that are not fixed at 1. Other inputs, such as scalars,
+   * vectors or 1x1 conditioning tensors, are parameters fed from numbers.
+   * @param shape Model input shape; dynamic dimensions are negative
+   */
+  static bool isImageShape(const std::vector<int64_t> &shape) {
+    if (shape.size() < 4) {
+      return false;
+    }
+    return shape[shape.size() - 2] != 1 && shape[shape.size() - 1] != 1;
+  }
+
+  /**
+   * Frames along the time axis of a model input: the declared count of an
+   * NCTHW input, defaultFrames when it is dynamic, and 1 for other inputs
+   */
+  static int temporalFrames(const std::vector<int64_t> &shape,
+                            int defaultFrames) {
+    if (shape.size() != 5 || !isImageShape(shape)) {
+      return 1;
+    }
+    return shape[2] > 0 ? static_cast<int>(shape[2])
+                        : std::max(1, defaultFrames);
+  }
+
+  /**
+   * Parse the values of a parameter input
+   * @param text Whitespace or comma separated numbers, e.g. "0.5" or "1 0 0"
+   * @return The values; empty for empty text
+   */
+  static std::vector<float> parseParameterValues(const std::string &text) {
+    std::string values = text;
+    std::replace(values.begin(), values.end(), ',', ' ');
+    std::istringstream stream(values);
+    std::vector<float> parsed;
+    std::string token;
+    while (stream >> token) {
+      char *end = nullptr;
+      float value = std::strtof(token.c_str(), &end);
+      if (end == token.c_str() || *end != '\0') {
+        throw std::invalid_argument("Invalid parameter value '" + token +
+                                    "'; expected numbers");
+      }
+      parsed.push_back(value);
+    }
+    return parsed;
+  }
+
+  /**
+   * Build the tensor of a parameter input. A dynamic first dimension is the
+   * batch size; the last other dynamic dimension takes as many values as
+   * were given and any others are 1. The values are repeated to fill the
+   * tensor, so one value per batch item (or one in total) is enough.
+   * @param modelShape Model input shape; dynamic dimensions are negative
+   * @param values Parameter values; empty fills the tensor with zeros
+   * @param batchSize Images along the batch axis of the image inputs
+   * @param shape Output shape of the tensor
+   * @return The tensor data
+   * @throws std::invalid_argument if the values do not fill the tensor
+   */
+  static std::vector<float>
+  parameterTensor(const std::vector<int64_t> &modelShape,
+                  const std::vector<float> &values, int batchSize,
+                  std::vector<int64_t> &shape) {
+    shape = modelShape;
+    int64_t known = 1; // Elements per batch item outside the free dimension
+    int free = -1;
+    for (size_t d = 0; d < shape.size(); d++) {
+      if (shape[d] < 0 && d == 0) {
+        shape[d] = std::max(1, batchSize);
+        continue;
+      }
+      if (shape[d] < 0) {
+        if (free >= 0) {
+          shape[free] = 1;
+        }
+        free = static_cast<int>(d);
+        continue;
+      }
+      if (d > 0) {
+        known *= shape[d];
+      }
+    }
+    if (free >= 0) {
+      shape[free] = std::max<int64_t>(
+          1, static_cast<int64_t>(values.size()) / std::max<int64_t>(1, known));
+    }
+
+    size_t count = 1;
+    for (int64_t dim : shape) {
+      count *= static_cast<size_t>(std::max<int64_t>(0, dim));
+    }
+
+    std::vector<float> tensor(count, 0.0f);
+    if (values.empty()) {
+      return tensor;
+    }
+    if (count % values.size() != 0) {
+      throw std::invalid_argument(
+          "Expected " + std::to_string(count) + " values (or a divisor of " +
+          "it), got " + std::to_string(values.size()));
+    }
+    for (size_t i = 0; i < count; i++) {
+      tensor[i] = values[i % values.size()];
+    }
+    return tensor;
+  }
+
+  /**
+   * Pack an interleaved image into one NCHW batch slot. Mirrors
+   * Utils::tileToNCHWTensor: source channels map to tensor channels in order
+   * and channels missing from the source are filled with zeros.
+   * @param pixels Interleaved source pixels, row by row
+   * @param width Image width
+   * @param height Image height
+   * @param sourceChannels Channels per source pixel
+   * @param tensor Destination tensor, sized by the caller for the batch
+   * @param channels Tensor channel count
+   * @param batchIndex Batch slot to fill
+   */
+  static void interleavedToNCHW(const float *pixels, int width, int height,
+                                int sourceChannels, std::vector<float> &tensor,
+                                int channels, int batchIndex = 0) {
+    if (!pixels || width <= 0 || height <= 0 || sourceChannels <= 0 ||
+        channels <= 0 || batchIndex < 0) {
+      throw std::invalid_argument("Invalid dimensions for tensor packing");
+    }
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    size_t batchOffset = static_cast<size_t>(batchIndex) * channels * planeSize;
+    if (batchOffset + channels * planeSize > tensor.size()) {
+      throw std::out_of_range("Tensor too small for batch index " +
+                              std::to_string(batchIndex));
+    }
+
+    for (int c = 0; c < channels; c++) {
+      float *dst = tensor.data() + batchOffset + c * planeSize;
+      if (c >= sourceChannels) {
+        std::fill(dst, dst + planeSize, 0.0f);
+        continue;
+      }
+
+      for (size_t i = 0; i < planeSize; i++) {
+        dst[i] = pixels[i * sourceChannels + c];
+      }
+    }
+  }
+
+  /**
+   * Pack an interleaved image into one NCHW batch slot of a different size,
+   * resampling each channel with resamplePlane
+   * @param pixels Interleaved source pixels, row by row
+   * @param width Image width
+   * @param height Image height
+   * @param sourceChannels Channels per source pixel
+   * @param tensor Destination tensor, already sized for the whole batch
+   * @param channels Tensor channel count
+   * @param batchIndex Batch slot to fill
+   * @param tensorWidth Tensor width
+   * @param tensorHeight Tensor height
+   */
+  static void interleavedToNCHW(const float *pixels, int width, int height,
+                                int sourceChannels, std::vector<float> &tensor,
+                                int channels, int batchIndex, int tensorWidth,
+                                int tensorHeight) {
+    if (tensorWidth == width && tensorHeight == height) {
+      interleavedToNCHW(pixels, width, height, sourceChannels, tensor,
+                        channels, batchIndex);
+      return;
+    }
+    if (!pixels || width <= 0 || height <= 0 || sourceChannels <= 0 ||
+        channels <= 0 || batchIndex < 0 || tensorWidth <= 0 ||
+        tensorHeight <= 0) {
+      throw std::invalid_argument("Invalid dimensions for tensor packing");
+    }
+
+    size_t planeSize = static_cast<size_t>(tensorWidth) * tensorHeight;
+    size_t batchOffset = static_cast<size_t>(batchIndex) * channels * planeSize;
+    if (batchOffset + channels * planeSize > tensor.size()) {
+      throw std::out_of_range("Tensor too small for batch index " +
+                              std::to_string(batchIndex));
+    }
+
+    size_t sourcePlaneSize = static_cast<size_t>(width) * height;
+    std::vector<float> plane(sourcePlaneSize);
+    for (int c = 0; c < channels; c++) {
+      float *dst = tensor.data() + batchOffset + c * planeSize;
+      if (c >= sourceChannels) {
+        std::fill(dst, dst + planeSize, 0.0f);
+        continue;
+      }
+
+      for (size_t i = 0; i < sourcePlaneSize; i++) {
+        plane[i] = pixels[i * sourceChannels + c];
+      }
+      resamplePlane(plane.data(), width, height, dst, tensorWidth,
+                    tensorHeight);
+    }
+  }
+
+  /**
+   * Size an image input is packed at: the height and width the model
+   * declares for it, or the image's own size for dynamic dimensions
+   * @param modelShape Model input shape (NCHW); dynamic dimensions negative
+   * @param imageWidth Width of the connected image
+   * @param imageHeight Height of the connected image
+   * @param width Packed width
+   * @param height Packed height
+   */
+  static void packedImageSize(const std::vector<int64_t> &modelShape,
+                              int imageWidth, int imageHeight, int &width,
+                              int &height) {
+    width = imageWidth;
+    height = imageHeight;
+    if (modelShape.size() >= 4) {
+      int64_t modelHeight = modelShape[modelShape.size() - 2];
+      int64_t modelWidth = modelShape[modelShape.size() - 1];
+      if (modelWidth > 0) {
+        width = static_cast<int>(modelWidth);
+      }
+      if (modelHeight > 0) {
+        height = static_cast<int>(modelHeight);
+      }
+    }
+  }
+
+  /**
+   * Bilinear resample of one plane, sampling at pixel centres and clamping
+   * at the edges. Same-size planes are copied.
+   * @param src Source plane, row by row
+   * @param srcWidth Source width
+   * @param srcHeight Source height
+   * @param dst Destination plane, row by row
+   * @param dstWidth Destination width
+   * @param dstHeight Destination height
+   */
+  static void resamplePlane(const float *src, int srcWidth, int srcHeight,
+                            float *dst, int dstWidth, int dstHeight) {
+    if (srcWidth == dstWidth && srcHeight == dstHeight) {
+      std::copy(src, src + static_cast<size_t>(srcWidth) * srcHeight, dst);
+      return;
+    }
+
+    // Column taps are the same for every row
+    std::vector<int> x0(dstWidth), x1(dstWidth);
+    std::vector<float> fx(dstWidth);
+    for (int x = 0; x < dstWidth; x++) {
+      sampleTaps(x, dstWidth, srcWidth, x0[x], x1[x], fx[x]);
+    }
+
+    for (int y = 0; y < dstHeight; y++) {
+      int y0 = 0, y1 = 0;
+      float fy = 0.0f;
+      sampleTaps(y, dstHeight, srcHeight, y0, y1, fy);
+      const float *row0 = src + static_cast<size_t>(y0) * srcWidth;
+      const float *row1 = src + static_cast<size_t>(y1) * srcWidth;
+      float *out = dst + static_cast<size_t>(y) * dstWidth;
+      for (int x = 0; x < dstWidth; x++) {
+        float top = row0[x0[x]] + (row0[x1[x]] - row0[x0[x]]) * fx[x];
+        float bottom = row1[x0[x]] + (row1[x1[x]] - row1[x0[x]]) * fx[x];
+        out[x] = top + (bottom - top) * fy;
+      }
+    }
+  }
+
+  /**
+   * Unpack one NCHW batch slot into an interleaved image, applying the same
+   * value handling as getTensorValue (NaN/Inf to zero, optional normalize).
+   * @param tensorData The tensor data
+   * @param width Tensor width
+   * @param height Tensor height
+   * @param channelCount Tensor channel count
+   * @param batchIndex Batch slot to read
+   * @param doNormalize Whether to normalize the output
+   * @param minValue Minimum value for normalization
+   * @param maxValue Maximum value for normalization
+   * @param pixels Destination interleaved pixels (width*height*channelCount)
+   */
+  static void NCHWToInterleaved(const float *tensorData, int width, int height,
+                                int channelCount, int batchIndex,
+                                bool doNormalize, float minValue,
+                                float maxValue, std::vector<float> &pixels) {
+    if (!tensorData || width <= 0 || height <= 0 || channelCount <= 0 ||
+        batchIndex < 0) {
+      throw std::invalid_argument("Invalid dimensions for tensor unpacking");
+    }
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    const float *batch =
+        tensorData + static_cast<size_t>(batchIndex) * channelCount * planeSize;
+    pixels.resize(planeSize * channelCount);
+
+    for (int c = 0; c < channelCount; c++) {
+      const float *src = batch + c * planeSize;
+      for (size_t i = 0; i < planeSize; i++) {
+        float value = src[i];
+        if (std::isnan(value) || std::isinf(value)) {
+          value = 0.0f;
+        } else if (doNormalize) {
+          value = normalize(value, minValue, maxValue);
+        }
+        pixels[i * channelCount + c] = value;
+      }
+    }
+  }
+
+  /**
+   * Unpack one NCHW batch slot into an interleaved image, normalizing each
+   * channel with its own range
+   * @param ranges One normalization range per channel
+   */
+  static void NCHWToInterleaved(const float *tensorData, int width, int height,
+                                int channelCount, int batchIndex,
+                                const std::vector<NormalizationRange> &ranges,
+                                std::vector<float> &pixels) {
+    if (!tensorData || width <= 0 || height <= 0 || channelCount <= 0 ||
+        batchIndex < 0 || static_cast<int>(ranges.size()) < channelCount) {
+      throw std::invalid_argument("Invalid dimensions for tensor unpacking");
+    }
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    const float *batch =
+        tensorData + static_cast<size_t>(batchIndex) * channelCount * planeSize;
+    pixels.resize(planeSize * channelCount);
+
+    std::vector<float> row(width);
+    for (int c = 0; c < channelCount; c++) {
+      for (int y = 0; y < height; y++) {
+        size_t offset = static_cast<size_t>(y) * width;
+        normalizeRow(batch + c * planeSize + offset, row.data(), width,
+                     ranges[c]);
+        for (int x = 0; x < width; x++) {
+          pixels[(offset + x) * channelCount + c] = row[x];
+        }
+      }
+    }
+  }
+
+  /**
+   * Find minimum and maximum values in a tensor. NaN and Inf are ignored.
+   * Large tensors are reduced in parallel chunks.
    * @param tensorData The tensor data
    * @param minValue Output minimum value found
    * @param maxValue Output maximum value found
@@ -37,18 +546,10 @@ public:
       return;
     }
 
-    minValue = std::numeric_limits<float>::max();
-    maxValue = std::numeric_limits<float>::lowest();
-
-    for (const float &value : tensorData) {
-      // Check for NaN or Inf values
-      if (std::isnan(value) || std::isinf(value)) {
-        continue; // Skip invalid values
-      }
-
-      minValue = std::min(minValue, value);
-      maxValue = std::max(maxValue, value);
-    }
+    std::vector<MinMax> ranges = reduceFiniteRanges(
+        tensorData.data(), tensorData.size(), tensorData.size());
+    minValue = ranges[0].min;
+    maxValue = ranges[0].max;
 
     // Prevent division by zero in normalization
     if (minValue == maxValue || std::isnan(minValue) || std::isinf(minValue) ||
@@ -59,7 +560,136 @@ public:
   }
 
   /**
-   * Find min and max values for multi-channel tensors
+   * Normalization bounds from the statistics of a copied output, with the
+   * same fallbacks as findMinMax (single channel) and findMinMaxMultiChannel
+   * @param statistics Statistics collected by copyOutput
+   * @param firstChannel First plane to include, e.g. batchIndex * channels
+   * @param channelCount Number of planes to include
+   * @param isSingleChannel Use the single-channel fallbacks
+   * @param minValue Output minimum value found
+   * @param maxValue Output maximum value found
+   */
+  static void findMinMax(const OutputStatistics &statistics,
+                         size_t firstChannel, size_t channelCount,
+                         bool isSingleChannel, float &minValue,
+                         float &maxValue) {
+    MinMax range = statistics.range(firstChannel, channelCount);
+    minValue = range.min;
+    maxValue = range.max;
+
+    if (minValue == std::numeric_limits<float>::max() ||
+        maxValue == std::numeric_limits<float>::lowest()) {
+      minValue = 0.0f;
+      maxValue = 1.0f;
+    } else if (minValue == maxValue) {
+      if (isSingleChannel) {
+        minValue = 0.0f;
+        maxValue = 1.0f;
+      } else {
+        maxValue = minValue + 1.0f;
+      }
+    }
+  }
+
+  /**
+   * Copy a model output out of the ONNX Runtime buffer. With statistics,
+   * NaN and Inf are written as 0 and the per-plane ranges, mean and
+   * histogram are collected in the same parallel pass, so normalization
+   * does not need to read the output a second time.
+   * @param src Output data owned by ONNX Runtime
+   * @param dst Destination, count values; may be src to scan in place
+   * @param count Number of values
+   * @param shape Output shape; planes span the last two dimensions
+   * @param statistics Filled in when not null
+   */
+  static void copyOutput(const float *src, float *dst, size_t count,
+                         const std::vector<int64_t> &shape,
+                         OutputStatistics *statistics) {
+    if (!statistics) {
+      if (src != dst) {
+        std::copy(src, src + count, dst);
+      }
+      return;
+    }
+
+    size_t planeSize = count;
+    if (shape.size() >= 2 && shape[shape.size() - 1] > 0 &&
+        shape[shape.size() - 2] > 0) {
+      planeSize = std::min(count, static_cast<size_t>(shape[shape.size() - 1] *
+                                                      shape[shape.size() - 2]));
+    }
+    planeSize = std::max<size_t>(planeSize, 1);
+    size_t planeCount = (count + planeSize - 1) / planeSize;
+
+    struct Chunk {
+      size_t plane;
+      size_t begin;
+      size_t end;
+      CopyTotals totals;
+      std::vector<uint32_t> histogram;
+    };
+    std::vector<Chunk> chunks;
+    for (size_t p = 0; p < planeCount; p++) {
+      size_t planeEnd = std::min(count, (p + 1) * planeSize);
+      for (size_t begin = p * planeSize; begin < planeEnd;
+           begin += kReduceChunkSize) {
+        chunks.push_back(Chunk{p, begin,
+                               std::min(planeEnd, begin + kReduceChunkSize),
+                               CopyTotals(), std::vector<uint32_t>()});
+      }
+    }
+
+    // Sampling is decided per plane, so every chunk of the histogram
+    // carries the same weight, including a plane's short last chunk
+    bool sampled = planeSize >= kHistogramSampleFrom;
+    parallelFor(chunks.size(), [&](size_t i) {
+      Chunk &chunk = chunks[i];
+      chunk.histogram.assign(OutputStatistics::kHistogramBins, 0);
+      chunk.totals = copyFinite(src + chunk.begin, dst + chunk.begin,
+                                chunk.end - chunk.begin,
+                                chunk.histogram.data(), sampled);
+    });
+
+    // Merge in order, as reduceFiniteRanges does
+    OutputStatistics &stats = *statistics;
+    stats.elementCount = count;
+    stats.planeSize = planeSize;
+    stats.channels.assign(planeCount,
+                          MinMax{std::numeric_limits<float>::max(),
+                                 std::numeric_limits<float>::lowest()});
+    stats.histogram.assign(OutputStatistics::kHistogramBins, 0);
+    stats.finiteCount = 0;
+    double sum = 0.0;
+    for (const Chunk &chunk : chunks) {
+      MinMax &range = stats.channels[chunk.plane];
+      range.min = std::min(range.min, chunk.totals.range.min);
+      range.max = std::max(range.max, chunk.totals.range.max);
+      sum += chunk.totals.sum;
+      stats.finiteCount += chunk.totals.finite;
+      for (size_t b = 0; b < OutputStatistics::kHistogramBins; b++) {
+        stats.histogram[b] += chunk.histogram[b];
+      }
+    }
+
+    // Pick the signed zero a sequential scan would have kept
+    for (size_t p = 0; p < planeCount; p++) {
+      MinMax &range = stats.channels[p];
+      if (range.min == 0.0f || range.max == 0.0f) {
+        size_t planeEnd = std::min(count, (p + 1) * planeSize);
+        const float *zero =
+            std::find(src + p * planeSize, src + planeEnd, 0.0f);
+        range.min = range.min == 0.0f ? *zero : range.min;
+        range.max = range.max == 0.0f ? *zero : range.max;
+      }
+    }
+    stats.replacedCount = count - stats.finiteCount;
+    stats.mean = stats.finiteCount > 0 ? sum / stats.finiteCount : 0.0;
+  }
+
+  /**
+   * Find min and max values for multi-channel tensors. Each channel is
+   * reduced separately (in one parallel pass) and the channel ranges are
+   * merged.
    * @param tensorData The tensor data
    * @param minValue Output minimum value found
    * @param maxValue Output maximum value found
@@ -80,33 +710,18 @@ public:
     maxValue = std::numeric_limits<float>::lowest();
     size_t pointsPerChannel = static_cast<size_t>(width * height);
 
-    // Find min and max across all channels
-    for (int c = 0; c < channelCount; c++) {
-      size_t startIdx = c * pointsPerChannel;
-      size_t endIdx = std::min(startIdx + pointsPerChannel, tensorData.size());
+    // Channels past the end of the data are skipped; the last one may be
+    // partial
+    size_t available = std::min(tensorData.size(),
+                                pointsPerChannel * channelCount);
+    std::vector<MinMax> channelRanges = reduceFiniteRanges(
+        tensorData.data(), available, pointsPerChannel);
 
-      // Skip if out of bounds
-      if (startIdx >= tensorData.size())
-        continue;
-
-      // Find min/max for this channel
-      float channelMin = std::numeric_limits<float>::max();
-      float channelMax = std::numeric_limits<float>::lowest();
-
-      for (size_t i = startIdx; i < endIdx; i++) {
-        // Check for NaN or Inf values
-        if (std::isnan(tensorData[i]) || std::isinf(tensorData[i])) {
-          continue; // Skip invalid values
-        }
-
-        channelMin = std::min(channelMin, tensorData[i]);
-        channelMax = std::max(channelMax, tensorData[i]);
-      }
-
-      if (channelMin != std::numeric_limits<float>::max() &&
-          channelMax != std::numeric_limits<float>::lowest()) {
-        minValue = std::min(minValue, channelMin);
-        maxValue = std::max(maxValue, channelMax);
+    for (const MinMax &channel : channelRanges) {
+      if (channel.min != std::numeric_limits<float>::max() &&
+          channel.max != std::numeric_limits<float>::lowest()) {
+        minValue = std::min(minValue, channel.min);
+        maxValue = std::max(maxValue, channel.max);
       }
     }
 
@@ -124,6 +739,236 @@ public:
     }
   }
 
+  /**
+   * Compute a normalization range for every output channel in one parallel
+   * pass. In per-layer mode, channels are grouped by layerSizes and each
+   * group shares the range of all its channels; global mode gives every
+   * channel the merged range. Ranges without finite values fall back to
+   * 0-1, and flat ranges to min..min+1, as findMinMaxMultiChannel does.
+   * @param tensorData The tensor data
+   * @param channelCount Number of channels
+   * @param width Width of the tensor
+   * @param height Height of the tensor
+   * @param mode The NormalizeMode
+   * @param layerSizes Channels per layer for kNormalizePerLayer, e.g. "3 1"
+   * @return One range per channel
+   */
+  static std::vector<NormalizationRange>
+  computeNormalizationRanges(const std::vector<float> &tensorData,
+                             int channelCount, int width, int height,
+                             NormalizeMode mode,
+                             const std::string &layerSizes = "") {
+    if (width <= 0 || height <= 0 || channelCount <= 0) {
+      return std::vector<NormalizationRange>();
+    }
+
+    size_t pointsPerChannel = static_cast<size_t>(width) * height;
+    size_t available = std::min(tensorData.size(),
+                                pointsPerChannel * channelCount);
+    std::vector<MinMax> channels;
+    if (available > 0) {
+      channels = reduceFiniteRanges(tensorData.data(), available,
+                                    pointsPerChannel);
+    }
+    return normalizationRanges(channels, channelCount, mode, layerSizes);
+  }
+
+  /**
+   * Normalization ranges from finite per-channel ranges that are already
+   * known, e.g. OutputStatistics::channels
+   * @param channels Finite range of each channel; missing channels have no
+   *                 values
+   * @param channelCount Number of channels
+   * @param mode The NormalizeMode
+   * @param layerSizes Channels per layer for kNormalizePerLayer
+   * @return One range per channel
+   */
+  static std::vector<NormalizationRange>
+  normalizationRanges(const std::vector<MinMax> &channels, int channelCount,
+                      NormalizeMode mode, const std::string &layerSizes = "") {
+    if (channelCount <= 0) {
+      return std::vector<NormalizationRange>();
+    }
+
+    std::vector<int> layerOf = channelLayers(mode, layerSizes, channelCount);
+    int layerCount = *std::max_element(layerOf.begin(), layerOf.end()) + 1;
+
+    // Merge channel extremes into their layers
+    std::vector<MinMax> layers(
+        layerCount, MinMax{std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::lowest()});
+    for (size_t c = 0; c < channels.size() && c < layerOf.size(); c++) {
+      MinMax &layer = layers[layerOf[c]];
+      layer.min = std::min(layer.min, channels[c].min);
+      layer.max = std::max(layer.max, channels[c].max);
+    }
+
+    std::vector<NormalizationRange> ranges(channelCount);
+    for (int c = 0; c < channelCount; c++) {
+      const MinMax &layer = layers[layerOf[c]];
+      if (layer.min == std::numeric_limits<float>::max() ||
+          layer.max == std::numeric_limits<float>::lowest()) {
+        ranges[c] = NormalizationRange(0.0f, 1.0f);
+      } else if (layer.min == layer.max) {
+        ranges[c] = NormalizationRange(layer.min, layer.min + 1.0f);
+      } else {
+        ranges[c] = NormalizationRange(layer.min, layer.max);
+      }
+    }
+    return ranges;
+  }
+
+  /**
+   * Map each channel to its normalization group
+   * @param mode The NormalizeMode
+   * @param layerSizes Whitespace or comma separated channel counts per layer;
+   *                   channels not covered form one final layer
+   * @param channelCount Number of channels
+   * @return Group index per channel
+   */
+  static std::vector<int> channelLayers(NormalizeMode mode,
+                                        const std::string &layerSizes,
+                                        int channelCount) {
+    std::vector<int> layerOf(std::max(0, channelCount), 0);
+    if (mode == kNormalizePerChannel) {
+      for (int c = 0; c < channelCount; c++) {
+        layerOf[c] = c;
+      }
+    } else if (mode == kNormalizePerLayer) {
+      std::string sizes = layerSizes;
+      std::replace(sizes.begin(), sizes.end(), ',', ' ');
+      std::istringstream stream(sizes);
+      int layer = 0;
+      int channel = 0;
+      std::string token;
+      while (stream >> token && channel < channelCount) {
+        char *end = nullptr;
+        long size = std::strtol(token.c_str(), &end, 10);
+        if (*end != '\0' || size <= 0) {
+          throw std::invalid_argument("Invalid layer size '" + token +
+                                      "'; expected positive channel counts");
+        }
+        for (long i = 0; i < size && channel < channelCount; i++) {
+          layerOf[channel++] = layer;
+        }
+        layer++;
+      }
+      for (; channel < channelCount; channel++) {
+        layerOf[channel] = layer;
+      }
+    }
+    return layerOf;
+  }
+
+  /**
+   * Normalize a run of values with a precomputed range. NaN and Inf become
+   * 0, as in getTensorValue; finite values are clamped to the range.
+   * @param src Source values
+   * @param dst Destination values
+   * @param count Number of values
+   * @param range The channel's normalization range
+   */
+  static void normalizeRow(const float *src, float *dst, int count,
+                           const NormalizationRange &range) {
+    for (int i = 0; i < count; i++) {
+      float value = src[i];
+      float clamped = std::max(range.min, std::min(range.max, value));
+      dst[i] = isFiniteBits(value) ? clamped * range.scale + range.offset
+                                   : 0.0f;
+    }
+  }
+
+  /**
+   * Run task(0) ... task(taskCount - 1) on the calling thread and the
+   * process's shared WorkerPool
+   * @param taskCount Number of tasks
+   * @param task Function called once per task index; must not throw
+   */
+  static void parallelFor(size_t taskCount,
+                          const std::function<void(size_t)> &task) {
+    WorkerPool::instance().run(taskCount, task);
+  }
+
+  /**
+   * Raw value a channel must exceed for its normalized value to exceed a
+   * threshold
+   * @param range The channel's normalization range
+   * @param threshold Threshold on the normalized value
+   */
+  static float normalizedThreshold(const NormalizationRange &range,
+                                   float threshold) {
+    if (range.scale > 0.0f) {
+      return (threshold - range.offset) / range.scale;
+    }
+    // Degenerate range: every value normalizes to the offset
+    return range.offset > threshold ? -std::numeric_limits<float>::infinity()
+                                    : std::numeric_limits<float>::infinity();
+  }
+
+  /**
+   * Bounds of the pixels of an NCHW output where any channel exceeds its
+   * threshold, e.g. the region a matte covers
+   * @param data Output values, channels planes of width x height
+   * @param thresholds Value each channel must exceed, one per channel
+   * @param magnitude Whether the magnitude of a value is compared, so that
+   *        negative values count too
+   * @param x,y,r,t Set to the bounds, r and t exclusive
+   * @return false, leaving the bounds unchanged, if no pixel exceeds its
+   *         threshold
+   */
+  static bool contentBounds(const float *data, int width, int height,
+                            const std::vector<float> &thresholds,
+                            bool magnitude, int &x, int &y, int &r, int &t) {
+    if (!data || width <= 0 || height <= 0) {
+      return false;
+    }
+
+    // Leftmost and rightmost pixel above threshold in each row, or -1
+    size_t planeSize = static_cast<size_t>(width) * height;
+    std::vector<std::pair<int, int>> rows(height, std::make_pair(-1, -1));
+    parallelFor(height, [&](size_t row) {
+      int left = width, right = -1;
+      for (size_t c = 0; c < thresholds.size(); c++) {
+        const float *values = data + c * planeSize + row * width;
+        float threshold = thresholds[c];
+        for (int i = 0; i < left; i++) {
+          float value = magnitude ? std::fabs(values[i]) : values[i];
+          if (value > threshold) {
+            left = i;
+            break;
+          }
+        }
+        for (int i = width - 1; i > right && i >= left; i--) {
+          float value = magnitude ? std::fabs(values[i]) : values[i];
+          if (value > threshold) {
+            right = i;
+            break;
+          }
+        }
+      }
+      if (right >= 0) {
+        rows[row] = std::make_pair(left, right);
+      }
+    });
+
+    bool found = false;
+    for (int row = 0; row < height; row++) {
+      if (rows[row].second < 0) {
+        continue;
+      }
+      if (!found) {
+        x = rows[row].first;
+        r = rows[row].second + 1;
+        y = row;
+        found = true;
+      }
+      x = std::min(x, rows[row].first);
+      r = std::max(r, rows[row].second + 1);
+      t = row + 1;
+    }
+    return found;
+  }
+
   /**
    * Normalize a value to the range [0, 1]
    * @param value The value to normalize
@@ -166,8 +1011,21 @@ public:
                               int y, int channelIdx, int width, int height,
                               bool isSingleChannel, bool doNormalize,
                               float minValue, float maxValue) {
+    return getTensorValue(tensorData.data(), tensorData.size(), x, y,
+                          channelIdx, width, height, isSingleChannel,
+                          doNormalize, minValue, maxValue);
+  }
+
+  /**
+   * Get tensor value with bounds checking, from a buffer of tensorSize values
+   */
+  static float getTensorValue(const float *tensorData, size_t tensorSize,
+                              int x, int y, int channelIdx, int width,
+                              int height, bool isSingleChannel,
+                              bool doNormalize, float minValue,
+                              float maxValue) {
     // Validate parameters
-    if (tensorData.empty() || width <= 0 || height <= 0) {
+    if (!tensorData || tensorSize == 0 || width <= 0 || height <= 0) {
       return 0.0f;
     }
 
@@ -183,13 +1041,13 @@ public:
     } else {
       // Multi-channel mode (NCHW format)
       size_t offset = channelIdx * height * width;
-      if (offset >= tensorData.size()) {
+      if (offset >= tensorSize) {
         return 0.0f;
       }
       dataIndex = offset + y * width + x;
     }
 
-    if (dataIndex >= 0 && dataIndex < static_cast<int>(tensorData.size())) {
+    if (dataIndex >= 0 && static_cast<size_t>(dataIndex) < tensorSize) {
       float value = tensorData[dataIndex];
 
       // Check for NaN or Inf
@@ -202,4 +1060,263 @@ public:
 
     return 0.0f;
   }
+
+  // Elements reduced per parallel task; small tensors stay on one thread
+  static constexpr size_t kReduceChunkSize = 1 << 18;
+
+  /**
+   * Reduce consecutive ranges of rangeSize values (the last may be shorter)
+   * to their finite min/max in one parallel pass. Results match a sequential
+   * std::min/std::max scan exactly, including which signed zero is returned.
+   * @param data The values
+   * @param count Number of values
+   * @param rangeSize Values per range, e.g. one channel plane
+   * @return One MinMax per range
+   */
+  static std::vector<MinMax> reduceFiniteRanges(const float *data,
+                                                size_t count,
+                                                size_t rangeSize) {
+    size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+
+    // Split each range into chunks so one pass covers every channel
+    struct Chunk {
+      size_t range;
+      size_t begin;
+      size_t end;
+    };
+    std::vector<Chunk> chunks;
+    for (size_t r = 0; r < rangeCount; r++) {
+      size_t rangeEnd = std::min(count, (r + 1) * rangeSize);
+      for (size_t begin = r * rangeSize; begin < rangeEnd;
+           begin += kReduceChunkSize) {
+        chunks.push_back(
+            Chunk{r, begin, std::min(rangeEnd, begin + kReduceChunkSize)});
+      }
+    }
+
+    std::vector<MinMax> partials(chunks.size());
+    parallelFor(chunks.size(), [&](size_t i) {
+      partials[i] = reduceFinite(data + chunks[i].begin,
+                                 chunks[i].end - chunks[i].begin);
+    });
+
+    // Merge in order; std::min/max keep the earlier of equal values
+    std::vector<MinMax> ranges(
+        rangeCount, MinMax{std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::lowest()});
+    for (size_t i = 0; i < chunks.size(); i++) {
+      MinMax &range = ranges[chunks[i].range];
+      range.min = std::min(range.min, partials[i].min);
+      range.max = std::max(range.max, partials[i].max);
+    }
+
+    // Lane-wise minimums lose track of which zero came first: -0.0 and 0.0
+    // compare equal, and a sequential scan keeps the first one it meets
+    for (size_t r = 0; r < rangeCount; r++) {
+      MinMax &range = ranges[r];
+      if (range.min == 0.0f || range.max == 0.0f) {
+        size_t begin = r * rangeSize;
+        size_t end = std::min(count, begin + rangeSize);
+        const float *zero =
+            std::find(data + begin, data + end, 0.0f); // Matches -0.0 too
+        if (range.min == 0.0f) {
+          range.min = *zero;
+        }
+        if (range.max == 0.0f) {
+          range.max = *zero;
+        }
+      }
+    }
+    return ranges;
+  }
+
+private:
+  // Source taps and weight of destination pixel i when resampling a line of
+  // srcSize pixels to dstSize, matching pixel centres
+  static void sampleTaps(int i, int dstSize, int srcSize, int &i0, int &i1,
+                         float &weight) {
+    float position =
+        (i + 0.5f) * static_cast<float>(srcSize) / dstSize - 0.5f;
+    position = std::max(0.0f, std::min(position, srcSize - 1.0f));
+    i0 = static_cast<int>(position);
+    i1 = std::min(i0 + 1, srcSize - 1);
+    weight = position - i0;
+  }
+
+  // Totals of one block copied by copyFinite
+  struct CopyTotals {
+    MinMax range;
+    double sum;
+    size_t finite;
+
+    CopyTotals()
+        : range{std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::lowest()},
+          sum(0.0), finite(0) {}
+  };
+
+  /**
+   * Copy a block, writing NaN and Inf as 0, while accumulating the finite
+   * range, sum and histogram of the values
+   * @param histogram OutputStatistics::kHistogramBins counts to add to
+   * @param sampled Whether the histogram only samples the block
+   */
+  static CopyTotals copyFinite(const float *src, float *dst, size_t count,
+                               uint32_t *histogram, bool sampled) {
+    CopyTotals totals;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i exponentMask = _mm_set1_epi32(0x7F800000);
+    const __m128i signBit = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const int bucketShift = 23 - OutputStatistics::kHistogramMantissaBits;
+    __m128 lo = _mm_set1_ps(totals.range.min);
+    __m128 hi = _mm_set1_ps(totals.range.max);
+    __m128i nonFinite = _mm_setzero_si128(); // Lanes count down by one
+    size_t vectorEnd = count & ~size_t(3);
+    while (i < vectorEnd) {
+      // Float partial sums, flushed to double every block to keep precision
+      __m128 partial = _mm_setzero_ps();
+      size_t blockEnd = std::min(vectorEnd, i + 1024);
+      for (; i < blockEnd; i += 4) {
+        __m128i bits =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i bad = _mm_cmpeq_epi32(_mm_and_si128(bits, exponentMask),
+                                      exponentMask);
+        __m128 value = _mm_castsi128_ps(_mm_andnot_si128(bad, bits));
+        _mm_storeu_ps(dst + i, value);
+        __m128 badMask = _mm_castsi128_ps(bad);
+        lo = _mm_min_ps(lo, _mm_or_ps(_mm_and_ps(badMask, lo),
+                                      _mm_andnot_ps(badMask, value)));
+        hi = _mm_max_ps(hi, _mm_or_ps(_mm_and_ps(badMask, hi),
+                                      _mm_andnot_ps(badMask, value)));
+        partial = _mm_add_ps(partial, value);
+        nonFinite = _mm_add_epi32(nonFinite, bad);
+
+        if (sampledForHistogram(i, sampled)) {
+          // Order-preserving keys: flip negatives, set the sign of positives
+          __m128i key = _mm_xor_si128(
+              bits, _mm_or_si128(_mm_srai_epi32(bits, 31), signBit));
+          int32_t buckets[4], flags[4];
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(buckets),
+                           _mm_srli_epi32(key, bucketShift));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(flags), bad);
+          for (int lane = 0; lane < 4; lane++) {
+            histogram[buckets[lane]] += 1 + flags[lane]; // Flags are 0 or -1
+          }
+        }
+      }
+      float sums[4];
+      _mm_storeu_ps(sums, partial);
+      totals.sum += (static_cast<double>(sums[0]) + sums[1]) +
+                    (static_cast<double>(sums[2]) + sums[3]);
+    }
+    float lanes[8];
+    _mm_storeu_ps(lanes, lo);
+    _mm_storeu_ps(lanes + 4, hi);
+    totals.range.min = *std::min_element(lanes, lanes + 4);
+    totals.range.max = *std::max_element(lanes + 4, lanes + 8);
+    int32_t counts[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(counts), nonFinite);
+    totals.finite = vectorEnd + counts[0] + counts[1] + counts[2] + counts[3];
+#endif
+
+    for (; i < count; i++) {
+      float value = src[i];
+      if (isFiniteBits(value)) {
+        dst[i] = value;
+        totals.range.min = std::min(totals.range.min, value);
+        totals.range.max = std::max(totals.range.max, value);
+        totals.sum += value;
+        totals.finite++;
+        if (sampledForHistogram(i, sampled)) {
+          histogram[OutputStatistics::bucketOf(value)]++;
+        }
+      } else {
+        dst[i] = 0.0f;
+      }
+    }
+    return totals;
+  }
+
+  // In planes of at least kHistogramSampleFrom values, the histogram takes
+  // one run of four values in every kHistogramStride; scattered counter
+  // updates would otherwise cost more than the rest of the copy
+  static constexpr size_t kHistogramStride = 32;
+  static constexpr size_t kHistogramSampleFrom = 1 << 16;
+  static bool sampledForHistogram(size_t index, bool sampled) {
+    return !sampled || index % kHistogramStride < 4;
+  }
+
+  /**
+   * Finite min/max of a contiguous block, without per-element branches.
+   * Non-finite values are masked by their exponent bits.
+   */
+  static MinMax reduceFinite(const float *data, size_t count) {
+    const float kMax = std::numeric_limits<float>::max();
+    const float kLowest = std::numeric_limits<float>::lowest();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i exponentMask = _mm_set1_epi32(0x7F800000);
+    __m128 lo0 = _mm_set1_ps(kMax), lo1 = lo0;
+    __m128 hi0 = _mm_set1_ps(kLowest), hi1 = hi0;
+    for (; i + 8 <= count; i += 8) {
+      __m128 v0 = _mm_loadu_ps(data + i);
+      __m128 v1 = _mm_loadu_ps(data + i + 4);
+      // All exponent bits set means NaN or Inf
+      __m128 bad0 = _mm_castsi128_ps(_mm_cmpeq_epi32(
+          _mm_and_si128(_mm_castps_si128(v0), exponentMask), exponentMask));
+      __m128 bad1 = _mm_castsi128_ps(_mm_cmpeq_epi32(
+          _mm_and_si128(_mm_castps_si128(v1), exponentMask), exponentMask));
+      lo0 = _mm_min_ps(lo0, _mm_or_ps(_mm_and_ps(bad0, lo0),
+                                      _mm_andnot_ps(bad0, v0)));
+      lo1 = _mm_min_ps(lo1, _mm_or_ps(_mm_and_ps(bad1, lo1),
+                                      _mm_andnot_ps(bad1, v1)));
+      hi0 = _mm_max_ps(hi0, _mm_or_ps(_mm_and_ps(bad0, hi0),
+                                      _mm_andnot_ps(bad0, v0)));
+      hi1 = _mm_max_ps(hi1, _mm_or_ps(_mm_and_ps(bad1, hi1),
+                                      _mm_andnot_ps(bad1, v1)));
+    }
+    float lanes[8];
+    _mm_storeu_ps(lanes, _mm_min_ps(lo0, lo1));
+    MinMax result{std::min(std::min(lanes[0], lanes[1]),
+                           std::min(lanes[2], lanes[3])),
+                  kLowest};
+    _mm_storeu_ps(lanes + 4, _mm_max_ps(hi0, hi1));
+    result.max = std::max(std::max(lanes[4], lanes[5]),
+                          std::max(lanes[6], lanes[7]));
+#else
+    // Independent accumulators let the compiler vectorize the loop
+    const int kLanes = 8;
+    float lo[kLanes], hi[kLanes];
+    std::fill(lo, lo + kLanes, kMax);
+    std::fill(hi, hi + kLanes, kLowest);
+    for (; i + kLanes <= count; i += kLanes) {
+      for (int lane = 0; lane < kLanes; lane++) {
+        float value = data[i + lane];
+        bool finite = isFiniteBits(value);
+        lo[lane] = finite && value < lo[lane] ? value : lo[lane];
+        hi[lane] = finite && value > hi[lane] ? value : hi[lane];
+      }
+    }
+    MinMax result{*std::min_element(lo, lo + kLanes),
+                  *std::max_element(hi, hi + kLanes)};
+#endif
+
+    for (; i < count; i++) {
+      if (isFiniteBits(data[i])) {
+        result.min = std::min(result.min, data[i]);
+        result.max = std::max(result.max, data[i]);
+      }
+    }
+    return result;
+  }
+
+  // NaN and Inf have every exponent bit set
+  static bool isFiniteBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7F800000u) != 0x7F800000u;
+  }
 };
\ No newline at end of file
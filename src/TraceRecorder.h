@@ -0,0 +1,380 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/**
+ * Trace - Optional timeline of the inference pipeline
+ *
+ * When ONNX_NUKE_TRACE_FILE is set, spans recorded from any thread are written
+ * to that file as Chrome trace-event JSON when the process exits (or when
+ * Recorder::write() is called). The file opens directly in Perfetto
+ * (ui.perfetto.dev) or chrome://tracing. "{pid}" in the path is replaced by
+ * the process id. When tracing is off, a span costs one atomic load.
+ */
+namespace Trace {
+
+// Environment variable naming the trace file
+const char *const kFileEnvVar = "ONNX_NUKE_TRACE_FILE";
+
+// Event categories, shown as "cat" in the trace viewer
+const char *const kCategoryPipeline = "pipeline";
+const char *const kCategoryLock = "lock";
+const char *const kCategoryRuntime = "onnxruntime";
+const char *const kCategoryEngine = "engine";
+
+/**
+ * Collects trace events in per-thread buffers and writes them as JSON
+ */
+class Recorder {
+public:
+  static Recorder &instance() {
+    static Recorder recorder;
+    return recorder;
+  }
+
+  bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Microseconds since the recorder started
+   */
+  double now() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - _start)
+        .count();
+  }
+
+  /**
+   * Record a finished span on the calling thread
+   * @param category Event category (one of the kCategory constants)
+   * @param name Span name
+   * @param start Start time from now()
+   * @param end End time from now()
+   * @param args Optional body of the JSON "args" object, e.g. "\"input\": 1"
+   */
+  void complete(const char *category, const std::string &name, double start,
+                double end, const std::string &args = std::string()) {
+    if (!enabled() || !reserveEvent()) {
+      return;
+    }
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(Event{category, name, start, end - start, args});
+  }
+
+  /**
+   * Record one row served by engine(). Consecutive rows served by the same
+   * node on the same thread are merged into a single "engine rows" span.
+   * @param node The operator serving the row
+   * @param y The row index
+   */
+  void rowServed(const void *node, int y, double start, double end) {
+    if (!enabled()) {
+      return;
+    }
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    RowBatch &batch = buffer.rows;
+    bool adjacent = batch.count > 0 && batch.node == node &&
+                    (y == batch.lastY + 1 || y == batch.lastY - 1) &&
+                    start - batch.end < kRowBatchGapMicros;
+    if (!adjacent) {
+      flushRows(buffer);
+      batch.node = node;
+      batch.firstY = y;
+      batch.start = start;
+    }
+    batch.lastY = y;
+    batch.end = end;
+    batch.count++;
+  }
+
+  /**
+   * Write every event recorded so far
+   * @param path Destination file
+   * @return True if the file was written
+   */
+  bool write(const std::string &path) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+      std::lock_guard<std::mutex> lock(_buffersMutex);
+      buffers = _buffers;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+      std::cerr << "Trace: cannot write " << path << std::endl;
+      return false;
+    }
+
+    // Microsecond timestamps keep nanosecond precision over long sessions
+    file << std::fixed << std::setprecision(3);
+
+    long pid = static_cast<long>(getpid());
+    file << "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": "
+         << _dropped.load() << "}, \"traceEvents\": [\n";
+    file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid
+         << ", \"tid\": 0, \"args\": {\"name\": \"ONNX Nuke (" << pid
+         << ")\"}}";
+
+    for (const auto &buffer : buffers) {
+      std::lock_guard<std::mutex> lock(buffer->mutex);
+      flushRows(*buffer);
+
+      file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+           << ", \"tid\": " << buffer->tid << ", \"args\": {\"name\": \""
+           << escape(buffer->name) << "\"}}";
+      for (const Event &event : buffer->events) {
+        file << ",\n{\"name\": \"" << escape(event.name) << "\", \"cat\": \""
+             << event.category << "\", \"ph\": \"X\", \"ts\": " << event.start
+             << ", \"dur\": " << event.duration << ", \"pid\": " << pid
+             << ", \"tid\": " << buffer->tid;
+        if (!event.args.empty()) {
+          file << ", \"args\": {" << event.args << "}";
+        }
+        file << "}";
+      }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+  }
+
+  /**
+   * Escape a string for use inside a JSON string literal
+   */
+  static std::string escape(const std::string &text) {
+    std::string escaped;
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+        escaped += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char code[8];
+        std::snprintf(code, sizeof(code), "\\u%04x", c);
+        escaped += code;
+      } else {
+        escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  ~Recorder() {
+    _enabled.store(false);
+    if (!_path.empty()) {
+      write(_path);
+    }
+  }
+
+private:
+  struct Event {
+    const char *category;
+    std::string name;
+    double start;    // Microseconds
+    double duration; // Microseconds
+    std::string args;
+  };
+
+  // Rows served back to back, not yet turned into an event
+  struct RowBatch {
+    const void *node = nullptr;
+    int firstY = 0;
+    int lastY = 0;
+    int count = 0;
+    double start = 0.0;
+    double end = 0.0;
+  };
+
+  struct ThreadBuffer {
+    std::mutex mutex; // Only contended while the trace is written
+    long tid;
+    std::string name;
+    std::vector<Event> events;
+    RowBatch rows;
+  };
+
+  Recorder()
+      : _enabled(false), _start(std::chrono::steady_clock::now()),
+        _eventCount(0), _dropped(0) {
+    const char *path = std::getenv(kFileEnvVar);
+    if (!path || path[0] == '\0') {
+      return;
+    }
+    _path = path;
+    size_t token = _path.find("{pid}");
+    if (token != std::string::npos) {
+      _path.replace(token, 5, std::to_string(getpid()));
+    }
+    _enabled.store(true);
+  }
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  // Count an event against the budget; false once the budget is spent
+  bool reserveEvent() {
+    if (_eventCount.fetch_add(1, std::memory_order_relaxed) >= kMaxEvents) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // Turn the pending row batch into an event. Caller must hold buffer.mutex.
+  void flushRows(ThreadBuffer &buffer) {
+    RowBatch &batch = buffer.rows;
+    if (batch.count > 0 && reserveEvent()) {
+      std::ostringstream args;
+      args << "\"node\": \"" << batch.node << "\", \"rows\": " << batch.count
+           << ", \"first_y\": " << batch.firstY
+           << ", \"last_y\": " << batch.lastY;
+      buffer.events.push_back(Event{kCategoryEngine, "engine rows",
+                                    batch.start, batch.end - batch.start,
+                                    args.str()});
+    }
+    batch = RowBatch();
+  }
+
+  // The calling thread's buffer, created on first use
+  ThreadBuffer &threadBuffer() {
+    static thread_local ThreadBuffer *current = nullptr;
+    if (current) {
+      return *current;
+    }
+
+    std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+#ifdef __linux__
+    buffer->tid = static_cast<long>(syscall(SYS_gettid));
+#else
+    buffer->tid = static_cast<long>(_buffers.size() + 1);
+#endif
+    char name[64] = {0};
+#ifdef __linux__
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+    buffer->name = std::string(name[0] ? name : "thread") + " [" +
+                   std::to_string(buffer->tid) + "]";
+
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    _buffers.push_back(buffer);
+    current = buffer.get();
+    return *current;
+  }
+
+  // Upper bound on recorded events, so a forgotten trace cannot exhaust memory
+  static constexpr uint64_t kMaxEvents = 4000000;
+
+  // Rows further apart in time than this start a new engine batch
+  static constexpr double kRowBatchGapMicros = 1000.0;
+
+  std::atomic<bool> _enabled;
+  std::string _path;
+  std::chrono::steady_clock::time_point _start;
+  std::atomic<uint64_t> _eventCount;
+  std::atomic<uint64_t> _dropped;
+  std::mutex _buffersMutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+};
+
+/**
+ * Records the time from construction to end() or destruction as a span
+ */
+class Span {
+public:
+  Span(const char *category, const std::string &name)
+      : _recorder(Recorder::instance()), _active(_recorder.enabled()),
+        _category(category) {
+    if (_active) {
+      _name = name;
+      _start = _recorder.now();
+    }
+  }
+  ~Span() { end(); }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+  /**
+   * Attach an argument shown when the span is selected in the viewer
+   */
+  void arg(const char *key, int64_t value) {
+    if (_active) {
+      appendKey(key);
+      _args += std::to_string(value);
+    }
+  }
+  void arg(const char *key, const std::string &value) {
+    if (_active) {
+      appendKey(key);
+      _args += "\"" + Recorder::escape(value) + "\"";
+    }
+  }
+
+  /**
+   * Finish the span early
+   */
+  void end() {
+    if (_active) {
+      _active = false;
+      _recorder.complete(_category, _name, _start, _recorder.now(), _args);
+    }
+  }
+
+private:
+  void appendKey(const char *key) {
+    if (!_args.empty()) {
+      _args += ", ";
+    }
+    _args += std::string("\"") + key + "\": ";
+  }
+
+  Recorder &_recorder;
+  bool _active;
+  const char *_category;
+  std::string _name;
+  double _start = 0.0;
+  std::string _args;
+};
+
+/**
+ * Records one engine() row, merged into per-thread row batches
+ */
+class RowScope {
+public:
+  RowScope(const void *node, int y)
+      : _recorder(Recorder::instance()), _active(_recorder.enabled()),
+        _node(node), _y(y), _start(_active ? _recorder.now() : 0.0) {}
+  ~RowScope() {
+    if (_active) {
+      _recorder.rowServed(_node, _y, _start, _recorder.now());
+    }
+  }
+
+  RowScope(const RowScope &) = delete;
+  RowScope &operator=(const RowScope &) = delete;
+
+private:
+  Recorder &_recorder;
+  bool _active;
+  const void *_node;
+  int _y;
+  double _start;
+};
+
+} // namespace Trace
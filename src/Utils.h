@@ -5,6 +5,7 @@
 #include "DDImage/Row.h"
 #include "DDImage/Tile.h"
 #include "ErrorHandling.h"
+#include "InputTensorCache.h"
 #include "TensorProcessor.h"
 #include <algorithm>
 #include <functional>
@@ -33,6 +34,19 @@ inline DD::Image::Tile extractTile(const DD::Image::Iop &input,
   return DD::Image::Tile(*nonConstInput, box, channels);
 }
 
+/**
+ * Fetch the whole format of an input into a tile the caller keeps, e.g.
+ * one per input while they are packed together
+ */
+inline std::unique_ptr<DD::Image::Tile>
+fetchTile(const DD::Image::Iop &input, DD::Image::ChannelSet channels) {
+  DD::Image::Format f = input.format();
+  DD::Image::Box box(f.x(), f.y(), f.r(), f.t());
+  DD::Image::Iop *nonConstInput = const_cast<DD::Image::Iop *>(&input);
+  return std::unique_ptr<DD::Image::Tile>(
+      new DD::Image::Tile(*nonConstInput, box, channels));
+}
+
 /**
  * Overload for pointer input for backward compatibility
  */
@@ -45,9 +59,59 @@ inline DD::Image::Tile extractTile(const DD::Image::Iop *input,
   return extractTile(*input, channels);
 }
 
+/**
+ * Copy one channel of a tile into a width x height plane, resampled if the
+ * tile is of another size (see TensorProcessor::resamplePlane). The plane
+ * is zero where the tile lacks the channel or a row.
+ */
+inline void tileChannelToPlane(const DD::Image::Tile &tile,
+                               DD::Image::Channel chan, float *plane,
+                               int width, int height) {
+  size_t planeSize = static_cast<size_t>(width) * height;
+  if (!(tile.channels() & DD::Image::ChannelSet(chan))) {
+    std::fill(plane, plane + planeSize, 0.0f);
+    return;
+  }
+
+  // Get the bounds from the tile's box
+  const DD::Image::Box &bounds = tile.box();
+  int xOffset = bounds.x();
+  int yOffset = bounds.y();
+
+  // A tile that is not at the plane size is gathered at the tile size and
+  // resampled
+  int tileWidth = bounds.w();
+  int tileHeight = bounds.h();
+  bool resample = tileWidth != width || tileHeight != height;
+  if (resample && (tileWidth <= 0 || tileHeight <= 0)) {
+    throw PreprocessException("Cannot resample an empty input tile");
+  }
+  std::vector<float> gathered;
+  float *rows = plane;
+  if (resample) {
+    gathered.resize(static_cast<size_t>(tileWidth) * tileHeight);
+    rows = gathered.data();
+  }
+
+  for (int h = 0; h < tileHeight; h++) {
+    const float *srcRow = tile[chan][h + yOffset];
+    float *row = rows + static_cast<size_t>(h) * tileWidth;
+    if (srcRow) {
+      std::copy(srcRow + xOffset, srcRow + xOffset + tileWidth, row);
+    } else {
+      std::fill(row, row + tileWidth, 0.0f);
+    }
+  }
+  if (resample) {
+    TensorProcessor::resamplePlane(gathered.data(), tileWidth, tileHeight,
+                                   plane, width, height);
+  }
+}
+
 /**
  * Convert a tile to NCHW tensor format (batch=1) maintaining original image
- * dimensions Format: [1, channels, height, width]
+ * dimensions Format: [1, channels, height, width]. A tile of another size is
+ * resampled to width x height (see TensorProcessor::resamplePlane).
  */
 inline void tileToNCHWTensor(const DD::Image::Tile &tile,
                              std::vector<float> &tensor, int width, int height,
@@ -62,11 +126,6 @@ inline void tileToNCHWTensor(const DD::Image::Tile &tile,
   // This preserves original behavior of passing actual dimensions to ONNX
   tensor.resize(1 * channels * height * width);
 
-  // Get the bounds from the tile's box
-  const DD::Image::Box &bounds = tile.box();
-  int xOffset = bounds.x();
-  int yOffset = bounds.y();
-
   // Extract each channel exactly as is from the image
   for (int c = 0; c < channels; c++) {
     DD::Image::Channel chan = DD::Image::Chan_Red;
@@ -89,32 +148,40 @@ inline void tileToNCHWTensor(const DD::Image::Tile &tile,
       continue; // Skip unsupported channels
     }
 
-    // Check if this channel exists in the tile
-    // Use Nuke's ChannelSet intersection to check for the channel
-    if (!(tile.channels() & DD::Image::ChannelSet(chan))) {
-      // Fill with zeros if channel is missing
-      size_t offset = c * height * width;
-      std::fill(tensor.begin() + offset,
-                tensor.begin() + offset + height * width, 0.0f);
-      continue;
-    }
-
-    // Copy data for this channel - preserving exact dimensions
-    for (int h = 0; h < height; h++) {
-      const float *srcRow = tile[chan][h + yOffset];
-      if (!srcRow)
-        continue;
-
-      for (int w = 0; w < width; w++) {
-        // NCHW format index: n * CHW + c * HW + h * W + w
-        // With n = 0 (batch size 1)
-        size_t dstIdx = c * height * width + h * width + w;
-        tensor[dstIdx] = srcRow[w + xOffset];
-      }
-    }
+    tileChannelToPlane(tile, chan,
+                       tensor.data() + static_cast<size_t>(c) * height * width,
+                       width, height);
   }
 }
 
+/**
+ * Build the shared cache key for a tensor packed by tileToNCHWTensor
+ * @param input The upstream operator the tensor is packed from
+ * @param width Packed tensor width
+ * @param height Packed tensor height
+ * @param channels Packed tensor channel count (RGBA order)
+ * @return Key identifying the packed tensor across nodes
+ */
+inline InputTensorCache::Key makeInputTensorKey(const DD::Image::Iop &input,
+                                                int width, int height,
+                                                int channels) {
+  const DD::Image::Format &f = input.format();
+
+  InputTensorCache::Key key;
+  key.sourceHash = input.hash().value();
+  key.x = f.x();
+  key.y = f.y();
+  key.r = f.r();
+  key.t = f.t();
+  key.width = width;
+  key.height = height;
+  key.channels = channels;
+  key.channelMapping = std::string("rgba").substr(
+      0, static_cast<size_t>(std::max(0, std::min(channels, 4))));
+  key.preprocess = "nchw_float32";
+  return key;
+}
+
 /**
  * Helper to get the channel component index from a channel name
  * Returns: 0 for red/x, 1 for green/y, 2 for blue/z, 3 for alpha/w, -1 for
@@ -150,14 +217,19 @@ inline int getChannelComponentIndex(DD::Image::Channel ch) {
 /**
  * Process a Nuke row from tensor data based on the format
  * (single/multi-channel)
+ * @param tensorData Output tensor, e.g. still in the ONNX Runtime buffer
+ * @param tensorSize Number of values in tensorData
+ * @param channelRanges Optional per-channel normalization ranges; when set,
+ *                      they replace minValue/maxValue
  */
-inline void
-processTensorDataToRow(const std::vector<float> &tensorData, int y, int x,
-                       int r, DD::Image::ChannelMask channels,
-                       DD::Image::Row &row, const DD::Image::Row &inputRow,
-                       int outputWidth, int outputHeight, int channelCount,
-                       bool isSingleChannel, bool normalize, float minValue,
-                       float maxValue) {
+inline void processTensorDataToRow(
+    const float *tensorData, size_t tensorSize, int y, int x, int r,
+    DD::Image::ChannelMask channels, DD::Image::Row &row,
+    const DD::Image::Row &inputRow, int outputWidth, int outputHeight,
+    int channelCount, bool isSingleChannel, bool normalize, float minValue,
+    float maxValue,
+    const std::vector<TensorProcessor::NormalizationRange> *channelRanges =
+        nullptr) {
   // Limit the end point to output width
   int endX = std::min(r, outputWidth);
 
@@ -186,6 +258,29 @@ processTensorDataToRow(const std::vector<float> &tensorData, int y, int x,
     }
   };
 
+  // Fill from one tensor channel, using the per-channel row kernel when the
+  // whole span lies inside the tensor
+  auto fillFromTensor = [&](float *outPtr, int tensorChannel) {
+    if (normalize && channelRanges && x >= 0 && endX > x &&
+        tensorChannel < static_cast<int>(channelRanges->size())) {
+      size_t offset =
+          static_cast<size_t>(tensorChannel) * outputWidth * outputHeight +
+          static_cast<size_t>(y) * outputWidth;
+      if (offset + endX <= tensorSize) {
+        TensorProcessor::normalizeRow(tensorData + offset + x,
+                                      outPtr + x, endX - x,
+                                      (*channelRanges)[tensorChannel]);
+        return;
+      }
+    }
+
+    for (int i = x; i < endX; i++) {
+      outPtr[i] = TensorProcessor::getTensorValue(
+          tensorData, tensorSize, i, y, tensorChannel, outputWidth,
+          outputHeight, isSingleChannel, normalize, minValue, maxValue);
+    }
+  };
+
   // Clear channel to zero
   auto clearChannel = [&](DD::Image::Channel z, int start, int end) {
     float *outPtr = row.writable(z);
@@ -215,12 +310,7 @@ processTensorDataToRow(const std::vector<float> &tensorData, int y, int x,
       if (componentIndex >= 0 && componentIndex < channelCount) {
         // Use the component index (or 0 for single channel mode)
         int channelToUse = isSingleChannel ? 0 : componentIndex;
-
-        for (int i = x; i < endX; i++) {
-          outPtr[i] = TensorProcessor::getTensorValue(
-              tensorData, i, y, channelToUse, outputWidth, outputHeight,
-              isSingleChannel, normalize, minValue, maxValue);
-        }
+        fillFromTensor(outPtr, channelToUse);
       } else {
         clearChannel(z, x, endX);
       }
@@ -228,11 +318,7 @@ processTensorDataToRow(const std::vector<float> &tensorData, int y, int x,
       // Single-channel mode (e.g., depth map)
       if (z == DD::Image::Chan_Red) {
         // Put the single output channel in red
-        for (int i = x; i < endX; i++) {
-          outPtr[i] = TensorProcessor::getTensorValue(
-              tensorData, i, y, 0, outputWidth, outputHeight, isSingleChannel,
-              normalize, minValue, maxValue);
-        }
+        fillFromTensor(outPtr, 0);
       } else if (z == DD::Image::Chan_Green || z == DD::Image::Chan_Blue) {
         clearChannel(z, x, endX);
       } else {
@@ -252,11 +338,7 @@ processTensorDataToRow(const std::vector<float> &tensorData, int y, int x,
         outChannel = 3;
 
       if (outChannel >= 0 && outChannel < channelCount) {
-        for (int i = x; i < endX; i++) {
-          outPtr[i] = TensorProcessor::getTensorValue(
-              tensorData, i, y, outChannel, outputWidth, outputHeight,
-              isSingleChannel, normalize, minValue, maxValue);
-        }
+        fillFromTensor(outPtr, outChannel);
       } else if (z == DD::Image::Chan_Alpha && channelCount <= 3) {
         // If model doesn't output alpha, preserve input alpha
         copyFromInput(z, x, endX);
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * WorkerPool - Threads shared by every parallel loop in the process
+ *
+ * Nuke calls into a node from many of its own threads at once, and each of
+ * them may split a copy or a scan into chunks. Rather than each loop
+ * starting threads of its own, which would put several times as many
+ * threads as cores to work, the loops share one set of helpers, started on
+ * first use. The calling thread always works through its own loop as well,
+ * so a loop finishes even when every helper is busy with others.
+ */
+class WorkerPool {
+public:
+  /**
+   * The pool shared by the process
+   */
+  static WorkerPool &instance() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread &thread : _threads) {
+      thread.join();
+    }
+  }
+
+  /**
+   * Run task(0) ... task(taskCount - 1) on the calling thread and any idle
+   * helpers, returning once all have finished. Tasks must not throw.
+   * @param taskCount Number of tasks
+   * @param task Function called once per task index
+   */
+  void run(size_t taskCount, const std::function<void(size_t)> &task) {
+    if (taskCount <= 1 || helperCount() == 0) {
+      for (size_t i = 0; i < taskCount; i++) {
+        task(i);
+      }
+      return;
+    }
+
+    Loop loop(task, taskCount);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      startThreads();
+      _loops.push_back(&loop);
+    }
+    if (taskCount == 2) {
+      _wake.notify_one();
+    } else {
+      _wake.notify_all();
+    }
+    loop.work();
+
+    // No helper joins once the loop is off the queue; wait for those that
+    // did
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto queued = std::find(_loops.begin(), _loops.end(), &loop);
+    if (queued != _loops.end()) {
+      _loops.erase(queued);
+    }
+    _finished.wait(lock, [&loop]() { return loop.helpers == 0; });
+  }
+
+private:
+  struct Loop {
+    const std::function<void(size_t)> &task;
+    size_t count;
+    std::atomic<size_t> next;
+    int helpers; // Helpers working on it; guarded by _mutex
+
+    Loop(const std::function<void(size_t)> &task, size_t count)
+        : task(task), count(count), next(0), helpers(0) {}
+
+    void work() {
+      for (size_t i = next++; i < count; i = next++) {
+        task(i);
+      }
+    }
+    bool exhausted() const { return next.load() >= count; }
+  };
+
+  WorkerPool() : _threads(), _loops(), _stop(false) {}
+
+  static size_t helperCount() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+  }
+
+  void startThreads() {
+    if (_threads.empty()) {
+      for (size_t t = 0; t < helperCount(); t++) {
+        _threads.emplace_back(&WorkerPool::help, this);
+      }
+    }
+  }
+
+  void help() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _wake.wait(lock, [this]() { return _stop || !_loops.empty(); });
+      if (_stop) {
+        return;
+      }
+      Loop *loop = _loops.front();
+      if (loop->exhausted()) {
+        _loops.pop_front(); // Its caller finishes the last tasks
+        continue;
+      }
+      loop->helpers++;
+      lock.unlock();
+      loop->work();
+      lock.lock();
+      if (--loop->helpers == 0) {
+        _finished.notify_all();
+      }
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _wake;     // A loop was queued or stop was set
+  std::condition_variable _finished; // A helper left a loop
+  std::vector<std::thread> _threads;
+  std::deque<Loop *> _loops; // Loops with tasks left, oldest first
+  bool _stop;
+};
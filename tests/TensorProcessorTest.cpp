@@ -0,0 +1,143 @@
+#include "TensorProcessor.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Checks TensorProcessor::reduceFiniteRanges against the sequential
+ * std::min/std::max scan it replaced. Values are compared bit for bit, so a
+ * range returning 0.0 where the scan returned -0.0 fails. Built with and
+ * without SSE2 to cover both paths of reduceFinite.
+ */
+
+namespace {
+
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+const float kInf = std::numeric_limits<float>::infinity();
+
+int failures = 0;
+
+// The scalar scan, as findMinMaxMultiChannel did it before the SIMD pass
+std::vector<TensorProcessor::MinMax>
+scalarRanges(const std::vector<float> &data, size_t rangeSize) {
+  std::vector<TensorProcessor::MinMax> ranges;
+  for (size_t begin = 0; begin < data.size(); begin += rangeSize) {
+    TensorProcessor::MinMax range{std::numeric_limits<float>::max(),
+                                  std::numeric_limits<float>::lowest()};
+    size_t end = std::min(data.size(), begin + rangeSize);
+    for (size_t i = begin; i < end; i++) {
+      if (std::isfinite(data[i])) {
+        range.min = std::min(range.min, data[i]);
+        range.max = std::max(range.max, data[i]);
+      }
+    }
+    ranges.push_back(range);
+  }
+  return ranges;
+}
+
+bool sameBits(float a, float b) {
+  return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+void check(const std::string &name, const std::vector<float> &data,
+           size_t rangeSize) {
+  std::vector<TensorProcessor::MinMax> expected =
+      scalarRanges(data, rangeSize);
+  std::vector<TensorProcessor::MinMax> actual =
+      TensorProcessor::reduceFiniteRanges(data.data(), data.size(),
+                                          rangeSize);
+  if (actual.size() != expected.size()) {
+    std::printf("FAIL %s: %zu ranges, expected %zu\n", name.c_str(),
+                actual.size(), expected.size());
+    failures++;
+    return;
+  }
+  for (size_t r = 0; r < expected.size(); r++) {
+    if (!sameBits(actual[r].min, expected[r].min) ||
+        !sameBits(actual[r].max, expected[r].max)) {
+      std::printf("FAIL %s, range %zu: [%g, %g], expected [%g, %g]\n",
+                  name.c_str(), r, actual[r].min, actual[r].max,
+                  expected[r].min, expected[r].max);
+      failures++;
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  // Short blocks exercise the scalar tail after the 8-wide loop
+  for (size_t count = 1; count <= 19; count++) {
+    std::vector<float> data(count);
+    for (size_t i = 0; i < count; i++) {
+      data[i] = static_cast<float>(i % 5) - 2.0f;
+    }
+    check("tail " + std::to_string(count), data, count);
+  }
+
+  // NaN and Inf are skipped wherever they fall, including a range of only
+  // non-finite values, which keeps the sentinels
+  check("non-finite",
+        {kNaN, 3.0f, -kInf, -1.0f, kInf, 2.0f, kNaN, -4.0f, 5.0f, kNaN, kInf},
+        11);
+  check("only non-finite", {kNaN, kInf, -kInf, kNaN, kInf, -kInf, kNaN, kNaN,
+                            kInf, 1.0f},
+        9);
+
+  // Which zero is returned depends on which one a scan meets first
+  check("zeros, negative first", {-0.0f, 0.0f, 0.0f, -0.0f, 0.0f}, 5);
+  check("zeros, positive first", {0.0f, -0.0f, -0.0f, 0.0f, -0.0f}, 5);
+  check("zero minimum", {3.0f, 1.0f, 2.0f, 5.0f, 4.0f, 7.0f, 6.0f, 8.0f, 9.0f,
+                         -0.0f, 0.0f, 2.0f},
+        12);
+  check("zero maximum", {-3.0f, -1.0f, -2.0f, -5.0f, -4.0f, -7.0f, -6.0f,
+                         -8.0f, 0.0f, -9.0f, -0.0f, kNaN},
+        12);
+
+  // Random planes with every kind of value, several chunks per range and a
+  // partial chunk and partial range at the end
+  std::mt19937 rng(7);
+  std::normal_distribution<float> values(0.0f, 10.0f);
+  for (int trial = 0; trial < 4; trial++) {
+    size_t chunk = TensorProcessor::kReduceChunkSize;
+    size_t rangeSize = chunk * (trial + 1) + 37 * trial + 5;
+    size_t count = rangeSize * 3 - 1001;
+    std::vector<float> data(count);
+    for (float &value : data) {
+      value = values(rng);
+      switch (rng() % 1000) {
+      case 0:
+        value = kNaN;
+        break;
+      case 1:
+        value = rng() % 2 ? kInf : -kInf;
+        break;
+      case 2:
+        value = rng() % 2 ? 0.0f : -0.0f;
+        break;
+      }
+    }
+    check("random " + std::to_string(trial), data, rangeSize);
+
+    // Ranges whose extremes are zeros of both signs
+    for (float &value : data) {
+      value = std::isfinite(value) ? std::fabs(value) : value;
+    }
+    data[rangeSize + 17] = -0.0f;
+    data[rangeSize + chunk + 3] = 0.0f;
+    check("random zero minimum " + std::to_string(trial), data, rangeSize);
+  }
+
+  if (failures > 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("All reductions match the scalar scan\n");
+  return 0;
+}